@@ -29,6 +29,9 @@
 #include <sha1.h>
 #include <Time.h>
 #include <EEPROM.h>
+#include <ClientBuffer.h>
+#include <Encoding.h>
+#include <JSONParser.h>
 #include <Twitter.h>
 
 /* OneWire bus pin. */
@@ -52,6 +55,11 @@ unsigned long last_tweet = 0;
 
 #define TWEET_DELTA (60L * 60L)
 
+unsigned long last_sample = 0;
+
+/* Sensor sampling interval in seconds. */
+#define SAMPLE_DELTA 5L
+
 /* Work buffer for twitter client.  This shold be fine for normal
    operations, the biggest items that are stored into the working
    buffer are URL encoded consumer and token secrets and HTTP response
@@ -62,6 +70,15 @@ const static char consumer_key[] PROGMEM = "3azqS8rD5Ku7MRHY74qFRg";
 const static char consumer_secret[] PROGMEM
 = "S67Jon338GJ0sNxMyWVe5ccfrH1z3HtjrVGj3xiXApQ";
 
+/* Outbound message queue.  The pending messages are also kept in
+   EEPROM after the account identification (256-511) so they survive a
+   reboot. */
+char queue[96];
+#define QUEUE_EEPROM_ADDR 512
+
+/* The nonce boot counter follows the queue. */
+#define NONCE_EEPROM_ADDR (QUEUE_EEPROM_ADDR + sizeof(queue) + 2)
+
 Twitter twitter(buffer, sizeof(buffer));
 
 void
@@ -99,6 +116,9 @@ setup()
                          PSTR("*** set account token secret here ***"));
 #endif
 
+  twitter.set_queue(queue, sizeof(queue), QUEUE_EEPROM_ADDR);
+  twitter.set_nonce_counter(NONCE_EEPROM_ADDR);
+
   delay(500);
 }
 
@@ -120,31 +140,39 @@ loop()
           last_tweet = now - TWEET_DELTA + 15L;
         }
 
-      sensors.requestTemperatures();
+      if (now >= last_sample + SAMPLE_DELTA)
+        {
+          last_sample = now;
 
-      float temp = sensors.getTempCByIndex(0);
+          sensors.requestTemperatures();
 
-      Serial.println(temp);
+          float temp = sensors.getTempCByIndex(0);
 
-      if (temp != DEVICE_DISCONNECTED && now > last_tweet + TWEET_DELTA)
-        {
-          char msg[32];
-          long val = temp * 100L;
+          Serial.println(temp);
 
-          sprintf(msg, "Office temperature is %ld.%02ld\302\260C",
-                  val / 100L, val % 100L);
+          if (temp != DEVICE_DISCONNECTED && now > last_tweet + TWEET_DELTA)
+            {
+              char msg[32];
+              long val = temp * 100L;
 
-          Serial.print("Posting to Twitter: ");
-          Serial.println(msg);
+              sprintf(msg, "Office temperature is %ld.%02ld\302\260C",
+                      val / 100L, val % 100L);
 
-          last_tweet = now;
+              Serial.print("Queueing for Twitter: ");
+              Serial.println(msg);
 
-          if (twitter.post_status(msg))
-            Serial.println("Status updated");
-          else
-            Serial.println("Update failed");
+              last_tweet = now;
+
+              if (!twitter.queue_status(msg))
+                Serial.println("Twitter queue full");
+            }
         }
-    }
 
-  delay(5000);
+      /* Post the queued messages in the background. */
+      twitter.process_queue();
+    }
+  else
+    {
+      delay(5000);
+    }
 }
@@ -31,6 +31,7 @@
 #include <SerialPacket.h>
 #include <CommandLine.h>
 #include <GetPut.h>
+#include <Encoding.h>
 #include <HomeWeather.h>
 
 /* Temperature sensor data wire is plugged into port 2 on the
@@ -32,9 +32,13 @@
 #include <CommandLine.h>
 #include <GetPut.h>
 #include <HomeWeather.h>
+#include <ClientBuffer.h>
+#include <Encoding.h>
 #include <ClientInfo.h>
 #include <JSON.h>
+#include <JSONParser.h>
 #include <sha1.h>
+#include <sha256.h>
 
 /* RF pins. */
 #define RF_RX_PIN 2
@@ -48,6 +52,23 @@
 
 #define HTTP_SERVER_LEN 32
 
+/* The data API requests are authenticated with HMAC-SHA-1.  Define
+   HMAC_SHA256 as 1 to use HMAC-SHA-256 instead; the server must accept
+   the `HMAC-SHA-256' scheme. */
+#ifndef HMAC_SHA256
+#define HMAC_SHA256 0
+#endif
+
+#if HMAC_SHA256
+typedef Sha256Class HmacClass;
+#define HMAC_LENGTH SHA256_HASH_LENGTH
+#define HMAC_SCHEME "HMAC-SHA-256"
+#else /* not HMAC_SHA256 */
+typedef Sha1Class HmacClass;
+#define HMAC_LENGTH SHA1_HASH_LENGTH
+#define HMAC_SCHEME "HMAC-SHA-1"
+#endif /* not HMAC_SHA256 */
+
 /* EEPROM addresses. */
 #define EEPROM_ADDR_CONFIGURED	0
 #define EEPROM_ADDR_ID		(EEPROM_ADDR_CONFIGURED + 1)
@@ -127,6 +148,9 @@ uint16_t proxy_port;
 uint32_t msg_seqnum = 0;
 unsigned long basetime = 0;
 
+/* Have `msg_seqnum' and `basetime' been received from the server? */
+bool have_parameters = false;
+
 #define MAX_CLIENTS 2
 
 ClientInfo clients[MAX_CLIENTS];
@@ -134,6 +158,34 @@ ClientInfo clients[MAX_CLIENTS];
 char json_buffer[512];
 JSON json = JSON(json_buffer, sizeof(json_buffer));
 
+/* The parameters in the server's JSON reply: the message sequence
+   number and the current time.  The order of `param_paths' follows
+   the ServerParam values. */
+enum ServerParam
+{
+  PARAM_SEQNUM,
+  PARAM_TIME,
+  NUM_PARAMS
+};
+
+const prog_char param_seqnum[] PROGMEM = "s";
+const prog_char param_time[] PROGMEM = "t";
+
+const prog_char *const param_paths[NUM_PARAMS] = {param_seqnum, param_time};
+
+/* The server parameters of a reply while it is parsed.  They are
+   stored only after the whole reply has been validated. */
+struct ServerParams
+{
+  unsigned long values[NUM_PARAMS];
+
+  /* A bitmap of the parameters seen. */
+  uint8_t seen;
+
+  /* Cleared if a value is not a number. */
+  bool valid;
+};
+
 const prog_char bannerstr[] PROGMEM = "\
 WeatherServer <http://www.iki.fi/mtr/HomeWeather/>\n\
 Copyright (c) 2011 Markku Rossi <mtr@iki.fi>\n\
@@ -424,24 +476,34 @@ read_line(Client *client, uint8_t *buffer, size_t buflen)
    specifies the HTTP method and `uri' the URI at the server.  The
    argument `content_json' specifies the content JSON data.  The HTTP
    status code is returned in `http_code_return' and the content data
-   is stored into `buffer', `buflen'.  The function returns true if
-   the HTTP operation was successful and false on error. */
+   is stored into `buffer', `buflen'.  If `parser' is not 0, content
+   data that starts as a JSON object or array is fed to it as it
+   arrives and it is not stored; `buffer' is then left empty.  The
+   request is
+   authenticated with an HMAC of the content data keyed with
+   `secret', see HMAC_SHA256.  The function returns true if the HTTP
+   operation was successful and false on error. */
 static bool
 http_json_request(const prog_char method[], const prog_char uri[],
                   const char *content_json, int32_t *http_code_return,
-                  uint8_t *buffer, size_t buflen)
+                  uint8_t *buffer, size_t buflen, JSONParser *parser)
 {
+  HmacClass hmac;
   int i;
   char buf[8];
+  char *cp;
   size_t pos;
+  bool stream;
 
-  Sha1.initHmac(secret, sizeof(secret));
-  Sha1.print(content_json);
+  hmac.initHmac(secret, sizeof(secret));
+  hmac.print(content_json);
 
   uint8_t *server = proxy_server;
   uint16_t port = proxy_port;
 
   EthernetClient http_client;
+  uint8_t out_buf[64];
+  ClientBuffer out(&http_client, out_buf, sizeof(out_buf));
 
   if (!http_client.connect(server, port))
     {
@@ -450,47 +512,48 @@ http_json_request(const prog_char method[], const prog_char uri[],
       return false;
     }
 
-  HomeWeather::print(&http_client, method);
+  HomeWeather::print(&out, method);
 
   if (use_proxy)
     {
-      HomeWeather::print(&http_client, PSTR(" http://"));
-      http_client.write((const char *) http_server);
+      HomeWeather::print(&out, PSTR(" http://"));
+      out.write((const char *) http_server);
     }
   else
     {
-      HomeWeather::print(&http_client, PSTR(" "));
+      HomeWeather::print(&out, PSTR(" "));
     }
 
-  HomeWeather::print(&http_client, uri);
-  HomeWeather::println(&http_client, PSTR(" HTTP/1.1"));
-  HomeWeather::println(&http_client, PSTR("Content-Type: application/json"));
+  HomeWeather::print(&out, uri);
+  HomeWeather::println(&out, PSTR(" HTTP/1.1"));
+  HomeWeather::println(&out, PSTR("Content-Type: application/json"));
 
-  HomeWeather::print(&http_client, PSTR("Content-Length: "));
-  snprintf(buf, sizeof(buf), "%d", strlen(content_json));
-  http_client.write(buf);
-  HomeWeather::newline(&http_client);
+  HomeWeather::print(&out, PSTR("Content-Length: "));
+  snprintf(buf, sizeof(buf), "%d", (int) strlen(content_json));
+  out.write(buf);
+  HomeWeather::newline(&out);
 
-  HomeWeather::println(&http_client, PSTR("Connection: close"));
+  HomeWeather::println(&out, PSTR("Connection: close"));
 
-  HomeWeather::print(&http_client, PSTR("Host: "));
-  http_client.write((const char *) http_server);
-  HomeWeather::newline(&http_client);
+  HomeWeather::print(&out, PSTR("Host: "));
+  out.write((const char *) http_server);
+  HomeWeather::newline(&out);
 
-  HomeWeather::print(&http_client, PSTR("Authorization: HMAC-SHA-1 "));
+  HomeWeather::print(&out, PSTR("Authorization: " HMAC_SCHEME " "));
 
-  uint8_t *digest = Sha1.resultHmac();
-  for (i = 0; i < HASH_LENGTH; i++)
+  uint8_t *digest = hmac.resultHmac();
+  for (i = 0; i < HMAC_LENGTH; i++)
     {
       snprintf(buf, sizeof(buf), "%02x", digest[i]);
-      http_client.write(buf);
+      out.write(buf);
     }
-  HomeWeather::newline(&http_client);
+  HomeWeather::newline(&out);
 
   /* Header-body separator. */
-  HomeWeather::newline(&http_client);
+  HomeWeather::newline(&out);
 
-  http_client.write(content_json);
+  out.write(content_json);
+  out.flush();
 
   /* Read response status line. */
   if (!read_line(&http_client, buffer, buflen))
@@ -506,7 +569,9 @@ http_json_request(const prog_char method[], const prog_char uri[],
     }
   else
     {
-      *http_code_return = atol((char *) buffer);
+      /* The status code follows the HTTP version. */
+      cp = strchr((char *) buffer, ' ');
+      *http_code_return = cp ? atol(cp + 1) : 0;
 
       /* Read until we find the header-body separator. */
       while (true)
@@ -522,15 +587,27 @@ http_json_request(const prog_char method[], const prog_char uri[],
         }
     }
 
-  /* Collect content data to buffer. */
+  /* Collect content data to buffer.  A JSON reply is only fed to the
+     parser. */
   pos = 0;
+  stream = false;
   while (http_client.connected())
     {
       while (http_client.available() > 0)
         {
           uint8_t byte = http_client.read();
 
-          if (pos < buflen)
+          if (parser && !stream && pos == 0)
+            {
+              if (isspace(byte))
+                continue;
+              if (byte == '{' || byte == '[')
+                stream = true;
+            }
+
+          if (stream)
+            parser->feed(byte);
+          else if (pos < buflen)
             buffer[pos++] = byte;
         }
       delay(100);
@@ -547,13 +624,87 @@ http_json_request(const prog_char method[], const prog_char uri[],
   return false;
 }
 
+/* Parse the server parameter `value' in base 10.  The function
+   returns false if the value is not a number. */
+static bool
+parse_param(const char *value, unsigned long *value_return)
+{
+  char *end;
+
+  if (!isdigit(value[0]))
+    return false;
+
+  *value_return = strtoul(value, &end, 10);
+
+  return *end == '\0';
+}
+
+/* Record the server parameter `path' of `param_paths' from the JSON
+   reply into the ServerParams `context'. */
+static void
+param_value(void *context, uint8_t path, const char *value)
+{
+  ServerParams *params = (ServerParams *) context;
+
+  if (path >= NUM_PARAMS || !parse_param(value, &params->values[path]))
+    {
+      params->valid = false;
+      return;
+    }
+
+  params->seen |= 1 << path;
+}
+
+/* Parse the reply `s:<seqnum>,t:<time>' of older servers into
+   `params'. */
+static void
+parse_legacy_params(char *data, ServerParams *params)
+{
+  char *end;
+  uint8_t path;
+
+  while (data[0])
+    {
+      if (isspace(data[0]))
+        {
+          data++;
+          continue;
+        }
+
+      if (data[0] == 's')
+        path = PARAM_SEQNUM;
+      else if (data[0] == 't')
+        path = PARAM_TIME;
+      else
+        path = NUM_PARAMS;
+
+      if (path == NUM_PARAMS || data[1] != ':' || !isdigit(data[2]))
+        {
+          params->valid = false;
+          return;
+        }
+
+      data += 2;
+      params->values[path] = strtoul(data, &end, 10);
+      params->seen |= 1 << path;
+      data = end;
+
+      if (data[0] == ',')
+        data++;
+    }
+}
+
 static bool
 get_parameters_from_server(void)
 {
   char *json_data;
   int32_t code;
-  char *data;
-  char *end;
+  char parser_buffer[16];
+  JSONParser parser(parser_buffer, sizeof(parser_buffer));
+  ServerParams params;
+
+  params.seen = 0;
+  params.valid = true;
 
   json.clear();
   json.add_object();
@@ -564,60 +715,36 @@ get_parameters_from_server(void)
   if (verbose > 1)
     Serial.println(json_data);
 
+  parser.set_paths(param_paths, NUM_PARAMS, param_value, &params);
+
   if (!http_json_request(PSTR("GET"), PSTR("/data_api/params"), json_data,
-                         &code, (uint8_t *) json_buffer, sizeof(json_buffer))
+                         &code, (uint8_t *) json_buffer, sizeof(json_buffer),
+                         &parser)
       || code < 200 || code >= 300)
     {
       HomeWeather::println("Failed to get parameters");
       return false;
     }
 
-  /* Parse response. */
-  data = json_buffer;
-  while (data[0])
+  /* The reply is a JSON object `{"s":<seqnum>,"t":<time>}' that the
+     parser has consumed.  Older servers reply with
+     `s:<seqnum>,t:<time>', which is in `json_buffer'. */
+  if (!parser.is_done())
     {
-      switch (data[0])
-        {
-        case 's':
-          if (data[1] != ':')
-            return false;
-
-          data += 2;
-          msg_seqnum = strtoul(data, &end, 0);
-          if (end == data)
-            return false;
-
-          data = end;
-          break;
-
-        case 't':
-          if (data[1] != ':')
-            return false;
-
-          data += 2;
-          basetime = strtoul(data, &end, 0);
-          if (end == data)
-            return false;
-
-          data = end;
-
-          basetime -= millis() / 1000L;
+      params.seen = 0;
+      params.valid = true;
+      parse_legacy_params(json_buffer, &params);
+    }
 
-          /* Now basetime + millis() is approximately the current
-             time. */
-          break;
+  /* Change our state only if the reply had valid values for all the
+     parameters. */
+  if (!params.valid || params.seen != (1 << NUM_PARAMS) - 1)
+    return false;
 
-        default:
-          if (isspace(data[0]))
-            data++;
-          else
-            return false;
-          break;
-        }
+  msg_seqnum = params.values[PARAM_SEQNUM];
 
-      if (data[0] == ',')
-        data++;
-    }
+  /* Now basetime + millis() is approximately the current time. */
+  basetime = params.values[PARAM_TIME] - millis() / 1000L;
 
   return true;
 }
@@ -850,7 +977,8 @@ post_data_to_server(void)
     Serial.println(json_data);
 
   if (!http_json_request(PSTR("POST"), PSTR("/data_api/add"), json_data,
-                         &code, (uint8_t *) json_buffer, sizeof(json_buffer))
+                         &code, (uint8_t *) json_buffer, sizeof(json_buffer),
+                         0)
       || code < 200 || code >= 300)
     HomeWeather::println(PSTR("Data sending failed"));
 }
@@ -872,6 +1000,11 @@ loop(void)
       break;
 
     case RUNLEVEL_RUN:
+      /* Continue the message sequence of the server.  The data is
+         posted also while the server does not answer the query. */
+      if (!have_parameters)
+        have_parameters = get_parameters_from_server();
+
       // poll_rf_clients();
       poll_local_sensors();
       post_data_to_server();
@@ -0,0 +1,492 @@
+/*
+ * bench.cpp - micro benchmarks of the library hot paths
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The benchmark prints its results to the standard output as a JSON
+   document:
+
+     {"benchmarks": [
+       {"name": "sha1", "size": 64, "iterations": 65536,
+        "ns_per_op": 512.3, "cycles_per_op": 1537.0, "mb_per_s": 124.9},
+       ...
+       {"name": "twitter_sign_work_buffer", "bytes": 62},
+       ...
+     ]}
+
+   The cycles are counted with the time stamp counter on x86 and are
+   left out elsewhere.  The entries with a value other than the
+   timing report a property of the measured code, such as the memory
+   it uses. */
+
+#include <stdio.h>
+
+#include <sha1.h>
+#include <sha256.h>
+#include <Encoding.h>
+#include <JSON.h>
+#include <JSONParser.h>
+#include <SoftwareSerial.h>
+#include <SerialPacket.h>
+#include <Time.h>
+#include <ClientInfo.h>
+#include <OneWire.h>
+
+#include "bench.h"
+
+/* The minimum run time of a case in microseconds. */
+#define BENCH_MIN_TIME 200000UL
+
+uint8_t bench_data[BENCH_DATA_LEN];
+volatile uint8_t bench_sink;
+
+/* The number of results printed so far. */
+static int bench_count;
+
+#if defined(__i386__) || defined(__x86_64__)
+#define BENCH_CYCLES() __builtin_ia32_rdtsc()
+#endif
+
+void
+bench_run(const char *name, size_t size, BenchFunc func)
+{
+  unsigned long iterations = 1;
+  unsigned long i, start, elapsed;
+  unsigned long long cycles = 0;
+  double ns;
+
+  /* Double the iterations until the case runs long enough to
+     measure. */
+  for (;;)
+    {
+      start = micros();
+#ifdef BENCH_CYCLES
+      cycles = BENCH_CYCLES();
+#endif
+      for (i = 0; i < iterations; i++)
+        func(size);
+#ifdef BENCH_CYCLES
+      cycles = BENCH_CYCLES() - cycles;
+#endif
+      elapsed = micros() - start;
+
+      if (elapsed >= BENCH_MIN_TIME)
+        break;
+
+      iterations *= 2;
+    }
+
+  ns = elapsed * 1000.0 / iterations;
+
+  printf("%s\n    {\"name\": \"%s\", \"size\": %lu, \"iterations\": %lu, "
+         "\"ns_per_op\": %.1f",
+         bench_count++ ? "," : "", name, (unsigned long) size, iterations, ns);
+#ifdef BENCH_CYCLES
+  printf(", \"cycles_per_op\": %.1f", (double) cycles / iterations);
+#endif
+  if (size)
+    printf(", \"mb_per_s\": %.2f", size * 1000.0 / ns);
+  printf("}");
+
+  fflush(stdout);
+}
+
+void
+bench_value(const char *name, const char *key, unsigned long value)
+{
+  printf("%s\n    {\"name\": \"%s\", \"%s\": %lu}",
+         bench_count++ ? "," : "", name, key, value);
+
+  fflush(stdout);
+}
+
+static void
+sha1(size_t size)
+{
+  Sha1.init();
+  Sha1.write(bench_data, size);
+  bench_sink ^= Sha1.result()[0];
+}
+
+static void
+hmac_sha1(size_t size)
+{
+  Sha1.initHmac(bench_data, 42);
+  Sha1.write(bench_data, size);
+  bench_sink ^= Sha1.resultHmac()[0];
+}
+
+static void
+sha256(size_t size)
+{
+  Sha256.init();
+  Sha256.write(bench_data, size);
+  bench_sink ^= Sha256.result()[0];
+}
+
+static void
+hmac_sha256(size_t size)
+{
+  Sha256.initHmac(bench_data, 42);
+  Sha256.write(bench_data, size);
+  bench_sink ^= Sha256.resultHmac()[0];
+}
+
+/* The data API verifier: HMAC-SHA256 of `size' / MULTI_MSG_LEN posts
+   of MULTI_MSG_LEN bytes, each in its own context resumed from a
+   cached key state.  The loop case hashes the posts one at a time and
+   the multi case in parallel. */
+#define MULTI_MSG_LEN 256
+#define MULTI_MAX_MSGS (BENCH_DATA_LEN / MULTI_MSG_LEN)
+
+static Sha256Class multi_contexts[MULTI_MAX_MSGS];
+static uint8_t multi_key_state[SHA256_HMAC_KEY_STATE_LENGTH];
+
+static Sha256Class *multi_context_ptrs[MULTI_MAX_MSGS];
+static const uint8_t *multi_data[MULTI_MAX_MSGS];
+static size_t multi_lengths[MULTI_MAX_MSGS];
+static uint8_t *multi_hashes[MULTI_MAX_MSGS];
+
+static void
+hmac_sha256_loop(size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size / MULTI_MSG_LEN; i++)
+    {
+      multi_contexts[i].initHmacKeyState(multi_key_state);
+      multi_contexts[i].update(bench_data + i * MULTI_MSG_LEN, MULTI_MSG_LEN);
+      bench_sink ^= multi_contexts[i].resultHmac()[0];
+    }
+}
+
+static void
+hmac_sha256_multi(size_t size)
+{
+  size_t i, count = size / MULTI_MSG_LEN;
+
+  for (i = 0; i < count; i++)
+    {
+      multi_contexts[i].initHmacKeyState(multi_key_state);
+      multi_context_ptrs[i] = &multi_contexts[i];
+      multi_data[i] = bench_data + i * MULTI_MSG_LEN;
+      multi_lengths[i] = MULTI_MSG_LEN;
+    }
+
+  Sha256Class::updateMulti(multi_context_ptrs, multi_data, multi_lengths,
+                           count);
+  Sha256Class::resultHmacMulti(multi_context_ptrs, multi_hashes, count);
+
+  for (i = 0; i < count; i++)
+    bench_sink ^= multi_hashes[i][0];
+}
+
+/* The encoders are measured up to 64 KB, past the shared input. */
+#define ENCODE_DATA_LEN 65536
+
+static uint8_t encode_data[ENCODE_DATA_LEN];
+
+/* Large enough for all encodings. */
+static char encode_buffer[ENCODING_HEX_LENGTH(ENCODE_DATA_LEN) + 1];
+
+static void
+hex_encode(size_t size)
+{
+  bench_sink ^= *(Encoding::hex_encode(encode_buffer, encode_data, size) - 1);
+}
+
+static void
+hex_encode_upper(size_t size)
+{
+  bench_sink ^= *(Encoding::hex_encode_upper(encode_buffer, encode_data, size)
+                  - 1);
+}
+
+static void
+base64_encode(size_t size)
+{
+  bench_sink ^= *(Encoding::base64_encode(encode_buffer, encode_data, size)
+                  - 1);
+}
+
+static void
+base64url_encode(size_t size)
+{
+  bench_sink ^= *(Encoding::base64url_encode(encode_buffer, encode_data, size)
+                  - 1);
+}
+
+static char json_buffer[512];
+static const char *json_document;
+
+static void
+json_payload(size_t size)
+{
+  JSON json(json_buffer, sizeof(json_buffer));
+  int i, j;
+
+  /* The payload of WeatherServer's post_data_to_server() with two
+     clients of four sensors each. */
+  json.add_object();
+  json.add(PSTR("id"), bench_data, 8);
+  json.add(PSTR("sn"), (int32_t) 4711);
+  json.add_array(PSTR("c"));
+
+  for (i = 0; i < 2; i++)
+    {
+      json.add_object();
+      json.add(PSTR("id"), bench_data + 8 * i, 8);
+      json.add(PSTR("loss"), (int32_t) 3);
+      json.add_array(PSTR("s"));
+
+      for (j = 0; j < 4; j++)
+        {
+          json.add_object();
+          json.add(PSTR("id"), bench_data + 16 + 8 * j, 8);
+          json.add(PSTR("v"), (int32_t) (2150 + j));
+          json.pop();
+        }
+
+      json.pop();
+      json.pop();
+    }
+
+  json_document = json.finish();
+  bench_sink ^= json_document[0];
+}
+
+const static char path_sensor_value[] PROGMEM = "c[].s[].v";
+static const prog_char *const json_paths[] = {path_sensor_value};
+
+static void
+json_value(void *context, uint8_t path, const char *value)
+{
+  bench_sink ^= value[0];
+}
+
+static void
+json_parse(size_t size)
+{
+  char buffer[32];
+  JSONParser parser(buffer, sizeof(buffer));
+  const char *cp;
+
+  /* Pick the sensor values from the json_payload() document. */
+  parser.set_paths(json_paths, 1, json_value, 0);
+
+  for (cp = json_document; *cp; cp++)
+    parser.feed(*cp);
+
+  bench_sink ^= parser.is_done();
+}
+
+/* A software serial port that loops the written data back to its
+   input through a memory buffer. */
+class LoopbackSerial : public SoftwareSerial
+{
+public:
+
+  LoopbackSerial()
+    : SoftwareSerial(2, 3),
+      head(0),
+      tail(0)
+  {
+  }
+
+  virtual int available(void)
+  {
+    return head - tail;
+  }
+
+  virtual int read(void)
+  {
+    return head == tail ? -1 : data[tail++ % sizeof(data)];
+  }
+
+  virtual int peek(void)
+  {
+    return head == tail ? -1 : data[tail % sizeof(data)];
+  }
+
+  virtual size_t write(uint8_t byte)
+  {
+    data[head++ % sizeof(data)] = byte;
+    return 1;
+  }
+
+  using Print::write;
+
+private:
+
+  uint8_t data[1024];
+  unsigned long head;
+  unsigned long tail;
+};
+
+static LoopbackSerial packet_serial;
+static SerialPacket packet(&packet_serial);
+
+static void
+packet_roundtrip(size_t size)
+{
+  size_t len;
+
+  packet.send(bench_data, size);
+  bench_sink ^= packet.receive(&len)[0];
+}
+
+static void
+onewire_crc8(size_t size)
+{
+  bench_sink ^= OneWire::crc8(bench_data, size);
+}
+
+static void
+onewire_crc16(size_t size)
+{
+  bench_sink ^= OneWire::crc16(bench_data, size);
+}
+
+static void
+time_break_make(size_t size)
+{
+  static time_t t = 1318622958;
+  tmElements_t tm;
+
+  breakTime(t, tm);
+  t = makeTime(tm) + 86399;
+
+  bench_sink ^= tm.Second;
+}
+
+#define BENCH_CLIENTS 32
+
+static ClientInfo clients[BENCH_CLIENTS];
+
+static void
+client_lookup(size_t size)
+{
+  static uint8_t n;
+  ClientInfo *client;
+  uint8_t id[8];
+
+  /* Cycle over all clients and their sensors. */
+  memcpy(id, bench_data, sizeof(id));
+  id[0] = n++ % BENCH_CLIENTS;
+
+  client = ClientInfo::lookup(clients, BENCH_CLIENTS, id, sizeof(id));
+
+  id[1] = n % CLIENT_INFO_MAX_SENSORS;
+  bench_sink ^= client->lookup(id, sizeof(id))->id_len;
+}
+
+static const size_t sizes[] = {64, 1024, BENCH_DATA_LEN};
+
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+/* From a short key or hash to the largest block the encoders take. */
+static const size_t encode_sizes[] = {
+  16, 64, 256, 1024, 4096, 16384, ENCODE_DATA_LEN
+};
+
+#define NUM_ENCODE_SIZES (sizeof(encode_sizes) / sizeof(encode_sizes[0]))
+
+static const size_t packet_sizes[] = {16, 64, 255};
+
+/* A ROM code, a DS18B20 scratchpad, and longer memory reads. */
+static const size_t crc_sizes[] = {7, 8, 32, 255};
+
+#define NUM_CRC_SIZES (sizeof(crc_sizes) / sizeof(crc_sizes[0]))
+
+/* 1, 4, 8, 16 and 64 posts. */
+static const size_t multi_sizes[] = {
+  MULTI_MSG_LEN, 4 * MULTI_MSG_LEN, 8 * MULTI_MSG_LEN, 16 * MULTI_MSG_LEN,
+  MULTI_MAX_MSGS * MULTI_MSG_LEN
+};
+
+#define NUM_MULTI_SIZES (sizeof(multi_sizes) / sizeof(multi_sizes[0]))
+
+#define NUM_PACKET_SIZES (sizeof(packet_sizes) / sizeof(packet_sizes[0]))
+
+void
+setup(void)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof(bench_data); i++)
+    bench_data[i] = (uint8_t) random();
+  for (i = 0; i < sizeof(encode_data); i++)
+    encode_data[i] = (uint8_t) random();
+
+  printf("{\"benchmarks\": [");
+
+  for (i = 0; i < NUM_SIZES; i++)
+    bench_run("sha1", sizes[i], sha1);
+  for (i = 0; i < NUM_SIZES; i++)
+    bench_run("hmac_sha1", sizes[i], hmac_sha1);
+
+  for (i = 0; i < NUM_SIZES; i++)
+    bench_run("sha256", sizes[i], sha256);
+  for (i = 0; i < NUM_SIZES; i++)
+    bench_run("hmac_sha256", sizes[i], hmac_sha256);
+
+  Sha256.initHmac(bench_data, 42);
+  Sha256.getHmacKeyState(multi_key_state);
+
+  for (i = 0; i < NUM_MULTI_SIZES; i++)
+    bench_run("hmac_sha256_loop", multi_sizes[i], hmac_sha256_loop);
+  for (i = 0; i < NUM_MULTI_SIZES; i++)
+    bench_run("hmac_sha256_multi", multi_sizes[i], hmac_sha256_multi);
+
+  for (i = 0; i < NUM_ENCODE_SIZES; i++)
+    bench_run("hex_encode", encode_sizes[i], hex_encode);
+  for (i = 0; i < NUM_ENCODE_SIZES; i++)
+    bench_run("hex_encode_upper", encode_sizes[i], hex_encode_upper);
+  for (i = 0; i < NUM_ENCODE_SIZES; i++)
+    bench_run("base64_encode", encode_sizes[i], base64_encode);
+  for (i = 0; i < NUM_ENCODE_SIZES; i++)
+    bench_run("base64url_encode", encode_sizes[i], base64url_encode);
+
+  bench_twitter();
+
+  bench_run("json_payload", 0, json_payload);
+  bench_run("json_parse", strlen(json_document), json_parse);
+
+  for (i = 0; i < NUM_PACKET_SIZES; i++)
+    bench_run("serial_packet_roundtrip", packet_sizes[i], packet_roundtrip);
+
+  for (i = 0; i < NUM_CRC_SIZES; i++)
+    bench_run("onewire_crc8", crc_sizes[i], onewire_crc8);
+  for (i = 0; i < NUM_CRC_SIZES; i++)
+    bench_run("onewire_crc16", crc_sizes[i], onewire_crc16);
+
+  bench_run("time_break_make", 0, time_break_make);
+  bench_run("client_info_lookup", 0, client_lookup);
+
+  printf("\n]}\n");
+
+  exit(0);
+}
+
+void
+loop(void)
+{
+}
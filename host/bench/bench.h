@@ -0,0 +1,54 @@
+/* -*- c++ -*-
+ *
+ * bench.h - micro benchmarks of the library hot paths
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "Arduino.h"
+
+/* A benchmark case.  The function runs the operation once for the
+   input size `size'. */
+typedef void (*BenchFunc)(size_t size);
+
+/* Run the benchmark `name' with the input size `size' and print its
+   result as a JSON object.  The size 0 means that the case has no
+   input size and no throughput is reported. */
+void bench_run(const char *name, size_t size, BenchFunc func);
+
+/* Print the value `value' of the benchmark `name' as the field `key'
+   of a JSON object, for the properties that are not timings. */
+void bench_value(const char *name, const char *key, unsigned long value);
+
+/* Shared input data for the cases. */
+#define BENCH_DATA_LEN 16384
+extern uint8_t bench_data[BENCH_DATA_LEN];
+
+/* The results of the cases are folded here so that the compiler can
+   not drop the benchmarked code. */
+extern volatile uint8_t bench_sink;
+
+/* The Twitter cases. */
+void bench_twitter(void);
+
+#endif /* not BENCH_H */
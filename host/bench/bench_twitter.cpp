@@ -0,0 +1,374 @@
+/*
+ * bench_twitter.cpp - Twitter micro benchmarks
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+
+#include <Ethernet.h>
+#include <EEPROM.h>
+#include <sha1.h>
+#include <Time.h>
+#include <ClientBuffer.h>
+#include <Encoding.h>
+
+#include <Twitter.h>
+
+#include "bench.h"
+
+static char work_buffer[512];
+static Twitter twitter(work_buffer, sizeof(work_buffer));
+
+/* A status message of a typical length with characters that need URL
+   encoding. */
+static const char message[]
+= "Temperature is 21.5C, humidity 40% & pressure 1013 hPa (sensor #1)";
+
+/* Status messages in UTF-8 for the URL encoding cases. */
+static const char message_finnish[]
+= "L\xc3\xa4mp\xc3\xb6tila ulkona \xe2\x88\x92" "3,5 \xc2\xb0" "C, "
+  "sis\xc3\xa4ll\xc3\xa4 21,2 \xc2\xb0" "C ja kosteus 45 %";
+static const char message_japanese[]
+= "\xe4\xbb\x8a\xe6\x97\xa5\xe3\x81\xae\xe6\xb0\x97\xe6\xb8\xa9"
+  "\xe3\x81\xaf 21.5\xe2\x84\x83 \xe2\x98\x80 #weather";
+
+static const char *url_message;
+
+static char encode_buffer[3 * 512];
+
+static void
+url_encode(size_t size)
+{
+  bench_sink ^= *(Twitter::url_encode(encode_buffer, url_message) - 1);
+}
+
+static void
+url_encoded_length(size_t size)
+{
+  bench_sink ^= Twitter::url_encoded_length(url_message);
+}
+
+/* The encoder before the lookup tables: a chain of range comparisons
+   and snprintf() for every escaped byte. */
+static void
+url_encode_snprintf(size_t size)
+{
+  const char *cp;
+  char *out = encode_buffer;
+  char ch;
+
+  for (cp = url_message; (ch = *cp); cp++)
+    {
+      if (('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z')
+          || ('0' <= ch && ch <= '9')
+          || ch == '-' || ch == '.' || ch == '_' || ch == '~')
+        {
+          *out++ = ch;
+        }
+      else
+        {
+          snprintf(out, 4, "%%%02X", ((int) ch) & 0xff);
+          out += 3;
+        }
+    }
+  *out = '\0';
+
+  bench_sink ^= out[-1];
+}
+
+static void
+bench_url_encode(const char *kind, const char *message)
+{
+  char name[64];
+
+  url_message = message;
+
+  snprintf(name, sizeof(name), "twitter_url_encode%s", kind);
+  bench_run(name, strlen(message), url_encode);
+
+  snprintf(name, sizeof(name), "twitter_url_encode_snprintf%s", kind);
+  bench_run(name, strlen(message), url_encode_snprintf);
+
+  snprintf(name, sizeof(name), "twitter_url_encoded_length%s", kind);
+  bench_run(name, strlen(message), url_encoded_length);
+}
+
+static void
+compute_authorization(size_t size)
+{
+  bench_sink ^= twitter.sign_status(1318622958, message)[0];
+}
+
+static void
+compute_authorization_cold(size_t size)
+{
+  /* Drop the cached HMAC key and prefix states. */
+  twitter.set_client_id(PSTR("3azqS8rD5Ku7MRHY74qFRg"),
+                        PSTR("S67Jon338GJ0sNxMyWVe5ccfrH1z3HtjrVGj3xiXApQ"));
+  compute_authorization(size);
+}
+
+/* A status message of the maximum length in bytes. */
+#define LONG_MESSAGE_LEN 280
+
+static char long_message[LONG_MESSAGE_LEN + 1];
+
+/* The nonce and the signature of the staged signer. */
+static uint8_t staged_nonce[8];
+static uint8_t staged_signature[SHA1_HASH_LENGTH];
+static uint32_t staged_count;
+
+/* Create the nonce as Twitter::sign_status() does, so that both
+   signers do the same hashing per signature. */
+static void
+staged_create_nonce(void)
+{
+  Sha1Class sha1;
+  uint32_t values[5];
+
+  values[0] = 0;
+  values[1] = staged_count++;
+  values[2] = 1318622958;
+  values[3] = micros();
+  values[4] = millis();
+
+  sha1.write((uint8_t *) values, sizeof(values));
+  sha1.write(staged_signature, sizeof(staged_signature));
+
+  memcpy(staged_nonce, sha1.result(), sizeof(staged_nonce));
+}
+
+/* The staging buffer of the signer before the streaming one, its
+   peak use, and the bytes written into it per signature. */
+static char staged_buffer[2048];
+static size_t staged_peak;
+static size_t staged_copied;
+
+static char *
+staged(char *end)
+{
+  size_t len = end - staged_buffer + 1;
+
+  if (len > staged_peak)
+    staged_peak = len;
+
+  return end;
+}
+
+/* Encode `value' into the staging buffer at `out', count it, and hash
+   the result.  If `twice' is true, the encoded value is encoded again
+   after it as the parameter values of the base string are. */
+static void
+staged_add(Sha1Class *sha1, char *out, const char *value, bool twice)
+{
+  char *end = staged(Twitter::url_encode(out, value));
+
+  staged_copied += end - out;
+
+  if (twice)
+    {
+      value = out;
+      out = end + 1;
+      end = staged(Twitter::url_encode(out, value));
+      staged_copied += end - out;
+    }
+
+  sha1->print(out);
+}
+
+static void
+staged_add_param(Sha1Class *sha1, const char *key, const char *value,
+                 char *out)
+{
+  sha1->print("%26");
+  sha1->print(key);
+  sha1->print("%3D");
+  staged_add(sha1, out, value, true);
+}
+
+/* The signer before the streaming one: each item is URL encoded into
+   the staging buffer and hashed from there.  The parameter values are
+   encoded twice as the streaming signer does so that both hash the
+   same base string, and the nonce is created the same way. */
+static void
+sign_staged(size_t size)
+{
+  Sha1Class sha1;
+  char *cp;
+
+  staged_copied = 0;
+  staged_create_nonce();
+
+  cp = Twitter::url_encode(staged_buffer,
+                           "S67Jon338GJ0sNxMyWVe5ccfrH1z3HtjrVGj3xiXApQ");
+  *cp++ = '&';
+  cp = staged(Twitter::url_encode(cp,
+                                  "AbCdEfGhIjKlMnOpQrStUvWxYz0123456789AbCdEf"));
+  staged_copied += cp - staged_buffer;
+  sha1.initHmac((uint8_t *) staged_buffer, cp - staged_buffer);
+
+  sha1.print("POST&http%3A%2F%2F");
+  sha1.print("api.twitter.com");
+  staged_add(&sha1, staged_buffer, "/1/statuses/update.json", false);
+
+  sha1.write('&');
+
+  sha1.print("oauth_consumer_key");
+  sha1.print("%3D");
+  staged_add(&sha1, staged_buffer, "3azqS8rD5Ku7MRHY74qFRg", true);
+
+  cp = staged(Encoding::hex_encode(staged_buffer, staged_nonce,
+                                   sizeof(staged_nonce)));
+  staged_copied += cp - staged_buffer;
+  staged_add_param(&sha1, "oauth_nonce", staged_buffer, cp + 1);
+
+  staged_add_param(&sha1, "oauth_signature_method", "HMAC-SHA1",
+                   staged_buffer);
+
+  cp = staged_buffer + sprintf(staged_buffer, "%ld", 1318622958L);
+  staged(cp);
+  staged_copied += cp - staged_buffer;
+  staged_add_param(&sha1, "oauth_timestamp", staged_buffer, cp + 1);
+
+  sha1.print("%26");
+  sha1.print("oauth_token");
+  sha1.print("%3D");
+  staged_add(&sha1, staged_buffer, "123456789-AbCdEfGhIjKlMnOpQrStUvWxYz",
+             true);
+
+  staged_add_param(&sha1, "oauth_version", "1.0", staged_buffer);
+  staged_add_param(&sha1, "status", long_message, staged_buffer);
+
+  memcpy(staged_signature, sha1.resultHmac(), sizeof(staged_signature));
+  bench_sink ^= staged_signature[0];
+}
+
+/* The streaming signer with its nonce. */
+static void
+sign_streaming(size_t size)
+{
+  bench_sink ^= twitter.sign_status(1318622958, long_message)[0];
+}
+
+static void
+sign_streaming_cold(size_t size)
+{
+  twitter.set_client_id(PSTR("3azqS8rD5Ku7MRHY74qFRg"),
+                        PSTR("S67Jon338GJ0sNxMyWVe5ccfrH1z3HtjrVGj3xiXApQ"));
+  sign_streaming(size);
+}
+
+/* The number of bytes of the work buffer that a signature uses. */
+static size_t
+work_buffer_used(BenchFunc func)
+{
+  size_t len;
+
+  memset(work_buffer, 0xa5, sizeof(work_buffer));
+  func(LONG_MESSAGE_LEN);
+
+  for (len = sizeof(work_buffer); len > 0; len--)
+    if ((uint8_t) work_buffer[len - 1] != 0xa5)
+      break;
+
+  return len;
+}
+
+static void
+bench_sign(void)
+{
+  size_t len;
+
+  /* A message of realistic UTF-8 and ASCII text. */
+  for (len = 0; len < LONG_MESSAGE_LEN; len += strlen(long_message + len))
+    snprintf(long_message + len, sizeof(long_message) - len, "%s %s ",
+             message_finnish, message);
+
+  bench_run("twitter_sign_staged", LONG_MESSAGE_LEN, sign_staged);
+  bench_run("twitter_sign_streaming_cold", LONG_MESSAGE_LEN,
+            sign_streaming_cold);
+  bench_run("twitter_sign_streaming", LONG_MESSAGE_LEN, sign_streaming);
+
+  /* The memory the signers use besides the hash states: the staged
+     signer writes every encoded item into its buffer and reads it
+     back, the streaming one only encodes the HMAC key into the work
+     buffer and only when the key state is not cached. */
+  bench_value("twitter_sign_staged_buffer", "bytes", staged_peak);
+  bench_value("twitter_sign_staged_copied", "bytes", staged_copied);
+  bench_value("twitter_sign_streaming_cold_work_buffer", "bytes",
+              work_buffer_used(sign_streaming_cold));
+  bench_value("twitter_sign_streaming_work_buffer", "bytes",
+              work_buffer_used(sign_streaming));
+}
+
+/* The account id in EEPROM, as the Twitter sketch keeps it. */
+#define ACCESS_TOKEN_ADDR	0
+#define TOKEN_SECRET_ADDR	64
+
+static void
+eeprom_put(int address, const char *value)
+{
+  do
+    {
+      if (EEPROM.read(address) != (uint8_t) *value)
+        EEPROM.write(address, *value);
+      address++;
+    }
+  while (*value++);
+}
+
+static void
+compute_authorization_eeprom_cold(size_t size)
+{
+  /* Drop the cached key state.  The next signature reads and encodes
+     the token secret from EEPROM again. */
+  twitter.set_account_id(ACCESS_TOKEN_ADDR, TOKEN_SECRET_ADDR);
+  compute_authorization(size);
+}
+
+void
+bench_twitter(void)
+{
+  twitter.set_twitter_endpoint(PSTR("api.twitter.com"),
+                               PSTR("/1/statuses/update.json"),
+                               IPAddress(199, 59, 149, 232), 80, false);
+  twitter.set_account_id(PSTR("123456789-AbCdEfGhIjKlMnOpQrStUvWxYz"),
+                         PSTR("AbCdEfGhIjKlMnOpQrStUvWxYz0123456789AbCdEf"));
+
+  bench_url_encode("", message);
+  bench_url_encode("_finnish", message_finnish);
+  bench_url_encode("_japanese", message_japanese);
+  bench_run("twitter_compute_authorization_cold", 0,
+            compute_authorization_cold);
+  bench_run("twitter_compute_authorization", 0, compute_authorization);
+
+  bench_sign();
+
+  /* The per-post saving of the cached key state is the difference of
+     the cold and the cached cases. */
+  eeprom_put(ACCESS_TOKEN_ADDR, "123456789-AbCdEfGhIjKlMnOpQrStUvWxYz");
+  eeprom_put(TOKEN_SECRET_ADDR, "AbCdEfGhIjKlMnOpQrStUvWxYz0123456789AbCdEf");
+  twitter.set_account_id(ACCESS_TOKEN_ADDR, TOKEN_SECRET_ADDR);
+
+  bench_run("twitter_compute_authorization_eeprom_cold", 0,
+            compute_authorization_eeprom_cold);
+  bench_run("twitter_compute_authorization_eeprom", 0, compute_authorization);
+}
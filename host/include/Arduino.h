@@ -0,0 +1,86 @@
+/* -*- c++ -*-
+ *
+ * Arduino.h - Arduino API stand-in for host builds
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include <avr/pgmspace.h>
+
+#include "HardwareSerial.h"
+
+/* Host builds are built as Arduino 1.0 sketches. */
+#ifndef ARDUINO
+#define ARDUINO 100
+#endif
+
+#define HOST 1
+
+#define HIGH	1
+#define LOW	0
+
+#define INPUT	0
+#define OUTPUT	1
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef unsigned int word;
+
+/* The time since the program start from a monotonic clock. */
+unsigned long millis(void);
+unsigned long micros(void);
+
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/* There is no I/O hardware: the outputs are ignored and the inputs
+   read as LOW and 0. */
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned int seed);
+
+/* Initialize the host run-time.  This must be called before the other
+   functions; the sketch runner calls it before setup(). */
+void host_init(void);
+
+/* Advance millis() and micros() by `us' microseconds.  The tests use
+   this to run days of the sketch time without waiting for them. */
+void host_advance_time(unsigned long long us);
+
+/* The sketch entry points. */
+void setup(void);
+void loop(void);
+
+#endif /* not HOST_ARDUINO_H */
@@ -0,0 +1,51 @@
+/* -*- c++ -*-
+ *
+ * Client.h - network clients on the host
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_CLIENT_H
+#define HOST_CLIENT_H
+
+#include "Stream.h"
+#include "IPAddress.h"
+
+class Client : public Stream
+{
+public:
+
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char *host, uint16_t port) = 0;
+  virtual size_t write(uint8_t byte) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+  virtual int available(void) = 0;
+  virtual int read(void) = 0;
+  virtual int read(uint8_t *buffer, size_t size) = 0;
+  virtual int peek(void) = 0;
+  virtual void flush(void) = 0;
+  virtual void stop(void) = 0;
+  virtual uint8_t connected(void) = 0;
+  virtual operator bool() = 0;
+
+  using Print::write;
+};
+
+#endif /* not HOST_CLIENT_H */
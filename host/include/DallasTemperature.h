@@ -0,0 +1,66 @@
+/* -*- c++ -*-
+ *
+ * DallasTemperature.h - temperature sensor stand-in for host builds
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_DALLASTEMPERATURE_H
+#define HOST_DALLASTEMPERATURE_H
+
+#include <stdint.h>
+
+#include "OneWire.h"
+
+#define DEVICE_DISCONNECTED -127
+
+typedef uint8_t DeviceAddress[8];
+
+/* Simulated DS18B20 sensors.  The environment variable
+   HOST_TEMPERATURES lists the temperatures of the sensors in Celsius,
+   separated by commas; the default is one sensor at 20 degrees. */
+class DallasTemperature
+{
+public:
+
+  DallasTemperature(OneWire *bus);
+
+  void begin(void);
+
+  uint8_t getDeviceCount(void);
+
+  bool getAddress(uint8_t *address, uint8_t index);
+
+  void requestTemperatures(void);
+
+  float getTempC(uint8_t *address);
+
+  float getTempCByIndex(uint8_t index);
+
+private:
+
+  /* The maximum number of simulated sensors. */
+  static const uint8_t max_devices = 8;
+
+  uint8_t count;
+  float temperatures[max_devices];
+};
+
+#endif /* not HOST_DALLASTEMPERATURE_H */
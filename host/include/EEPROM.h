@@ -0,0 +1,56 @@
+/* -*- c++ -*-
+ *
+ * EEPROM.h - EEPROM stand-in for host builds
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include <stdint.h>
+
+/* The size of the ATmega328 EEPROM. */
+#define HOST_EEPROM_SIZE 1024
+
+/* The EEPROM contents are kept in the file named by the environment
+   variable HOST_EEPROM, by default `eeprom.bin' next to the
+   executable, i.e. in `build/bin'.  A missing file reads as erased memory. */
+class EEPROMClass
+{
+public:
+
+  EEPROMClass();
+
+  uint8_t read(int address);
+  void write(int address, uint8_t value);
+
+private:
+
+  /* Load the EEPROM file on the first access. */
+  void load(void);
+
+  uint8_t data[HOST_EEPROM_SIZE];
+  bool loaded;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif /* not HOST_EEPROM_H */
@@ -0,0 +1,97 @@
+/* -*- c++ -*-
+ *
+ * Ethernet.h - Ethernet library stand-in for host builds
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_ETHERNET_H
+#define HOST_ETHERNET_H
+
+#include "Arduino.h"
+#include "Client.h"
+#include "IPAddress.h"
+
+/* The network interface.  The host network is used as-is so the
+   configuration is only recorded. */
+class EthernetClass
+{
+public:
+
+  /* Configure the interface with DHCP.  Always succeeds. */
+  int begin(uint8_t *mac);
+
+  void begin(uint8_t *mac, IPAddress ip);
+  void begin(uint8_t *mac, IPAddress ip, IPAddress dns);
+  void begin(uint8_t *mac, IPAddress ip, IPAddress dns, IPAddress gateway);
+  void begin(uint8_t *mac, IPAddress ip, IPAddress dns, IPAddress gateway,
+             IPAddress subnet);
+
+  IPAddress localIP(void);
+  IPAddress subnetMask(void);
+  IPAddress gatewayIP(void);
+  IPAddress dnsServerIP(void);
+
+private:
+
+  IPAddress ip;
+  IPAddress dns;
+  IPAddress gateway;
+  IPAddress subnet;
+};
+
+extern EthernetClass Ethernet;
+
+/* A TCP client on a POSIX socket.  Like on the boards, the copies of
+   a client share the same connection. */
+class EthernetClient : public Client
+{
+public:
+
+  EthernetClient();
+
+  virtual int connect(IPAddress ip, uint16_t port);
+  virtual int connect(const char *host, uint16_t port);
+  virtual size_t write(uint8_t byte);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  virtual int available(void);
+  virtual int read(void);
+  virtual int read(uint8_t *buffer, size_t size);
+  virtual int peek(void);
+  virtual void flush(void);
+  virtual void stop(void);
+  virtual uint8_t connected(void);
+  virtual operator bool();
+
+  using Print::write;
+
+private:
+
+  /* Connect the socket to the address `addr', `addr_len'. */
+  int connect_address(const void *addr, size_t addr_len);
+
+  /* The socket or -1. */
+  int fd;
+
+  /* Has the peer closed the connection? */
+  bool eof;
+};
+
+#endif /* not HOST_ETHERNET_H */
@@ -0,0 +1,59 @@
+/* -*- c++ -*-
+ *
+ * HardwareSerial.h - serial port on the host
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_HARDWARESERIAL_H
+#define HOST_HARDWARESERIAL_H
+
+#include "Stream.h"
+
+/* The serial port reads the standard input and writes to the standard
+   output.  The input never blocks. */
+class HardwareSerial : public Stream
+{
+public:
+
+  HardwareSerial();
+
+  void begin(unsigned long baud);
+  void end(void);
+
+  virtual int available(void);
+  virtual int read(void);
+  virtual int peek(void);
+  virtual void flush(void);
+
+  virtual size_t write(uint8_t byte);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+
+  using Print::write;
+
+private:
+
+  /* The byte read ahead by peek() or -1. */
+  int peeked;
+};
+
+extern HardwareSerial Serial;
+
+#endif /* not HOST_HARDWARESERIAL_H */
@@ -0,0 +1,60 @@
+/* -*- c++ -*-
+ *
+ * IPAddress.h - IPv4 addresses on the host
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include <stdint.h>
+
+#include "Printable.h"
+
+class IPAddress : public Printable
+{
+public:
+
+  IPAddress();
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+  IPAddress(uint32_t address);
+  IPAddress(const uint8_t *address);
+
+  operator uint32_t() const;
+
+  uint8_t operator[](int index) const
+  {
+    return bytes[index];
+  }
+
+  uint8_t &operator[](int index)
+  {
+    return bytes[index];
+  }
+
+  virtual size_t printTo(Print &p) const;
+
+private:
+
+  uint8_t bytes[4];
+};
+
+#endif /* not HOST_IPADDRESS_H */
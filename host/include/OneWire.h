@@ -0,0 +1,57 @@
+/* -*- c++ -*-
+ *
+ * OneWire.h - OneWire bus stand-in for host builds
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_ONEWIRE_H
+#define HOST_ONEWIRE_H
+
+#include "Arduino.h"
+
+/* The CRC functions are built from the OneWire library's
+   OneWireCRC.cpp with the same options as on the target. */
+#define ONEWIRE_CRC 1
+#define ONEWIRE_CRC8_TABLE 1
+#define ONEWIRE_CRC16 1
+
+/* The OneWire bus.  The bus has no devices on it; the sensors are
+   simulated by the DallasTemperature stand-in. */
+class OneWire
+{
+public:
+
+  OneWire(uint8_t pin)
+    : pin(pin)
+  {
+  }
+
+  static uint8_t crc8(uint8_t *addr, uint8_t len);
+  static bool check_crc16(uint8_t *input, uint16_t len,
+                          uint8_t *inverted_crc);
+  static uint16_t crc16(uint8_t *input, uint16_t len);
+
+private:
+
+  uint8_t pin;
+};
+
+#endif /* not HOST_ONEWIRE_H */
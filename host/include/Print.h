@@ -0,0 +1,81 @@
+/* -*- c++ -*-
+ *
+ * Print.h - formatted output on the host
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Printable.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+/* The Arduino 1.0 Print class.  Subclasses implement write(uint8_t)
+   and optionally the bulk write(). */
+class Print
+{
+public:
+
+  virtual size_t write(uint8_t byte) = 0;
+
+  virtual size_t write(const uint8_t *buffer, size_t size);
+
+  size_t write(const char *str)
+  {
+    return write((const uint8_t *) str, strlen(str));
+  }
+
+  size_t print(const char str[]);
+  size_t print(char ch);
+  size_t print(unsigned char value, int base = DEC);
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned int value, int base = DEC);
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+  size_t print(const Printable &value);
+
+  size_t println(const char str[]);
+  size_t println(char ch);
+  size_t println(unsigned char value, int base = DEC);
+  size_t println(int value, int base = DEC);
+  size_t println(unsigned int value, int base = DEC);
+  size_t println(long value, int base = DEC);
+  size_t println(unsigned long value, int base = DEC);
+  size_t println(double value, int digits = 2);
+  size_t println(const Printable &value);
+  size_t println(void);
+
+private:
+
+  size_t print_number(unsigned long value, uint8_t base);
+};
+
+#endif /* not HOST_PRINT_H */
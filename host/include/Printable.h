@@ -0,0 +1,40 @@
+/* -*- c++ -*-
+ *
+ * Printable.h - printable objects on the host
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_PRINTABLE_H
+#define HOST_PRINTABLE_H
+
+#include <stddef.h>
+
+class Print;
+
+/* Objects that can print themselves with Print::print(). */
+class Printable
+{
+public:
+
+  virtual size_t printTo(Print &p) const = 0;
+};
+
+#endif /* not HOST_PRINTABLE_H */
@@ -0,0 +1,60 @@
+/* -*- c++ -*-
+ *
+ * SoftwareSerial.h - software serial port stand-in for host builds
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_SOFTWARESERIAL_H
+#define HOST_SOFTWARESERIAL_H
+
+#include "Arduino.h"
+
+/* The software serial port is connected to the device or FIFO named
+   by the environment variable HOST_SOFTWARESERIAL.  Without it the
+   written data is discarded and no data is received. */
+class SoftwareSerial : public Stream
+{
+public:
+
+  SoftwareSerial(uint8_t rx_pin, uint8_t tx_pin);
+
+  void begin(long baud);
+  void end(void);
+
+  virtual int available(void);
+  virtual int read(void);
+  virtual int peek(void);
+  virtual void flush(void);
+
+  virtual size_t write(uint8_t byte);
+
+  using Print::write;
+
+private:
+
+  /* The port device or -1. */
+  int fd;
+
+  /* The byte read ahead by available() or peek() or -1. */
+  int peeked;
+};
+
+#endif /* not HOST_SOFTWARESERIAL_H */
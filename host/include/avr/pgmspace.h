@@ -0,0 +1,99 @@
+/* -*- c++ -*-
+ *
+ * avr/pgmspace.h - program memory access on the host
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+/* The host has a single address space so the program memory data is
+   plain constant data. */
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char *
+
+typedef char prog_char;
+typedef unsigned char prog_uchar;
+typedef int8_t prog_int8_t;
+typedef uint8_t prog_uint8_t;
+typedef int16_t prog_int16_t;
+typedef uint16_t prog_uint16_t;
+typedef int32_t prog_int32_t;
+typedef uint32_t prog_uint32_t;
+
+static inline uint8_t
+pgm_read_byte(const void *addr)
+{
+  return *(const uint8_t *) addr;
+}
+
+static inline uint16_t
+pgm_read_word(const void *addr)
+{
+  uint16_t value;
+
+  memcpy(&value, addr, sizeof(value));
+
+  return value;
+}
+
+static inline uint32_t
+pgm_read_dword(const void *addr)
+{
+  uint32_t value;
+
+  memcpy(&value, addr, sizeof(value));
+
+  return value;
+}
+
+static inline void *
+pgm_read_ptr(const void *addr)
+{
+  void *value;
+
+  memcpy(&value, addr, sizeof(value));
+
+  return value;
+}
+#define pgm_read_ptr pgm_read_ptr
+
+#define pgm_read_byte_near(addr)	pgm_read_byte(addr)
+#define pgm_read_word_near(addr)	pgm_read_word(addr)
+#define pgm_read_dword_near(addr)	pgm_read_dword(addr)
+
+#define memcpy_P	memcpy
+#define strlen_P	strlen
+#define strcmp_P	strcmp
+#define strncmp_P	strncmp
+#define strcasecmp_P	strcasecmp
+#define strncasecmp_P	strncasecmp
+#define strcpy_P	strcpy
+#define strncpy_P	strncpy
+#define strcat_P	strcat
+
+#endif /* not HOST_AVR_PGMSPACE_H */
@@ -0,0 +1,143 @@
+/*
+ * Arduino.cpp - Arduino core functions for host builds
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "Arduino.h"
+
+/* The program start time. */
+static struct timespec start_time;
+
+/* The simulated time added to the clock by host_advance_time(). */
+static unsigned long long advance_us;
+
+void
+host_init(void)
+{
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+}
+
+/* The time since the program start in microseconds. */
+static unsigned long long
+elapsed_us(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (unsigned long long) (now.tv_sec - start_time.tv_sec) * 1000000
+    + (now.tv_nsec - start_time.tv_nsec) / 1000 + advance_us;
+}
+
+void
+host_advance_time(unsigned long long us)
+{
+  advance_us += us;
+}
+
+unsigned long
+millis(void)
+{
+  return elapsed_us() / 1000;
+}
+
+unsigned long
+micros(void)
+{
+  return elapsed_us();
+}
+
+void
+delay(unsigned long ms)
+{
+  struct timespec ts;
+
+  /* Flush the serial output so that it is visible while we wait. */
+  Serial.flush();
+
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (ms % 1000) * 1000000L;
+
+  while (nanosleep(&ts, &ts) != 0)
+    ;
+}
+
+void
+delayMicroseconds(unsigned int us)
+{
+  struct timespec ts;
+
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = (us % 1000000) * 1000L;
+
+  while (nanosleep(&ts, &ts) != 0)
+    ;
+}
+
+void
+pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void
+digitalWrite(uint8_t pin, uint8_t value)
+{
+}
+
+int
+digitalRead(uint8_t pin)
+{
+  return LOW;
+}
+
+int
+analogRead(uint8_t pin)
+{
+  return 0;
+}
+
+long
+random(long max)
+{
+  if (max == 0)
+    return 0;
+
+  return random() % max;
+}
+
+long
+random(long min, long max)
+{
+  if (min >= max)
+    return min;
+
+  return random(max - min) + min;
+}
+
+void
+randomSeed(unsigned int seed)
+{
+  if (seed != 0)
+    srandom(seed);
+}
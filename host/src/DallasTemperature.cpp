@@ -0,0 +1,99 @@
+/*
+ * DallasTemperature.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "DallasTemperature.h"
+
+DallasTemperature::DallasTemperature(OneWire *bus)
+  : count(0)
+{
+}
+
+void
+DallasTemperature::begin(void)
+{
+  const char *cp = getenv("HOST_TEMPERATURES");
+  char *end;
+
+  count = 0;
+
+  if (cp == 0)
+    {
+      temperatures[count++] = 20.0;
+      return;
+    }
+
+  while (*cp && count < max_devices)
+    {
+      temperatures[count++] = strtod(cp, &end);
+      if (*end != ',')
+        break;
+      cp = end + 1;
+    }
+}
+
+uint8_t
+DallasTemperature::getDeviceCount(void)
+{
+  return count;
+}
+
+bool
+DallasTemperature::getAddress(uint8_t *address, uint8_t index)
+{
+  if (index >= count)
+    return false;
+
+  /* A DS18B20 family code and the sensor index as the serial
+     number. */
+  memset(address, 0, sizeof(DeviceAddress));
+  address[0] = 0x28;
+  address[1] = index;
+
+  return true;
+}
+
+void
+DallasTemperature::requestTemperatures(void)
+{
+}
+
+float
+DallasTemperature::getTempC(uint8_t *address)
+{
+  if (address[0] != 0x28)
+    return DEVICE_DISCONNECTED;
+
+  return getTempCByIndex(address[1]);
+}
+
+float
+DallasTemperature::getTempCByIndex(uint8_t index)
+{
+  if (index >= count)
+    return DEVICE_DISCONNECTED;
+
+  return temperatures[index];
+}
@@ -0,0 +1,119 @@
+/*
+ * EEPROM.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
+
+/* The EEPROM file name.  The default is `eeprom.bin' in the
+   directory of the executable so that the image stays in the build
+   tree whatever the current directory is. */
+static const char *
+eeprom_file(void)
+{
+  static char path[4096];
+  const char *name = getenv("HOST_EEPROM");
+  ssize_t len;
+  char *slash;
+
+  if (name)
+    return name;
+
+  if (path[0])
+    return path;
+
+  len = readlink("/proc/self/exe", path, sizeof(path) - sizeof("eeprom.bin"));
+  if (len <= 0 || (slash = (char *) memrchr(path, '/', len)) == 0)
+    {
+      strcpy(path, "eeprom.bin");
+      return path;
+    }
+
+  strcpy(slash + 1, "eeprom.bin");
+
+  return path;
+}
+
+EEPROMClass::EEPROMClass()
+  : loaded(false)
+{
+}
+
+uint8_t
+EEPROMClass::read(int address)
+{
+  load();
+
+  if (address < 0 || address >= HOST_EEPROM_SIZE)
+    return 0xff;
+
+  return data[address];
+}
+
+void
+EEPROMClass::write(int address, uint8_t value)
+{
+  FILE *fp;
+
+  load();
+
+  if (address < 0 || address >= HOST_EEPROM_SIZE)
+    return;
+
+  data[address] = value;
+
+  /* Write the whole image so that the file is always complete. */
+  fp = fopen(eeprom_file(), "wb");
+  if (fp == 0)
+    return;
+
+  fwrite(data, 1, sizeof(data), fp);
+  fclose(fp);
+}
+
+void
+EEPROMClass::load(void)
+{
+  FILE *fp;
+  size_t got = 0;
+
+  if (loaded)
+    return;
+
+  fp = fopen(eeprom_file(), "rb");
+  if (fp)
+    {
+      got = fread(data, 1, sizeof(data), fp);
+      fclose(fp);
+    }
+
+  /* The rest reads as erased memory. */
+  memset(data + got, 0xff, sizeof(data) - got);
+
+  loaded = true;
+}
@@ -0,0 +1,85 @@
+/*
+ * Ethernet.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Ethernet.h"
+
+EthernetClass Ethernet;
+
+int
+EthernetClass::begin(uint8_t *mac)
+{
+  return 1;
+}
+
+void
+EthernetClass::begin(uint8_t *mac, IPAddress ip)
+{
+  begin(mac, ip, IPAddress(ip[0], ip[1], ip[2], 1));
+}
+
+void
+EthernetClass::begin(uint8_t *mac, IPAddress ip, IPAddress dns)
+{
+  begin(mac, ip, dns, IPAddress(ip[0], ip[1], ip[2], 1));
+}
+
+void
+EthernetClass::begin(uint8_t *mac, IPAddress ip, IPAddress dns,
+                     IPAddress gateway)
+{
+  begin(mac, ip, dns, gateway, IPAddress(255, 255, 255, 0));
+}
+
+void
+EthernetClass::begin(uint8_t *mac, IPAddress ip, IPAddress dns,
+                     IPAddress gateway, IPAddress subnet)
+{
+  this->ip = ip;
+  this->dns = dns;
+  this->gateway = gateway;
+  this->subnet = subnet;
+}
+
+IPAddress
+EthernetClass::localIP(void)
+{
+  return ip;
+}
+
+IPAddress
+EthernetClass::subnetMask(void)
+{
+  return subnet;
+}
+
+IPAddress
+EthernetClass::gatewayIP(void)
+{
+  return gateway;
+}
+
+IPAddress
+EthernetClass::dnsServerIP(void)
+{
+  return dns;
+}
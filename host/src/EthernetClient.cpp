@@ -0,0 +1,213 @@
+/*
+ * EthernetClient.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Ethernet.h"
+
+EthernetClient::EthernetClient()
+  : fd(-1),
+    eof(false)
+{
+}
+
+int
+EthernetClient::connect(IPAddress ip, uint16_t port)
+{
+  struct sockaddr_in addr;
+  uint32_t address = ip;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  memcpy(&addr.sin_addr, &address, sizeof(address));
+
+  return connect_address(&addr, sizeof(addr));
+}
+
+int
+EthernetClient::connect(const char *host, uint16_t port)
+{
+  struct addrinfo hints;
+  struct addrinfo *result;
+  struct sockaddr_in addr;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  if (getaddrinfo(host, 0, &hints, &result) != 0)
+    return 0;
+
+  memcpy(&addr, result->ai_addr, sizeof(addr));
+  addr.sin_port = htons(port);
+
+  freeaddrinfo(result);
+
+  return connect_address(&addr, sizeof(addr));
+}
+
+int
+EthernetClient::connect_address(const void *addr, size_t addr_len)
+{
+  int on = 1;
+
+  stop();
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return 0;
+
+  if (::connect(fd, (const struct sockaddr *) addr, addr_len) < 0)
+    {
+      stop();
+      return 0;
+    }
+
+  /* The Ethernet controller sends each write as soon as it is made;
+     do the same so that the packets look like on the boards. */
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+  return 1;
+}
+
+size_t
+EthernetClient::write(uint8_t byte)
+{
+  return write(&byte, 1);
+}
+
+size_t
+EthernetClient::write(const uint8_t *buffer, size_t size)
+{
+  size_t pos = 0;
+  ssize_t got;
+
+  while (fd >= 0 && pos < size)
+    {
+      got = send(fd, buffer + pos, size - pos, MSG_NOSIGNAL);
+      if (got < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          break;
+        }
+
+      pos += got;
+    }
+
+  return pos;
+}
+
+int
+EthernetClient::available(void)
+{
+  int count = 0;
+  uint8_t byte;
+
+  if (fd < 0 || ioctl(fd, FIONREAD, &count) < 0)
+    return 0;
+
+  /* No data can also mean that the peer has closed the connection. */
+  if (count == 0 && recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0)
+    eof = true;
+
+  return count;
+}
+
+int
+EthernetClient::read(void)
+{
+  uint8_t byte;
+
+  if (read(&byte, 1) != 1)
+    return -1;
+
+  return byte;
+}
+
+int
+EthernetClient::read(uint8_t *buffer, size_t size)
+{
+  ssize_t got;
+
+  if (fd < 0)
+    return -1;
+
+  got = recv(fd, buffer, size, MSG_DONTWAIT);
+  if (got == 0)
+    eof = true;
+
+  return got > 0 ? got : -1;
+}
+
+int
+EthernetClient::peek(void)
+{
+  uint8_t byte;
+
+  if (fd < 0 || recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) != 1)
+    return -1;
+
+  return byte;
+}
+
+void
+EthernetClient::flush(void)
+{
+  uint8_t buffer[64];
+
+  /* Like on the boards, flush() discards the pending input. */
+  while (available() > 0 && read(buffer, sizeof(buffer)) > 0)
+    ;
+}
+
+void
+EthernetClient::stop(void)
+{
+  if (fd >= 0)
+    close(fd);
+
+  fd = -1;
+  eof = false;
+}
+
+uint8_t
+EthernetClient::connected(void)
+{
+  if (fd < 0)
+    return 0;
+
+  return available() > 0 || !eof;
+}
+
+EthernetClient::operator bool()
+{
+  return fd >= 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * HardwareSerial.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "HardwareSerial.h"
+
+HardwareSerial Serial;
+
+HardwareSerial::HardwareSerial()
+  : peeked(-1)
+{
+}
+
+void
+HardwareSerial::begin(unsigned long baud)
+{
+}
+
+void
+HardwareSerial::end(void)
+{
+  flush();
+}
+
+int
+HardwareSerial::available(void)
+{
+  struct pollfd pfd;
+
+  if (peeked >= 0)
+    return 1;
+
+  pfd.fd = STDIN_FILENO;
+  pfd.events = POLLIN;
+
+  if (poll(&pfd, 1, 0) != 1 || !(pfd.revents & POLLIN))
+    return 0;
+
+  /* Read ahead one byte to tell data from the end of input. */
+  return peek() >= 0 ? 1 : 0;
+}
+
+int
+HardwareSerial::read(void)
+{
+  int ch = peek();
+
+  peeked = -1;
+
+  return ch;
+}
+
+int
+HardwareSerial::peek(void)
+{
+  struct pollfd pfd;
+  uint8_t byte;
+
+  if (peeked >= 0)
+    return peeked;
+
+  pfd.fd = STDIN_FILENO;
+  pfd.events = POLLIN;
+
+  if (poll(&pfd, 1, 0) != 1 || ::read(STDIN_FILENO, &byte, 1) != 1)
+    return -1;
+
+  peeked = byte;
+
+  return peeked;
+}
+
+void
+HardwareSerial::flush(void)
+{
+  fflush(stdout);
+}
+
+size_t
+HardwareSerial::write(uint8_t byte)
+{
+  return putchar(byte) == EOF ? 0 : 1;
+}
+
+size_t
+HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  return fwrite(buffer, 1, size, stdout);
+}
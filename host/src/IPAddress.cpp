@@ -0,0 +1,75 @@
+/*
+ * IPAddress.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include "IPAddress.h"
+#include "Print.h"
+
+IPAddress::IPAddress()
+{
+  memset(bytes, 0, sizeof(bytes));
+}
+
+IPAddress::IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+  bytes[0] = a;
+  bytes[1] = b;
+  bytes[2] = c;
+  bytes[3] = d;
+}
+
+IPAddress::IPAddress(uint32_t address)
+{
+  memcpy(bytes, &address, sizeof(bytes));
+}
+
+IPAddress::IPAddress(const uint8_t *address)
+{
+  memcpy(bytes, address, sizeof(bytes));
+}
+
+IPAddress::operator uint32_t() const
+{
+  uint32_t address;
+
+  memcpy(&address, bytes, sizeof(address));
+
+  return address;
+}
+
+size_t
+IPAddress::printTo(Print &p) const
+{
+  size_t n = 0;
+  int i;
+
+  for (i = 0; i < 4; i++)
+    {
+      if (i > 0)
+        n += p.print('.');
+      n += p.print(bytes[i], DEC);
+    }
+
+  return n;
+}
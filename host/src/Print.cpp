@@ -0,0 +1,183 @@
+/*
+ * Print.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+
+#include "Print.h"
+
+size_t
+Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (write(buffer[i]) != 1)
+      break;
+
+  return i;
+}
+
+size_t
+Print::print(const char str[])
+{
+  return write(str);
+}
+
+size_t
+Print::print(char ch)
+{
+  return write((uint8_t) ch);
+}
+
+size_t
+Print::print(unsigned char value, int base)
+{
+  return print((unsigned long) value, base);
+}
+
+size_t
+Print::print(int value, int base)
+{
+  return print((long) value, base);
+}
+
+size_t
+Print::print(unsigned int value, int base)
+{
+  return print((unsigned long) value, base);
+}
+
+size_t
+Print::print(long value, int base)
+{
+  /* Like on the boards, only the decimal numbers are signed. */
+  if (base == DEC && value < 0)
+    return print('-') + print_number(-(unsigned long) value, DEC);
+
+  return print_number((unsigned long) value, base);
+}
+
+size_t
+Print::print(unsigned long value, int base)
+{
+  return print_number(value, base);
+}
+
+size_t
+Print::print(double value, int digits)
+{
+  char buf[64];
+
+  snprintf(buf, sizeof(buf), "%.*f", digits, value);
+
+  return write(buf);
+}
+
+size_t
+Print::print(const Printable &value)
+{
+  return value.printTo(*this);
+}
+
+size_t
+Print::println(const char str[])
+{
+  return print(str) + println();
+}
+
+size_t
+Print::println(char ch)
+{
+  return print(ch) + println();
+}
+
+size_t
+Print::println(unsigned char value, int base)
+{
+  return print(value, base) + println();
+}
+
+size_t
+Print::println(int value, int base)
+{
+  return print(value, base) + println();
+}
+
+size_t
+Print::println(unsigned int value, int base)
+{
+  return print(value, base) + println();
+}
+
+size_t
+Print::println(long value, int base)
+{
+  return print(value, base) + println();
+}
+
+size_t
+Print::println(unsigned long value, int base)
+{
+  return print(value, base) + println();
+}
+
+size_t
+Print::println(double value, int digits)
+{
+  return print(value, digits) + println();
+}
+
+size_t
+Print::println(const Printable &value)
+{
+  return print(value) + println();
+}
+
+size_t
+Print::println(void)
+{
+  return write("\r\n");
+}
+
+size_t
+Print::print_number(unsigned long value, uint8_t base)
+{
+  char buf[8 * sizeof(value) + 1];
+  char *cp = buf + sizeof(buf);
+
+  if (base < 2)
+    base = DEC;
+
+  *--cp = '\0';
+
+  do
+    {
+      uint8_t digit = value % base;
+
+      *--cp = digit < 10 ? '0' + digit : 'A' + digit - 10;
+      value /= base;
+    }
+  while (value);
+
+  return write(cp);
+}
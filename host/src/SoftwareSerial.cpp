@@ -0,0 +1,97 @@
+/*
+ * SoftwareSerial.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "SoftwareSerial.h"
+
+SoftwareSerial::SoftwareSerial(uint8_t rx_pin, uint8_t tx_pin)
+  : fd(-1),
+    peeked(-1)
+{
+}
+
+void
+SoftwareSerial::begin(long baud)
+{
+  const char *name = getenv("HOST_SOFTWARESERIAL");
+
+  end();
+
+  if (name)
+    fd = open(name, O_RDWR | O_NONBLOCK | O_NOCTTY);
+}
+
+void
+SoftwareSerial::end(void)
+{
+  if (fd >= 0)
+    close(fd);
+
+  fd = -1;
+  peeked = -1;
+}
+
+int
+SoftwareSerial::available(void)
+{
+  return peek() >= 0 ? 1 : 0;
+}
+
+int
+SoftwareSerial::read(void)
+{
+  int ch = peek();
+
+  peeked = -1;
+
+  return ch;
+}
+
+int
+SoftwareSerial::peek(void)
+{
+  uint8_t byte;
+
+  if (peeked < 0 && fd >= 0 && ::read(fd, &byte, 1) == 1)
+    peeked = byte;
+
+  return peeked;
+}
+
+void
+SoftwareSerial::flush(void)
+{
+  peeked = -1;
+}
+
+size_t
+SoftwareSerial::write(uint8_t byte)
+{
+  if (fd < 0)
+    return 1;
+
+  return ::write(fd, &byte, 1) == 1 ? 1 : 0;
+}
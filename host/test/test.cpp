@@ -0,0 +1,78 @@
+/*
+ * test.cpp - checks for the host tests
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+
+unsigned long test_failures;
+
+bool
+test_check(bool ok, const char *expr, const char *file, int line)
+{
+  if (!ok)
+    {
+      fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+      test_failures++;
+    }
+
+  return ok;
+}
+
+bool
+test_check_bytes(const void *a, const void *b, size_t len,
+                 const char *expr, const char *file, int line)
+{
+  const uint8_t *ap = (const uint8_t *) a;
+  const uint8_t *bp = (const uint8_t *) b;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    if (ap[i] != bp[i])
+      {
+        fprintf(stderr,
+                "%s:%d: check failed: %s differs at byte %lu of %lu: "
+                "0x%02x != 0x%02x\n",
+                file, line, expr, (unsigned long) i, (unsigned long) len,
+                ap[i], bp[i]);
+        test_failures++;
+        return false;
+      }
+
+  return true;
+}
+
+int
+test_exit(const char *name)
+{
+  if (test_failures)
+    {
+      printf("FAIL %s: %lu checks failed\n", name, test_failures);
+      return 1;
+    }
+
+  printf("PASS %s\n", name);
+
+  return 0;
+}
@@ -0,0 +1,54 @@
+/* -*- c++ -*-
+ *
+ * test.h - checks for the host tests
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include "Arduino.h"
+
+/* Each test is a program of its own with a main() that runs its
+   checks and returns test_exit().  A failed check is reported with
+   its location and the test continues with the next check. */
+
+/* Check that `expr' is true. */
+#define TEST_CHECK(expr) \
+  test_check((expr), #expr, __FILE__, __LINE__)
+
+/* Check that the `len' bytes at `a' and `b' are equal. */
+#define TEST_CHECK_BYTES(a, b, len) \
+  test_check_bytes((a), (b), (len), #a, __FILE__, __LINE__)
+
+/* The number of failed checks. */
+extern unsigned long test_failures;
+
+bool test_check(bool ok, const char *expr, const char *file, int line);
+
+bool test_check_bytes(const void *a, const void *b, size_t len,
+                      const char *expr, const char *file, int line);
+
+/* Print the result of the test `name' and return the exit status for
+   main(). */
+int test_exit(const char *name);
+
+#endif /* not TEST_H */
@@ -0,0 +1,316 @@
+/*
+ * test_client_buffer.cpp - client writes of the HTTP requests
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The test sends a Twitter status update with post_status() and a
+   WeatherServer data post with http_json_request() to a fake
+   EthernetClient that counts the writes made to it, and checks that
+   the requests reach the client in a few buffer-sized writes.  Every
+   write is a separate operation with the Ethernet controller.
+
+   `make test' runs the test again from a build with
+   CLIENT_BUFFER_UNBUFFERED defined, where ClientBuffer passes every
+   write to the client, and there the test checks that the same
+   requests take many times more writes.
+
+   The WeatherServer parameter query is run with a JSON reply, which
+   is parsed as it arrives and not stored, and with the reply of older
+   servers, and from loop() before the data post.
+
+   The WeatherServer sketch is included here to reach its static
+   functions.  The fake client is linked instead of the one
+   in libhost.a since this program defines all the EthernetClient
+   methods. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <Twitter.h>
+
+#include "../../WeatherServer/WeatherServer.pde"
+
+#include "test.h"
+
+/* The request written to the client and the number of writes. */
+static uint8_t request[2048];
+static size_t request_len;
+static unsigned long client_writes;
+
+/* The response of the fake server.  The server closes the connection
+   after it. */
+static const char *response;
+static size_t response_len;
+static size_t response_pos;
+
+EthernetClient::EthernetClient()
+  : fd(-1),
+    eof(false)
+{
+}
+
+int
+EthernetClient::connect(IPAddress ip, uint16_t port)
+{
+  fd = 1;
+  request_len = 0;
+  client_writes = 0;
+  response_pos = 0;
+
+  return 1;
+}
+
+int
+EthernetClient::connect(const char *host, uint16_t port)
+{
+  return connect(IPAddress(127, 0, 0, 1), port);
+}
+
+size_t
+EthernetClient::write(uint8_t byte)
+{
+  return write(&byte, 1);
+}
+
+size_t
+EthernetClient::write(const uint8_t *buffer, size_t size)
+{
+  if (fd < 0 || size > sizeof(request) - request_len)
+    return 0;
+
+  client_writes++;
+  memcpy(request + request_len, buffer, size);
+  request_len += size;
+
+  return size;
+}
+
+int
+EthernetClient::available(void)
+{
+  if (fd < 0)
+    return 0;
+
+  return response_len - response_pos;
+}
+
+int
+EthernetClient::read(void)
+{
+  if (available() <= 0)
+    return -1;
+
+  return (uint8_t) response[response_pos++];
+}
+
+int
+EthernetClient::read(uint8_t *buffer, size_t size)
+{
+  size_t i;
+  int ch;
+
+  for (i = 0; i < size && (ch = read()) >= 0; i++)
+    buffer[i] = ch;
+
+  return i ? i : -1;
+}
+
+int
+EthernetClient::peek(void)
+{
+  if (available() <= 0)
+    return -1;
+
+  return (uint8_t) response[response_pos];
+}
+
+void
+EthernetClient::flush(void)
+{
+}
+
+void
+EthernetClient::stop(void)
+{
+  fd = -1;
+}
+
+uint8_t
+EthernetClient::connected(void)
+{
+  return available() > 0;
+}
+
+EthernetClient::operator bool()
+{
+  return fd >= 0;
+}
+
+static void
+set_response(const char *data)
+{
+  response = data;
+  response_len = strlen(data);
+}
+
+/* Check the writes of the request `name'.  Buffered, the request
+   fills writes of `buffer_len' bytes but for the last one.
+   Unbuffered, it is written in pieces of a few bytes. */
+static void
+check_writes(const char *name, size_t buffer_len)
+{
+  printf("%s: %lu bytes in %lu writes\n",
+         name, (unsigned long) request_len, client_writes);
+
+#ifdef CLIENT_BUFFER_UNBUFFERED
+  TEST_CHECK(client_writes >= request_len / 8);
+#else /* not CLIENT_BUFFER_UNBUFFERED */
+  TEST_CHECK(client_writes == (request_len + buffer_len - 1) / buffer_len);
+#endif /* not CLIENT_BUFFER_UNBUFFERED */
+}
+
+/* Check the Authorization header of the WeatherServer request for the
+   HMAC of `content'. */
+static void
+check_authorization(const char *content)
+{
+  HmacClass hmac;
+  char expected[128];
+  char *cp;
+  uint8_t *digest;
+  int i;
+
+  hmac.initHmac(secret, sizeof(secret));
+  hmac.print(content);
+  digest = hmac.resultHmac();
+
+  cp = expected + sprintf(expected, "\r\nAuthorization: %s ", HMAC_SCHEME);
+  for (i = 0; i < HMAC_LENGTH; i++)
+    cp += sprintf(cp, "%02x", digest[i]);
+  strcpy(cp, "\r\n");
+
+  TEST_CHECK(memmem(request, request_len, expected, strlen(expected)) != 0);
+}
+
+static char work_buffer[256];
+static Twitter twitter(work_buffer, sizeof(work_buffer));
+
+int
+main(int argc, char *argv[])
+{
+  static const char message[]
+    = "Temperature 21.5\xc2\xb0" "C & humidity 40% (sensor #1) ~ok";
+  static const char content[]
+    = "{\"id\":\"0102030405060708\",\"sn\":42,\"c\":[{\"id\":\"a1\","
+    "\"s\":[{\"id\":\"t0\",\"v\":2150},{\"id\":\"h0\",\"v\":40}]}]}";
+  static const char json_reply[]
+    = "HTTP/1.1 200 OK\r\n"
+    "Content-Type: application/json\r\n"
+    "\r\n"
+    "{\"s\":43,\"t\":1792238400}";
+  int32_t code;
+  uint8_t reply[128];
+
+  host_init();
+
+  /* Twitter status update. */
+  twitter.set_twitter_endpoint(PSTR("api.twitter.com"),
+                               PSTR("/1/statuses/update.json"),
+                               IPAddress(127, 0, 0, 1), 80, false);
+  twitter.set_client_id(PSTR("3azqS8rD5Ku7MRHY74qFRg"),
+                        PSTR("S67Jon338GJ0sNxMyWVe5ccfrH1z3HtjrVGj3xiXApQ"));
+  twitter.set_account_id(PSTR("123456789-AbCdEfGhIjKlMnOpQrStUvWxYz"),
+                         PSTR("AbCdEfGhIjKlMnOpQrStUvWxYz0123456789AbCdEf"));
+  twitter.set_timeout(10000);
+
+  set_response("HTTP/1.1 200 OK\r\n"
+               "Content-Type: application/json\r\n"
+               "Content-Length: 17\r\n"
+               "\r\n"
+               "{\"id_str\":\"4711\"}");
+
+  TEST_CHECK(twitter.post_status(message));
+  TEST_CHECK(twitter.get_response_code() == 200);
+  TEST_CHECK(strcmp(twitter.get_status_id(), "4711") == 0);
+  TEST_CHECK(request_len > 0
+             && memcmp(request, "POST /1/statuses/update.json ", 29) == 0);
+  check_writes("post_status", TWITTER_OUTPUT_BUFFER_LEN);
+
+  /* WeatherServer data post. */
+  memcpy(secret, "\x01\x02\x03\x04\x05\x06\x07\x08", sizeof(secret));
+  strcpy((char *) http_server, "weather.example.com");
+  proxy_port = 80;
+
+  set_response(json_reply);
+
+  TEST_CHECK(http_json_request(PSTR("POST"), PSTR("/data_api/add"), content,
+                               &code, reply, sizeof(reply), 0));
+  TEST_CHECK(code == 200);
+  TEST_CHECK(strcmp((char *) reply, "{\"s\":43,\"t\":1792238400}") == 0);
+  TEST_CHECK(request_len > strlen(content)
+             && memcmp(request, "POST /data_api/add ", 19) == 0
+             && memcmp(request + request_len - strlen(content), content,
+                       strlen(content)) == 0);
+  check_writes("http_json_request", 64);
+  check_authorization(content);
+  TEST_CHECK(strcmp(HMAC_SCHEME, "HMAC-SHA-1") == 0);
+
+  /* The parameter query.  The JSON reply goes only to the parser. */
+  TEST_CHECK(get_parameters_from_server());
+  TEST_CHECK(memcmp(request, "GET /data_api/params ", 21) == 0);
+  TEST_CHECK(msg_seqnum == 43);
+  TEST_CHECK(basetime + millis() / 1000 - 1792238400UL <= 1);
+  TEST_CHECK(json_buffer[0] == '\0');
+
+  set_response("HTTP/1.1 200 OK\r\n"
+               "\r\n"
+               " s:44,t:1792238500\r\n");
+  TEST_CHECK(get_parameters_from_server());
+  TEST_CHECK(msg_seqnum == 44);
+  TEST_CHECK(basetime + millis() / 1000 - 1792238500UL <= 1);
+
+  set_response("HTTP/1.1 500 Internal Server Error\r\n"
+               "\r\n"
+               "{\"s\":45,\"t\":1792238600}");
+  TEST_CHECK(!get_parameters_from_server());
+  TEST_CHECK(msg_seqnum == 44);
+
+  /* The loop queries the parameters once before posting the data. */
+  set_response(json_reply);
+  msg_seqnum = 0;
+  runlevel = RUNLEVEL_RUN;
+  loop();
+  TEST_CHECK(have_parameters);
+  TEST_CHECK(msg_seqnum == 44);
+  TEST_CHECK(memcmp(request, "POST /data_api/add ", 19) == 0);
+  TEST_CHECK(memmem(request, request_len, "\"sn\":43", 7) != 0);
+
+  loop();
+  TEST_CHECK(msg_seqnum == 45);
+  TEST_CHECK(memcmp(request, "POST /data_api/add ", 19) == 0);
+
+#ifdef CLIENT_BUFFER_UNBUFFERED
+  return test_exit("client_buffer (unbuffered)");
+#else /* not CLIENT_BUFFER_UNBUFFERED */
+  return test_exit("client_buffer");
+#endif /* not CLIENT_BUFFER_UNBUFFERED */
+}
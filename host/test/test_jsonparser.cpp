@@ -0,0 +1,356 @@
+/*
+ * test_jsonparser.cpp - JSONParser key paths, escapes and limits
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <JSONParser.h>
+
+#include "test.h"
+
+/* The reported values as `<path index>=<value>;' strings. */
+static char values[4096];
+
+static void
+record(void *context, uint8_t path, const char *value)
+{
+  size_t len = strlen(values);
+
+  snprintf(values + len, sizeof(values) - len, "%d=%s;", path, value);
+}
+
+/* Parse the document `doc' with the work buffer size `buffer_len' and
+   the key paths `paths'.  The function returns the result of the last
+   feed(). */
+static bool
+parse(const char *doc, size_t buffer_len, const prog_char *const *paths,
+      uint8_t num_paths, JSONParser **parser_return = 0)
+{
+  static char buffer[256];
+  static JSONParser *parser;
+  bool ok = true;
+
+  delete parser;
+  parser = new JSONParser(buffer, buffer_len);
+  parser->set_paths(paths, num_paths, record, 0);
+
+  values[0] = '\0';
+
+  for (; *doc; doc++)
+    ok = parser->feed(*doc);
+
+  if (parser_return)
+    *parser_return = parser;
+
+  return ok;
+}
+
+static const prog_char *const twitter_paths[] =
+  {
+    "id_str",
+    "errors[].code",
+    "user.screen_name",
+    "a\tb",
+  };
+
+#define NUM_TWITTER_PATHS \
+  (sizeof(twitter_paths) / sizeof(twitter_paths[0]))
+
+static void
+test_paths(void)
+{
+  JSONParser *parser;
+
+  TEST_CHECK(parse("{\"id\":123,\"id_str\":\"123\","
+                   "\"user\":{\"id_str\":\"9\",\"screen_name\":\"mtr\"},"
+                   "\"entities\":[{\"id_str\":\"8\"}]}",
+                   64, twitter_paths, NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(parser->is_done());
+  TEST_CHECK(strcmp(values, "0=123;2=mtr;") == 0);
+
+  /* Every element of an array, numbers as they are. */
+  TEST_CHECK(parse(" {\"errors\" : [ {\"code\": 187 , \"message\":\"dup\"},"
+                   "{\"message\":\"x\",\"code\":-1.5e+3}]}\r\n",
+                   64, twitter_paths, NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(parser->is_done());
+  TEST_CHECK(strcmp(values, "1=187;1=-1.5e+3;") == 0);
+
+  /* Literals, empty containers, and a value at the top level. */
+  TEST_CHECK(parse("{\"id_str\":true,\"e\":{},\"f\":[],\"id_str\":null}",
+                   64, twitter_paths, NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(parser->is_done());
+  TEST_CHECK(strcmp(values, "0=true;0=null;") == 0);
+
+  TEST_CHECK(parse("\"id_str\"", 64, twitter_paths, NUM_TWITTER_PATHS,
+                   &parser));
+  TEST_CHECK(parser->is_done());
+  TEST_CHECK(values[0] == '\0');
+
+  /* The parser can be reused after reset(). */
+  parser->reset();
+  TEST_CHECK(!parser->is_done() && !parser->is_error());
+}
+
+static void
+test_escapes(void)
+{
+  JSONParser *parser;
+
+  /* All the escapes of RFC 8259 in a value. */
+  TEST_CHECK(parse("{\"id_str\":\"q\\\"b\\\\s\\/b\\bf\\fn\\nr\\rt\\t\"}",
+                   64, twitter_paths, NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(strcmp(values, "0=q\"b\\s/b\bf\fn\nr\rt\t;") == 0);
+
+  /* \u escapes are UTF-8 encoded, upper and lower case digits.  The
+     halves of a surrogate pair are encoded separately. */
+  TEST_CHECK(parse("{\"id_str\":\"\\u0041\\u00e9\\u20AC\\ud83d\\ude00\"}",
+                   64, twitter_paths, NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(strcmp(values,
+                    "0=A\xc3\xa9\xe2\x82\xac"
+                    "\xed\xa0\xbd\xed\xb8\x80;") == 0);
+
+  /* Raw UTF-8 passes through. */
+  TEST_CHECK(parse("{\"id_str\":\"21.5\xc2\xb0" "C\"}",
+                   64, twitter_paths, NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(strcmp(values, "0=21.5\xc2\xb0" "C;") == 0);
+
+  /* Keys are unescaped before they are matched. */
+  TEST_CHECK(parse("{\"\\u0069d_str\":\"1\",\"a\\tb\":\"2\","
+                   "\"us\\u0065r\":{\"screen\\u005fname\":\"3\"}}",
+                   64, twitter_paths, NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(strcmp(values, "0=1;3=2;2=3;") == 0);
+
+  /* Invalid escapes and control characters. */
+  TEST_CHECK(!parse("{\"id_str\":\"\\x\"}", 64, twitter_paths,
+                    NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(parser->is_error());
+  TEST_CHECK(!parse("{\"id_str\":\"\\u12g4\"}", 64, twitter_paths,
+                    NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(!parse("{\"id_str\":\"a\nb\"}", 64, twitter_paths,
+                    NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(values[0] == '\0');
+}
+
+/* The key paths `v', `a.v', `a.a.v', ... of the values at
+   JSON_PARSER_STACK_SIZE + 1 levels. */
+static char depth_path_data[JSON_PARSER_STACK_SIZE + 1][64];
+static const prog_char *depth_paths[JSON_PARSER_STACK_SIZE + 1];
+
+/* A document of `levels' nested objects with the value `v' at each
+   level, e.g. {"a":{"a":{},"v":2},"v":1} for two levels. */
+static void
+nested_objects(char *doc, int levels)
+{
+  int i;
+
+  doc[0] = '\0';
+  for (i = 0; i < levels; i++)
+    strcat(doc, "{\"a\":");
+  strcat(doc, "{}");
+  for (i = levels; i > 0; i--)
+    sprintf(doc + strlen(doc), ",\"v\":%d}", i);
+}
+
+static void
+test_nesting(void)
+{
+  JSONParser *parser;
+  char doc[1024];
+  char expected[256];
+  int i;
+
+  for (i = 0; i <= JSON_PARSER_STACK_SIZE; i++)
+    {
+      depth_path_data[i][0] = '\0';
+      if (i > 0)
+        sprintf(depth_path_data[i], "%sa.", depth_path_data[i - 1]);
+      depth_paths[i] = depth_path_data[i];
+    }
+  for (i = 0; i <= JSON_PARSER_STACK_SIZE; i++)
+    strcat(depth_path_data[i], "v");
+
+  /* The values are reported down to JSON_PARSER_STACK_SIZE levels;
+     the ones below it are parsed but not reported. */
+  nested_objects(doc, JSON_PARSER_STACK_SIZE + 1);
+  TEST_CHECK(parse(doc, 128, depth_paths, JSON_PARSER_STACK_SIZE + 1,
+                   &parser));
+  TEST_CHECK(parser->is_done());
+
+  /* The innermost values end first. */
+  expected[0] = '\0';
+  for (i = JSON_PARSER_STACK_SIZE; i >= 1; i--)
+    sprintf(expected + strlen(expected), "%d=%d;", i - 1, i);
+  TEST_CHECK(strcmp(values, expected) == 0);
+
+  /* Arrays nest up to JSON_PARSER_MAX_DEPTH. */
+  memset(doc, '[', JSON_PARSER_MAX_DEPTH);
+  memset(doc + JSON_PARSER_MAX_DEPTH, ']', JSON_PARSER_MAX_DEPTH);
+  doc[2 * JSON_PARSER_MAX_DEPTH] = '\0';
+  TEST_CHECK(parse(doc, 128, depth_paths, 1, &parser));
+  TEST_CHECK(parser->is_done());
+
+  /* One level more is an error. */
+  memset(doc, '[', JSON_PARSER_MAX_DEPTH + 1);
+  memset(doc + JSON_PARSER_MAX_DEPTH + 1, ']', JSON_PARSER_MAX_DEPTH + 1);
+  doc[2 * JSON_PARSER_MAX_DEPTH + 2] = '\0';
+  TEST_CHECK(!parse(doc, 128, depth_paths, 1, &parser));
+  TEST_CHECK(parser->is_error());
+
+  /* A value after a deep untracked part is reported again. */
+  TEST_CHECK(parse("{\"x\":[[[[[[[[[[[[{\"v\":1}]]]]]]]]]]]],\"v\":2}",
+                   128, depth_paths, 1, &parser));
+  TEST_CHECK(parser->is_done());
+  TEST_CHECK(strcmp(values, "0=2;") == 0);
+
+  /* Mismatched and unbalanced containers. */
+  TEST_CHECK(!parse("{\"v\":[1}]", 128, depth_paths, 1, &parser));
+  TEST_CHECK(!parse("[1]]", 128, depth_paths, 1, &parser));
+  TEST_CHECK(!parse("{\"v\" 1}", 128, depth_paths, 1, &parser));
+  TEST_CHECK(!parse("{\"v\":1,}", 128, depth_paths, 1, &parser));
+  TEST_CHECK(!parse("{\"v\":1} x", 128, depth_paths, 1, &parser));
+  TEST_CHECK(!parse("{1:2}", 128, depth_paths, 1, &parser));
+}
+
+static void
+test_truncated(void)
+{
+  static const char doc[] =
+    "{\"id_str\":\"12\",\"errors\":[{\"code\":\"\\u0031\\n\"},"
+    "{\"code\":-7}],\"user\":{\"screen_name\":true}}";
+  static const char *const expected[] = {"0=12;", "1=1\n;", "1=-7;",
+                                         "2=true;"};
+  JSONParser *parser;
+  char prefix[sizeof(doc)];
+  char seen[64];
+  size_t len;
+  int i;
+
+  /* Every proper prefix is incomplete but valid, and reports exactly
+     the values completed in it. */
+  for (len = 0; len < sizeof(doc) - 1; len++)
+    {
+      memcpy(prefix, doc, len);
+      prefix[len] = '\0';
+
+      TEST_CHECK(parse(prefix, 64, twitter_paths, NUM_TWITTER_PATHS,
+                       &parser));
+      TEST_CHECK(!parser->is_done());
+      TEST_CHECK(!parser->is_error());
+
+      seen[0] = '\0';
+      for (i = 0; i < 4 && strlen(seen) < strlen(values); i++)
+        strcat(seen, expected[i]);
+      TEST_CHECK(strcmp(values, seen) == 0);
+    }
+
+  TEST_CHECK(parse(doc, 64, twitter_paths, NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(parser->is_done());
+  TEST_CHECK(strcmp(values, "0=12;1=1\n;1=-7;2=true;") == 0);
+
+  /* A number at the top level ends only with the byte after it. */
+  TEST_CHECK(parse("42", 64, twitter_paths, NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(!parser->is_done());
+  TEST_CHECK(parser->feed('\n'));
+  TEST_CHECK(parser->is_done());
+}
+
+static void
+test_overflow(void)
+{
+  JSONParser *parser;
+  char doc[256];
+  char expected[64];
+  size_t buffer_len = 16;
+  size_t max_len;
+
+  /* The buffer holds `id_str', its null character, the value and
+     its null character. */
+  max_len = buffer_len - strlen("id_str") - 2;
+
+  memset(expected, '7', max_len);
+  expected[max_len] = '\0';
+  sprintf(doc, "{\"id_str\":\"%s\"}", expected);
+  TEST_CHECK(parse(doc, buffer_len, twitter_paths, NUM_TWITTER_PATHS,
+                   &parser));
+  TEST_CHECK(strncmp(values, "0=", 2) == 0
+             && strncmp(values + 2, expected, max_len) == 0
+             && strcmp(values + 2 + max_len, ";") == 0);
+
+  /* One more byte does not fit and the value is dropped. */
+  sprintf(doc, "{\"id_str\":\"%s7\",\"id_str\":\"1\"}", expected);
+  TEST_CHECK(parse(doc, buffer_len, twitter_paths, NUM_TWITTER_PATHS,
+                   &parser));
+  TEST_CHECK(parser->is_done());
+  TEST_CHECK(strcmp(values, "0=1;") == 0);
+
+  /* Numbers too. */
+  sprintf(doc, "{\"id_str\":%s7,\"id_str\":2}", expected);
+  TEST_CHECK(parse(doc, buffer_len, twitter_paths, NUM_TWITTER_PATHS,
+                   &parser));
+  TEST_CHECK(strcmp(values, "0=2;") == 0);
+
+  /* A key that does not fit loses its subtree, but not the values
+     after it. */
+  TEST_CHECK(parse("{\"a_very_long_key_name\":{\"id_str\":\"1\","
+                   "\"b\":[{\"id_str\":\"2\"}]},\"id_str\":\"3\"}",
+                   buffer_len, twitter_paths, NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(parser->is_done());
+  TEST_CHECK(strcmp(values, "0=3;") == 0);
+
+  /* A key path that grows too long inside arrays. */
+  TEST_CHECK(parse("{\"errors\":[[[{\"code\":1}]]],\"errors\":"
+                   "[{\"code\":2}]}",
+                   buffer_len, twitter_paths, NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(parser->is_done());
+  TEST_CHECK(strcmp(values, "1=2;") == 0);
+
+  /* A tiny buffer reports nothing but still parses. */
+  TEST_CHECK(parse("{\"id_str\":\"1\"}", 4, twitter_paths,
+                   NUM_TWITTER_PATHS, &parser));
+  TEST_CHECK(parser->is_done());
+  TEST_CHECK(values[0] == '\0');
+
+  /* A document much larger than the buffer. */
+  TEST_CHECK(parse("{\"text\":\"", buffer_len, twitter_paths,
+                   NUM_TWITTER_PATHS, &parser));
+  for (max_len = 0; max_len < 100000; max_len++)
+    parser->feed("abc\\n"[max_len % 5]);
+  for (max_len = 0; max_len < sizeof("\",\"id_str\":\"5\"}") - 1; max_len++)
+    parser->feed("\",\"id_str\":\"5\"}"[max_len]);
+  TEST_CHECK(parser->is_done());
+  TEST_CHECK(strcmp(values, "0=5;") == 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  host_init();
+
+  test_paths();
+  test_escapes();
+  test_nesting();
+  test_truncated();
+  test_overflow();
+
+  return test_exit("jsonparser");
+}
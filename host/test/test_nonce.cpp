@@ -0,0 +1,235 @@
+/*
+ * test_nonce.cpp - Twitter OAuth nonces and the nonce boot counter
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The test signs a million posts of the same message in same-second
+   bursts over simulated restarts that start again from the same
+   unsynchronized clock.  The server rejects a request whose timestamp
+   and nonce it has seen before.  With the rest of the signed request
+   fixed, equal nonces give equal signatures, so the test checks that
+   no timestamp and signature pair repeats.
+
+   It then checks the EEPROM slots of the boot counter: each start
+   advances the counter into the next of the TWITTER_NONCE_SLOTS
+   slots, also when the counter wraps around. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <EEPROM.h>
+#include <Twitter.h>
+
+#include "test.h"
+
+#define RESTARTS	10
+#define SECONDS		100
+#define BURST		1000
+
+#define NUM_NONCES	(RESTARTS * SECONDS * BURST)
+
+/* The EEPROM address of the boot counter. */
+#define COUNTER_ADDR	64
+
+/* The first start time of the simulated restarts. */
+#define START_TIME	1318622958UL
+
+/* A signed request: the timestamp and the first bytes of the
+   signature. */
+struct Signed
+{
+  uint32_t timestamp;
+  uint8_t signature[12];
+};
+
+static Signed requests[NUM_NONCES];
+
+static char work_buffer[256];
+
+static Twitter *
+start(void)
+{
+  Twitter *twitter = new Twitter(work_buffer, sizeof(work_buffer));
+
+  twitter->set_twitter_endpoint(PSTR("api.twitter.com"),
+                                PSTR("/1/statuses/update.json"),
+                                IPAddress(127, 0, 0, 1), 80, false);
+  twitter->set_client_id(PSTR("3azqS8rD5Ku7MRHY74qFRg"),
+                         PSTR("S67Jon338GJ0sNxMyWVe5ccfrH1z3HtjrVGj3xiXApQ"));
+  twitter->set_account_id(PSTR("123456789-AbCdEfGhIjKlMnOpQrStUvWxYz"),
+                          PSTR("AbCdEfGhIjKlMnOpQrStUvWxYz0123456789AbCdEf"));
+  twitter->set_nonce_counter(COUNTER_ADDR);
+
+  return twitter;
+}
+
+static int
+compare_signed(const void *a, const void *b)
+{
+  return memcmp(a, b, sizeof(Signed));
+}
+
+static void
+test_unique(void)
+{
+  Twitter *twitter;
+  Signed *req = requests;
+  unsigned long i, repeats = 0;
+  int restart, second, n;
+
+  for (restart = 0; restart < RESTARTS; restart++)
+    {
+      twitter = start();
+
+      for (second = 0; second < SECONDS; second++)
+        for (n = 0; n < BURST; n++, req++)
+          {
+            req->timestamp = START_TIME + second;
+            memcpy(req->signature,
+                   twitter->sign_status(req->timestamp, "Same message"),
+                   sizeof(req->signature));
+          }
+
+      delete twitter;
+    }
+
+  qsort(requests, NUM_NONCES, sizeof(Signed), compare_signed);
+
+  for (i = 1; i < NUM_NONCES; i++)
+    if (compare_signed(&requests[i - 1], &requests[i]) == 0)
+      repeats++;
+
+  printf("%d nonces in %d restarts: %lu repeats\n",
+         NUM_NONCES, RESTARTS, repeats);
+
+  TEST_CHECK(repeats == 0);
+}
+
+static uint32_t
+read_slot(int slot)
+{
+  int address = COUNTER_ADDR + slot * 4;
+
+  return (uint32_t) EEPROM.read(address)
+    | (uint32_t) EEPROM.read(address + 1) << 8
+    | (uint32_t) EEPROM.read(address + 2) << 16
+    | (uint32_t) EEPROM.read(address + 3) << 24;
+}
+
+static void
+write_slot(int slot, uint32_t value)
+{
+  int address = COUNTER_ADDR + slot * 4;
+  int i;
+
+  for (i = 0; i < 4; i++, value >>= 8)
+    EEPROM.write(address + i, value & 0xff);
+}
+
+/* Start `count' times from the slot contents `slots' and check that
+   each start writes `next' and its successors into the slots
+   following `slot', one slot per start. */
+static void
+check_starts(const uint32_t *slots, int slot, uint32_t next, int count)
+{
+  uint32_t expected[TWITTER_NONCE_SLOTS];
+  int i, j;
+
+  for (i = 0; i < TWITTER_NONCE_SLOTS; i++)
+    {
+      write_slot(i, slots[i]);
+      expected[i] = slots[i];
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      delete start();
+
+      slot = (slot + 1) % TWITTER_NONCE_SLOTS;
+      expected[slot] = next;
+
+      /* 0xffffffff is the erased value and is skipped. */
+      if (++next == 0xffffffff)
+        next = 0;
+
+      for (j = 0; j < TWITTER_NONCE_SLOTS; j++)
+        TEST_CHECK(read_slot(j) == expected[j]);
+    }
+}
+
+static void
+test_counter(void)
+{
+  static const uint32_t erased[TWITTER_NONCE_SLOTS] = {
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+  };
+  static const uint32_t partial[TWITTER_NONCE_SLOTS] = {
+    0, 1, 2, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+  };
+  static const uint32_t middle[TWITTER_NONCE_SLOTS] = {
+    1000, 1001, 1002, 1003, 1004, 997, 998, 999,
+  };
+  static const uint32_t wrapping[TWITTER_NONCE_SLOTS] = {
+    0xfffffffb, 0xfffffffc, 0xfffffffd, 0xfffffffe,
+    0xfffffff7, 0xfffffff8, 0xfffffff9, 0xfffffffa,
+  };
+  static const uint32_t wrapped[TWITTER_NONCE_SLOTS] = {
+    0xfffffffa, 0xfffffffb, 0xfffffffc, 0xfffffffd,
+    0xfffffffe, 0, 1, 0xfffffff9,
+  };
+
+  /* The first start writes 0 into the first slot. */
+  check_starts(erased, TWITTER_NONCE_SLOTS - 1, 0, 3 * TWITTER_NONCE_SLOTS);
+  check_starts(partial, 2, 3, 2 * TWITTER_NONCE_SLOTS);
+  check_starts(middle, 4, 1005, 2 * TWITTER_NONCE_SLOTS);
+
+  /* Past the wraparound and around the slots a few times. */
+  check_starts(wrapping, 3, 0, 3 * TWITTER_NONCE_SLOTS);
+  check_starts(wrapped, 6, 2, 3 * TWITTER_NONCE_SLOTS);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[] = "/tmp/test_nonce_XXXXXX";
+  int fd;
+
+  host_init();
+
+  /* A fresh EEPROM image that reads as erased. */
+  fd = mkstemp(path);
+  if (fd >= 0)
+    {
+      close(fd);
+      unlink(path);
+    }
+  setenv("HOST_EEPROM", path, 1);
+
+  test_unique();
+  test_counter();
+
+  unlink(path);
+
+  return test_exit("nonce");
+}
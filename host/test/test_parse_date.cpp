@@ -0,0 +1,264 @@
+/*
+ * test_parse_date.cpp - HTTP Date header parsing
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The test formats every day from 1970 to 9999 in the three Date
+   formats with a varying time of day and compares Twitter::parse_date()
+   with the C library timegm().  The unsigned long of the AVR is 32
+   bits, so the result must fit in 32 bits and the times after
+   2106-02-07 06:28:15 must be rejected.  It then checks that malformed
+   dates, every prefix of a valid date, and dates with a digit replaced
+   are rejected. */
+
+#include <stdio.h>
+#include <string.h>
+
+/* Twitter.h brings in the time_t of the Time library that time.h
+   expects with -D__time_t_defined. */
+#include <Twitter.h>
+#include <time.h>
+
+#include "test.h"
+
+static const char *const day_names[] = {
+  "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday",
+  "Saturday",
+};
+
+static const char *const month_names[] = {
+  "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+/* The number of mismatches reported in detail. */
+#define MAX_REPORTS 10
+
+static unsigned long reports;
+
+/* Check that parse_date() of `date' is `expected', or 0 if `expected'
+   does not fit in 32 bits. */
+static void
+check_date(const char *date, unsigned long long expected)
+{
+  unsigned long value = Twitter::parse_date(date);
+
+  if (expected > 0xffffffffULL)
+    expected = 0;
+
+  if (TEST_CHECK(value == (uint32_t) value && (uint32_t) value == expected)
+      || ++reports > MAX_REPORTS)
+    return;
+
+  printf("  \"%s\": %lu, expected %llu\n", date, value, expected);
+}
+
+static void
+test_range(void)
+{
+  struct tm day, tm;
+  unsigned long long expected;
+  unsigned long days;
+  char date[64];
+  int year, hour, minute, second;
+
+  /* `day' is the midnight of the day and is normalized by
+     timegm(). */
+  memset(&day, 0, sizeof(day));
+  day.tm_year = 70;
+  day.tm_mday = 1;
+  timegm(&day);
+
+  for (days = 0; day.tm_year + 1900 <= 9999; days++)
+    {
+      /* Walk through the seconds of the day, leap seconds included, as
+         the days go by. */
+      hour = days % 24;
+      minute = days * 7 % 60;
+      second = days * 13 % 61;
+
+      tm = day;
+      tm.tm_hour = hour;
+      tm.tm_min = minute;
+      tm.tm_sec = second;
+      expected = timegm(&tm);
+
+      year = day.tm_year + 1900;
+
+      snprintf(date, sizeof(date), "%.3s, %02d %s %04d %02d:%02d:%02d GMT",
+               day_names[day.tm_wday], day.tm_mday, month_names[day.tm_mon],
+               year, hour, minute, second);
+      check_date(date, expected);
+
+      snprintf(date, sizeof(date), "%.3s %s %2d %02d:%02d:%02d %04d",
+               day_names[day.tm_wday], month_names[day.tm_mon], day.tm_mday,
+               hour, minute, second, year);
+      check_date(date, expected);
+
+      if (year < 2070)
+        {
+          snprintf(date, sizeof(date), "%s, %02d-%s-%02d %02d:%02d:%02d GMT",
+                   day_names[day.tm_wday], day.tm_mday,
+                   month_names[day.tm_mon], year % 100,
+                   hour, minute, second);
+          check_date(date, expected);
+        }
+
+      day.tm_mday++;
+      timegm(&day);
+    }
+
+  /* 1970-01-01 to 9999-12-31. */
+  TEST_CHECK(days == 2932897);
+}
+
+static void
+test_known(void)
+{
+  /* The examples of RFC 7231. */
+  check_date("Sun, 06 Nov 1994 08:49:37 GMT", 784111777);
+  check_date("Sunday, 06-Nov-94 08:49:37 GMT", 784111777);
+  check_date("Sun Nov  6 08:49:37 1994", 784111777);
+
+  check_date("Thu, 01 Jan 1970 00:00:01 GMT", 1);
+  check_date("Tue, 19 Jan 2038 03:14:07 GMT", 2147483647UL);
+  check_date("Tue, 19 Jan 2038 03:14:08 GMT", 2147483648UL);
+  check_date("Sun, 07 Feb 2106 06:28:15 GMT", 4294967295UL);
+  check_date("Sun, 07 Feb 2106 06:28:16 GMT", 0);
+  check_date("Mon, 08 Feb 2106 00:00:00 GMT", 0);
+  check_date("Wed, 01 Jan 2107 00:00:00 GMT", 0);
+  check_date("Tue, 29 Feb 2000 12:00:00 GMT", 951825600);
+  check_date("Thu, 29 Feb 2400 00:00:00 GMT", 0);
+
+  /* Leading spaces, any case of the month, and a leap second. */
+  check_date("  Sun, 06 Nov 1994 08:49:37 GMT", 784111777);
+  check_date("Sun, 06 NOV 1994 08:49:37 GMT", 784111777);
+  check_date("Sun, 06 nov 1994 08:49:37 GMT", 784111777);
+  check_date("Sat, 31 Dec 2016 23:59:60 GMT", 1483228800);
+}
+
+static const char *const malformed[] = {
+  "",
+  " ",
+  "GMT",
+  "Sun",
+  "Sun,",
+  "Sun, ",
+  "Sun 06 Nov 1994 08:49:37 GMT",
+  "Sun,06 Nov 1994 08:49:37 GMT",
+  "Sun, 6 Nov 1994 08:49:37 GMT",
+  "Sun, 06 Nov 94 08:49:37 GMT",
+  "Sun, 06-Nov 1994 08:49:37 GMT",
+  "Sun, 06 Nov-1994 08:49:37 GMT",
+  "Sun, 06/Nov/1994 08:49:37 GMT",
+  "Sun, 06 Now 1994 08:49:37 GMT",
+  "Sun, 06 N0v 1994 08:49:37 GMT",
+  "Sun, 06 Nov 1994 08:49:37",
+  "Sun, 06 Nov 1994 08:49:37 UTC",
+  "Sun, 06 Nov 1994 08:49:37 gmt",
+  "Sun, 06 Nov 1994 8:49:37 GMT",
+  "Sun, 06 Nov 1994 08:49 GMT",
+  "Sun, 06 Nov 1994 08.49.37 GMT",
+  "Sun, 06 Nov 1994 08:49:37GMT",
+  "Sun, 00 Nov 1994 08:49:37 GMT",
+  "Sun, 31 Nov 1994 08:49:37 GMT",
+  "Sun, 32 Jan 1994 08:49:37 GMT",
+  "Sun, 30 Feb 2000 08:49:37 GMT",
+  "Sun, 29 Feb 1999 08:49:37 GMT",
+  "Sun, 29 Feb 2100 08:49:37 GMT",
+  "Sun, 06 Nov 1994 24:00:00 GMT",
+  "Sun, 06 Nov 1994 08:60:37 GMT",
+  "Sun, 06 Nov 1994 08:49:61 GMT",
+  "Wed, 31 Dec 1969 23:59:59 GMT",
+  "Sunday, 06-Nov-1994 08:49:37 GMT",
+  "Sunday, 06-Nov-9 08:49:37 GMT",
+  "Sunday, 06 Nov-94 08:49:37 GMT",
+  "Sun Nov 6 08:49:37 1994",
+  "Sun Nov  6 08:49:37 94",
+  "Sun Nov 06 08:49:37",
+  "Sun Nov  6 08:49:37 1969",
+  "Sun  Nov  6 08:49:37 1994",
+  "Sun Nov  6 08:49:37  1994",
+  "Sun Nov  0 08:49:37 1994",
+  "Sun Nov 31 08:49:37 1994",
+  "Sun Xyz  6 08:49:37 1994",
+  "1994-11-06T08:49:37Z",
+  "784111777",
+};
+
+#define NUM_MALFORMED (sizeof(malformed) / sizeof(malformed[0]))
+
+static const char *const valid[] = {
+  "Sun, 06 Nov 1994 08:49:37 GMT",
+  "Sunday, 06-Nov-94 08:49:37 GMT",
+  "Sun Nov  6 08:49:37 1994",
+};
+
+#define NUM_VALID (sizeof(valid) / sizeof(valid[0]))
+
+static void
+test_malformed(void)
+{
+  char date[64];
+  size_t i, len, pos;
+
+  for (i = 0; i < NUM_MALFORMED; i++)
+    check_date(malformed[i], 0);
+
+  for (i = 0; i < NUM_VALID; i++)
+    {
+      len = strlen(valid[i]);
+
+      /* Every prefix, for a header cut short. */
+      for (pos = 0; pos < len; pos++)
+        {
+          memcpy(date, valid[i], pos);
+          date[pos] = '\0';
+          check_date(date, 0);
+        }
+
+      /* Every digit replaced with a non-digit. */
+      for (pos = 0; pos < len; pos++)
+        {
+          if (valid[i][pos] < '0' || valid[i][pos] > '9')
+            continue;
+
+          strcpy(date, valid[i]);
+          date[pos] = 'x';
+          check_date(date, 0);
+
+          date[pos] = ' ';
+          check_date(date, 0);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+  host_init();
+
+  test_known();
+  test_range();
+  test_malformed();
+
+  return test_exit("parse_date");
+}
@@ -0,0 +1,199 @@
+/*
+ * test_serialpacket.cpp - SerialPacket wire format and round trip
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SoftwareSerial.h>
+#include <SerialPacket.h>
+
+#include "test.h"
+
+/* A software serial port that loops the written data back to its
+   input.  SerialPacket::receive() blocks until it has a valid packet,
+   so reading past the written data fails the test instead of
+   hanging. */
+class LoopbackSerial : public SoftwareSerial
+{
+public:
+
+  LoopbackSerial()
+    : SoftwareSerial(2, 3),
+      head(0),
+      tail(0)
+  {
+  }
+
+  virtual int available(void)
+  {
+    return head - tail;
+  }
+
+  virtual int read(void)
+  {
+    if (head == tail)
+      {
+        TEST_CHECK(!"receive() read past the sent data");
+        exit(test_exit("serialpacket"));
+      }
+
+    return data[tail++];
+  }
+
+  virtual int peek(void)
+  {
+    return head == tail ? -1 : data[tail];
+  }
+
+  virtual size_t write(uint8_t byte)
+  {
+    if (head < sizeof(data))
+      data[head++] = byte;
+    return 1;
+  }
+
+  using Print::write;
+
+  uint8_t data[1024];
+  size_t head;
+  size_t tail;
+};
+
+static uint32_t
+packet_crc(const uint8_t *data, size_t len)
+{
+  uint32_t crc = 0;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    crc = (crc << 8) + data[i] + (crc >> 11);
+
+  return crc;
+}
+
+/* The frame is 0x80 0x80 0x80 0x81, the length, the data with 0x80
+   escaped as 0xfe 0x01 and 0xfe as 0xfe 0x02, the trailer 0x80 0x82
+   and the big-endian CRC. */
+static void
+test_wire_format(void)
+{
+  static const uint8_t payload[] = {0x01, 0x80, 0xfe, 0x42};
+  uint8_t expected[64];
+  size_t len = 0;
+  uint32_t crc = packet_crc(payload, sizeof(payload));
+  LoopbackSerial serial;
+  SerialPacket packet(&serial);
+
+  expected[len++] = 0x80;
+  expected[len++] = 0x80;
+  expected[len++] = 0x80;
+  expected[len++] = 0x81;
+  expected[len++] = sizeof(payload);
+  expected[len++] = 0x01;
+  expected[len++] = 0xfe;
+  expected[len++] = 0x01;
+  expected[len++] = 0xfe;
+  expected[len++] = 0x02;
+  expected[len++] = 0x42;
+  expected[len++] = 0x80;
+  expected[len++] = 0x82;
+  expected[len++] = crc >> 24;
+  expected[len++] = crc >> 16;
+  expected[len++] = crc >> 8;
+  expected[len++] = crc;
+
+  TEST_CHECK(packet.send((uint8_t *) payload, sizeof(payload)));
+  TEST_CHECK(serial.head == len);
+  TEST_CHECK_BYTES(serial.data, expected, len);
+}
+
+/* Packets of every length and byte value survive send() and
+   receive(), also after line noise. */
+static void
+test_roundtrip(void)
+{
+  LoopbackSerial serial;
+  SerialPacket packet(&serial);
+  uint8_t payload[255];
+  uint8_t *data;
+  size_t i, len, data_len;
+  uint32_t errors = packet.num_errors;
+
+  for (len = 0; len <= sizeof(payload); len += 17)
+    {
+      serial.head = serial.tail = 0;
+
+      /* Noise before the header. */
+      serial.write(0x33);
+      serial.write(0x80);
+
+      for (i = 0; i < len; i++)
+        payload[i] = (i * 0x45 + len) & 0xff;
+      if (len)
+        payload[len / 2] = 0x80;
+
+      TEST_CHECK(packet.send(payload, len));
+
+      data = packet.receive(&data_len);
+      TEST_CHECK(data_len == len);
+      TEST_CHECK_BYTES(data, payload, len);
+      TEST_CHECK(serial.tail == serial.head);
+    }
+
+  TEST_CHECK(packet.num_errors == errors);
+}
+
+/* A corrupted packet is counted as an error and the next one is
+   received. */
+static void
+test_corrupted(void)
+{
+  static const uint8_t payload[] = "temperature";
+  LoopbackSerial serial;
+  SerialPacket packet(&serial);
+  uint8_t *data;
+  size_t data_len;
+  uint32_t errors = packet.num_errors;
+
+  packet.send((uint8_t *) payload, sizeof(payload));
+  serial.data[7] ^= 0x01;
+  packet.send((uint8_t *) payload, sizeof(payload));
+
+  data = packet.receive(&data_len);
+  TEST_CHECK(packet.num_errors == errors + 1);
+  TEST_CHECK(data_len == sizeof(payload));
+  TEST_CHECK_BYTES(data, payload, sizeof(payload));
+}
+
+int
+main(int argc, char *argv[])
+{
+  host_init();
+
+  test_wire_format();
+  test_roundtrip();
+  test_corrupted();
+
+  return test_exit("serialpacket");
+}
@@ -0,0 +1,601 @@
+/*
+ * test_sha.cpp - SHA-1, SHA-256 and HMAC test vectors
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The test checks the hashes of the FIPS 180-4 examples and the HMACs
+   of the RFC 2202 and RFC 4231 test cases.  It then checks that the
+   block update API gives the same hash however the data is split into
+   update() and write() calls and however it is aligned in memory.
+
+   On x86 the SHA-1 code picks the SHA-NI kernel at run time when the
+   CPU has it.  The test compares the SHA-1 of random messages with a
+   plain implementation of FIPS 180-4 and reports the kernel that it
+   tested.
+
+   The multi-buffer SHA-256 methods are compared with hashing each
+   context on its own, for message counts that use the scalar code for
+   a single message, the 4-lane SSE4.1 kernel for 2-4 messages and the
+   8-lane AVX2 kernel for more, with unequal message lengths and with
+   contexts that already hold part of a block.
+
+   `make test' runs the test again from a build with SHA1_NO_SHA_NI and
+   SHA256_NO_SIMD so that the portable code is tested as well. */
+
+#include <stdio.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(SHA1_NO_SHA_NI)
+#include <cpuid.h>
+#endif
+
+#include <sha1.h>
+#include <sha256.h>
+
+#include "test.h"
+
+/* A FIPS 180-4 example: `repeat' copies of `data' and its hashes. */
+struct HashVector
+{
+  const char *data;
+  unsigned long repeat;
+  const char *sha1;
+  const char *sha256;
+};
+
+static const HashVector hash_vectors[] = {
+  {"", 1,
+   "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+   "e3b0c44298fc1c149afbf4c8996fb924"
+   "27ae41e4649b934ca495991b7852b855"},
+  {"abc", 1,
+   "a9993e364706816aba3e25717850c26c9cd0d89d",
+   "ba7816bf8f01cfea414140de5dae2223"
+   "b00361a396177a9cb410ff61f20015ad"},
+  {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+   "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+   "248d6a61d20638b8e5c026930c3e6039"
+   "a33ce45964ff2167f6ecedd419db06c1"},
+  {"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+   "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+   "a49b2446a02c645bf419f995b67091253a04a259",
+   "cf5b16a778af8380036ce59e7b049237"
+   "0b249b11e8f07a51afac45037afee9d1"},
+  {"a", 1000000,
+   "34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+   "cdc76e5c9914fb9281a1c7e284d73e67"
+   "f1809a48a497200e046d39ccc7112cd0"},
+};
+
+#define NUM_HASH_VECTORS (sizeof(hash_vectors) / sizeof(hash_vectors[0]))
+
+/* An HMAC test case: the key of `key_len' bytes `key_byte' or, if
+   `key' is not 0, the string `key', and the message of `data_len'
+   bytes `data_byte' or the string `data'. */
+struct HmacVector
+{
+  const char *key;
+  uint8_t key_byte;
+  uint8_t key_len;
+  const char *data;
+  uint8_t data_byte;
+  uint8_t data_len;
+  const char *hmac;
+};
+
+/* RFC 2202 test cases 1-4, 6 and 7. */
+static const HmacVector hmac_sha1_vectors[] = {
+  {0, 0x0b, 20, "Hi There", 0, 0,
+   "b617318655057264e28bc0b6fb378c8ef146be00"},
+  {"Jefe", 0, 0, "what do ya want for nothing?", 0, 0,
+   "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79"},
+  {0, 0xaa, 20, 0, 0xdd, 50,
+   "125d7342b9ac11cd91a39af48aa17b4f63f175d3"},
+  {"\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10"
+   "\x11\x12\x13\x14\x15\x16\x17\x18\x19", 0, 0, 0, 0xcd, 50,
+   "4c9007f4026250c6bc8414f9bf50c86c2d7235da"},
+  {0, 0xaa, 80, "Test Using Larger Than Block-Size Key - Hash Key First",
+   0, 0,
+   "aa4ae5e15272d00e95705637ce8a3b55ed402112"},
+  {0, 0xaa, 80, "Test Using Larger Than Block-Size Key and Larger "
+   "Than One Block-Size Data", 0, 0,
+   "e8e99d0f45237d786d6bbaa7965c7808bbff1a91"},
+};
+
+/* RFC 4231 test cases 1-4, 6 and 7. */
+static const HmacVector hmac_sha256_vectors[] = {
+  {0, 0x0b, 20, "Hi There", 0, 0,
+   "b0344c61d8db38535ca8afceaf0bf12b"
+   "881dc200c9833da726e9376c2e32cff7"},
+  {"Jefe", 0, 0, "what do ya want for nothing?", 0, 0,
+   "5bdcc146bf60754e6a042426089575c7"
+   "5a003f089d2739839dec58b964ec3843"},
+  {0, 0xaa, 20, 0, 0xdd, 50,
+   "773ea91e36800e46854db8ebd09181a7"
+   "2959098b3ef8c122d9635514ced565fe"},
+  {"\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10"
+   "\x11\x12\x13\x14\x15\x16\x17\x18\x19", 0, 0, 0, 0xcd, 50,
+   "82558a389a443c0ea4cc819899f2083a"
+   "85f0faa3e578f8077a2e3ff46729665b"},
+  {0, 0xaa, 131, "Test Using Larger Than Block-Size Key - Hash Key First",
+   0, 0,
+   "60e431591ee0b67f0d8a26aacbf5b77f"
+   "8e0bc6213728c5140546040f0ee37f54"},
+  {0, 0xaa, 131, "This is a test using a larger than block-size key "
+   "and a larger than block-size data. The key needs to be hashed "
+   "before being used by the HMAC algorithm.", 0, 0,
+   "9b09ffa71b942fcb27635fbcd5b0e944"
+   "bfdc63644f0713938a7f51535c3a35e2"},
+};
+
+#define NUM_HMAC_VECTORS \
+  (sizeof(hmac_sha1_vectors) / sizeof(hmac_sha1_vectors[0]))
+
+/* The length of the random message of the split and alignment
+   checks. */
+#define MESSAGE_LEN 300
+
+static uint8_t message[MESSAGE_LEN];
+
+/* Decode the hex string `hex' into `out' and return its length. */
+static size_t
+hex_decode(const char *hex, uint8_t *out)
+{
+  size_t len;
+  unsigned int byte;
+
+  for (len = 0; hex[2 * len]; len++)
+    {
+      sscanf(hex + 2 * len, "%2x", &byte);
+      out[len] = byte;
+    }
+
+  return len;
+}
+
+/* Check that `hash' is the hex string `hex'. */
+static bool
+check_hash(const uint8_t *hash, const char *hex)
+{
+  uint8_t expected[SHA_MAX_HASH_LENGTH];
+  size_t len = hex_decode(hex, expected);
+
+  return TEST_CHECK_BYTES(hash, expected, len);
+}
+
+static void
+test_hash(ShaBase &sha, bool sha256)
+{
+  const HashVector *v;
+  unsigned long i;
+  size_t i_vector;
+
+  for (i_vector = 0; i_vector < NUM_HASH_VECTORS; i_vector++)
+    {
+      v = &hash_vectors[i_vector];
+
+      sha.init();
+      for (i = 0; i < v->repeat; i++)
+        sha.update((const uint8_t *) v->data, strlen(v->data));
+
+      if (!check_hash(sha.result(), sha256 ? v->sha256 : v->sha1))
+        printf("  vector %lu\n", (unsigned long) i_vector);
+    }
+}
+
+/* Put the message of the HMAC vector `v' into `buffer' and return its
+   length.  The key is returned the same way in `key' and
+   `key_len_return'. */
+static size_t
+hmac_vector(const HmacVector *v, uint8_t *key, size_t *key_len_return,
+            uint8_t *buffer)
+{
+  size_t len;
+
+  if (v->key)
+    {
+      *key_len_return = strlen(v->key);
+      memcpy(key, v->key, *key_len_return);
+    }
+  else
+    {
+      *key_len_return = v->key_len;
+      memset(key, v->key_byte, v->key_len);
+    }
+
+  if (v->data)
+    {
+      len = strlen(v->data);
+      memcpy(buffer, v->data, len);
+    }
+  else
+    {
+      len = v->data_len;
+      memset(buffer, v->data_byte, len);
+    }
+
+  return len;
+}
+
+static void
+test_hmac(ShaBase &sha, const HmacVector *vectors)
+{
+  uint8_t key[256], data[256], key_state[2 * SHA_MAX_HASH_LENGTH];
+  size_t i, j, key_len, len;
+
+  for (i = 0; i < NUM_HMAC_VECTORS; i++)
+    {
+      len = hmac_vector(&vectors[i], key, &key_len, data);
+
+      sha.initHmac(key, key_len);
+      sha.getHmacKeyState(key_state);
+      sha.update(data, len);
+      if (!check_hash(sha.resultHmac(), vectors[i].hmac))
+        printf("  HMAC vector %lu\n", (unsigned long) i);
+
+      /* The same from the saved key state, written a byte at a
+         time. */
+      sha.init();
+      sha.initHmacKeyState(key_state);
+      for (j = 0; j < len; j++)
+        sha.write(data[j]);
+      if (!check_hash(sha.resultHmac(), vectors[i].hmac))
+        printf("  HMAC vector %lu from key state\n", (unsigned long) i);
+    }
+}
+
+/* Check that the hash of the first `len' bytes of `message' is the
+   same for all ways to feed them to `sha'. */
+static void
+test_split(ShaBase &sha, size_t len, size_t hash_len)
+{
+  uint8_t expected[SHA_MAX_HASH_LENGTH];
+  uint8_t unaligned[MESSAGE_LEN + 8];
+  size_t split, offset, i;
+
+  sha.init();
+  sha.update(message, len);
+  memcpy(expected, sha.result(), hash_len);
+
+  /* Two update() calls split at every position, also starting from a
+     partially filled block. */
+  for (split = 0; split <= len; split++)
+    {
+      sha.init();
+      sha.update(message, split);
+      sha.update(message + split, len - split);
+      TEST_CHECK_BYTES(sha.result(), expected, hash_len);
+    }
+
+  /* A byte at a time through Print::write(). */
+  sha.init();
+  for (i = 0; i < len; i++)
+    sha.write(message[i]);
+  TEST_CHECK_BYTES(sha.result(), expected, hash_len);
+
+  /* Through Print::write() from every alignment. */
+  for (offset = 0; offset < 8; offset++)
+    {
+      memcpy(unaligned + offset, message, len);
+
+      sha.init();
+      sha.write(unaligned + offset, len);
+      TEST_CHECK_BYTES(sha.result(), expected, hash_len);
+
+      sha.init();
+      sha.write(unaligned + offset, 1);
+      sha.update(unaligned + offset + 1, len - 1);
+      TEST_CHECK_BYTES(sha.result(), expected, hash_len);
+    }
+}
+
+#define ROL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+/* The number and the maximum length of the random messages that are
+   compared with the reference SHA-1. */
+#define NUM_RANDOM	2000
+#define RANDOM_LEN	1000
+
+/* The SHA-1 of FIPS 180-4 section 6.1 as written, with no unrolling
+   and no kernels, of up to RANDOM_LEN bytes. */
+static void
+reference_sha1(const uint8_t *data, size_t len, uint8_t *hash)
+{
+  static uint8_t padded[RANDOM_LEN + 2 * 64];
+  uint32_t h[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0,
+  };
+  uint32_t w[80], a, b, c, d, e, f, k, t;
+  uint64_t bits = (uint64_t) len * 8;
+  size_t padded_len, pos, i;
+
+  /* The message, 0x80, zeros and the length in bits in the last 8
+     bytes of the last block. */
+  padded_len = (len + 8) / 64 * 64 + 64;
+  memcpy(padded, data, len);
+  memset(padded + len, 0, padded_len - len);
+  padded[len] = 0x80;
+  for (i = 0; i < 8; i++)
+    padded[padded_len - 1 - i] = bits >> (8 * i);
+
+  for (pos = 0; pos < padded_len; pos += 64)
+    {
+      for (i = 0; i < 16; i++)
+        w[i] = (uint32_t) padded[pos + 4 * i] << 24
+          | (uint32_t) padded[pos + 4 * i + 1] << 16
+          | (uint32_t) padded[pos + 4 * i + 2] << 8
+          | padded[pos + 4 * i + 3];
+      for (i = 16; i < 80; i++)
+        w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+      a = h[0];
+      b = h[1];
+      c = h[2];
+      d = h[3];
+      e = h[4];
+
+      for (i = 0; i < 80; i++)
+        {
+          if (i < 20)
+            {
+              f = (b & c) | (~b & d);
+              k = 0x5a827999;
+            }
+          else if (i < 40)
+            {
+              f = b ^ c ^ d;
+              k = 0x6ed9eba1;
+            }
+          else if (i < 60)
+            {
+              f = (b & c) | (b & d) | (c & d);
+              k = 0x8f1bbcdc;
+            }
+          else
+            {
+              f = b ^ c ^ d;
+              k = 0xca62c1d6;
+            }
+
+          t = ROL32(a, 5) + f + e + k + w[i];
+          e = d;
+          d = c;
+          c = ROL32(b, 30);
+          b = a;
+          a = t;
+        }
+
+      h[0] += a;
+      h[1] += b;
+      h[2] += c;
+      h[3] += d;
+      h[4] += e;
+    }
+
+  for (i = 0; i < 20; i++)
+    hash[i] = h[i / 4] >> (24 - 8 * (i % 4));
+}
+
+static void
+test_sha1_kernel(void)
+{
+  static uint8_t data[RANDOM_LEN];
+  uint8_t expected[SHA1_HASH_LENGTH];
+  Sha1Class sha1;
+  const char *kernel = "portable";
+  size_t i, j, len;
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(SHA1_NO_SHA_NI)
+  unsigned int eax, ebx, ecx, edx;
+
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA))
+    kernel = "SHA-NI";
+#endif
+
+  for (i = 0; i < NUM_RANDOM; i++)
+    {
+      /* All lengths up to a few blocks, then random ones. */
+      len = i < 200 ? i : random(RANDOM_LEN + 1);
+      for (j = 0; j < len; j++)
+        data[j] = random(256);
+
+      reference_sha1(data, len, expected);
+
+      sha1.init();
+      sha1.update(data, len);
+      if (!TEST_CHECK_BYTES(sha1.result(), expected, SHA1_HASH_LENGTH))
+        printf("  %lu bytes\n", (unsigned long) len);
+    }
+
+  printf("sha1: %d random messages with the %s kernel\n", NUM_RANDOM, kernel);
+}
+
+/* The maximum number of messages of the multi-buffer checks and the
+   maximum length of their prefixes and messages. */
+#define MAX_MULTI	(2 * SHA256_MULTI_LANES + 3)
+#define MULTI_LEN	300
+
+/* Lengths around the block and padding boundaries. */
+static const size_t multi_lengths[] = {
+  0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 191, 192,
+};
+
+#define NUM_MULTI_LENGTHS (sizeof(multi_lengths) / sizeof(multi_lengths[0]))
+
+/* A random length, often one of `multi_lengths'. */
+static size_t
+multi_length(void)
+{
+  if (random(2))
+    return multi_lengths[random(NUM_MULTI_LENGTHS)];
+
+  return random(MULTI_LEN + 1);
+}
+
+/* Check `count' messages of unequal lengths with `rounds' calls of
+   updateMulti(), starting from contexts that hold random prefixes. */
+static void
+check_multi(size_t count, int rounds, bool hmac)
+{
+  static uint8_t data[MAX_MULTI][MULTI_LEN];
+  static Sha256Class contexts[MAX_MULTI], single[MAX_MULTI];
+  Sha256Class *ctx[MAX_MULTI];
+  const uint8_t *p[MAX_MULTI];
+  uint8_t *hashes[MAX_MULTI];
+  size_t lengths[MAX_MULTI];
+  uint8_t key[80];
+  size_t i, j, key_len;
+  int round;
+
+  for (i = 0; i < count; i++)
+    {
+      if (hmac)
+        {
+          key_len = random(sizeof(key) + 1);
+          for (j = 0; j < key_len; j++)
+            key[j] = random(256);
+          contexts[i].initHmac(key, key_len);
+        }
+      else
+        contexts[i].init();
+
+      /* A prefix that leaves a partially filled block. */
+      lengths[i] = random(2) ? multi_length() : 0;
+      for (j = 0; j < lengths[i]; j++)
+        data[i][j] = random(256);
+      contexts[i].update(data[i], lengths[i]);
+
+      single[i] = contexts[i];
+      ctx[i] = &contexts[i];
+    }
+
+  for (round = 0; round < rounds; round++)
+    {
+      for (i = 0; i < count; i++)
+        {
+          lengths[i] = multi_length();
+          for (j = 0; j < lengths[i]; j++)
+            data[i][j] = random(256);
+
+          p[i] = data[i];
+          single[i].update(data[i], lengths[i]);
+        }
+
+      Sha256Class::updateMulti(ctx, p, lengths, count);
+    }
+
+  if (hmac)
+    Sha256Class::resultHmacMulti(ctx, hashes, count);
+  else
+    Sha256Class::resultMulti(ctx, hashes, count);
+
+  for (i = 0; i < count; i++)
+    if (!TEST_CHECK_BYTES(hashes[i],
+                          hmac ? single[i].resultHmac() : single[i].result(),
+                          SHA256_HASH_LENGTH))
+      printf("  message %lu of %lu%s\n", (unsigned long) i,
+             (unsigned long) count, hmac ? ", HMAC" : "");
+}
+
+static void
+test_multi(void)
+{
+  uint8_t key[256], data[6][256];
+  Sha256Class contexts[NUM_HMAC_VECTORS];
+  Sha256Class *ctx[NUM_HMAC_VECTORS];
+  const uint8_t *p[NUM_HMAC_VECTORS];
+  uint8_t *hashes[NUM_HMAC_VECTORS];
+  size_t lengths[NUM_HMAC_VECTORS];
+  const char *kernels = "scalar";
+  size_t i, key_len, count;
+  int n;
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(SHA256_NO_SIMD)
+  if (__builtin_cpu_supports("avx2"))
+    kernels = "scalar, SSE4.1 and AVX2";
+  else if (__builtin_cpu_supports("sse4.1"))
+    kernels = "scalar and SSE4.1";
+#endif
+
+  /* The RFC 4231 test cases at once: the lanes have different keys
+     and messages of 8 to 152 bytes. */
+  for (i = 0; i < NUM_HMAC_VECTORS; i++)
+    {
+      lengths[i] = hmac_vector(&hmac_sha256_vectors[i], key, &key_len,
+                               data[i]);
+      contexts[i].initHmac(key, key_len);
+      ctx[i] = &contexts[i];
+      p[i] = data[i];
+    }
+
+  Sha256Class::updateMulti(ctx, p, lengths, NUM_HMAC_VECTORS);
+  Sha256Class::resultHmacMulti(ctx, hashes, NUM_HMAC_VECTORS);
+
+  for (i = 0; i < NUM_HMAC_VECTORS; i++)
+    if (!check_hash(hashes[i], hmac_sha256_vectors[i].hmac))
+      printf("  multi-buffer HMAC vector %lu\n", (unsigned long) i);
+
+  for (count = 1; count <= MAX_MULTI; count++)
+    for (n = 0; n < 20; n++)
+      {
+        check_multi(count, 1 + n % 3, false);
+        check_multi(count, 1 + n % 3, true);
+      }
+
+  printf("sha256: multi-buffer kernels: %s\n", kernels);
+}
+
+int
+main(int argc, char *argv[])
+{
+  Sha1Class sha1;
+  Sha256Class sha256;
+  size_t i;
+
+  host_init();
+  randomSeed(1);
+
+  for (i = 0; i < MESSAGE_LEN; i++)
+    message[i] = random(256);
+
+  test_hash(sha1, false);
+  test_hash(sha256, true);
+
+  test_hmac(sha1, hmac_sha1_vectors);
+  test_hmac(sha256, hmac_sha256_vectors);
+
+  /* Around the block and padding boundaries and across several
+     blocks. */
+  for (i = 1; i < MESSAGE_LEN; i += (i < 140 ? 1 : 37))
+    {
+      test_split(sha1, i, SHA1_HASH_LENGTH);
+      test_split(sha256, i, SHA256_HASH_LENGTH);
+    }
+
+  test_sha1_kernel();
+  test_multi();
+
+#if defined(SHA1_NO_SHA_NI) && defined(SHA256_NO_SIMD)
+  return test_exit("sha (portable)");
+#else
+  return test_exit("sha");
+#endif
+}
@@ -0,0 +1,252 @@
+/*
+ * test_syncclock.cpp - SyncClock drift estimate and error bound
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The test runs the clock for months of simulated time over local
+   oscillators that drift up to the tolerance of the board resonators.
+   The reference is a Date header: the true time truncated to the
+   second when the server sent it, which is a random network delay
+   before the clock sees it.  The clock is synchronized whenever it
+   says it needs to be, and the test checks that the true error stays
+   within the predicted error and the maximum error, that the drift is
+   estimated, and that the synchronizations get rare once it is.
+
+   It then feeds the clock bad references: a stale Date among the
+   samples is evicted and one between them is ignored. */
+
+#include <math.h>
+#include <stdio.h>
+
+#include <SyncClock.h>
+
+#include "test.h"
+
+/* The simulation step in milliseconds. */
+#define STEP		60000UL
+
+#define DAY		(24UL * 60UL * 60UL * 1000UL)
+#define DAYS		90
+
+/* The range of the network delay in milliseconds. */
+#define MIN_DELAY	50
+#define MAX_DELAY	250
+
+/* The wall clock time of the host may advance between the readings of
+   the clock and the true time. */
+#define SLACK		5
+
+/* The limits for the synchronizations over DAYS and for the error of
+   the drift estimate in parts per million. */
+#define MAX_SYNCS	30
+#define MAX_DRIFT_ERROR	5
+
+/* The true clock: UTC milliseconds at the local time `start_local',
+   and the rate of UTC per local time. */
+static double start_utc = 1318622958123.0;
+static unsigned long start_local;
+static double rate;
+
+/* The largest seen ratio of the true error to the predicted one. */
+static double worst_ratio;
+
+static double
+true_ms(void)
+{
+  return start_utc + (millis() - start_local) * rate;
+}
+
+/* Synchronize `clock' to a Date that is `offset' seconds off. */
+static void
+sync(SyncClock &clock, long offset)
+{
+  double sent = true_ms() - random(MIN_DELAY, MAX_DELAY + 1);
+
+  clock.sync((unsigned long) (sent / 1000) + offset);
+}
+
+/* Check the clock against the true time. */
+static void
+check(SyncClock &clock)
+{
+  uint64_t ms = clock.get_time_ms();
+  double error = fabs(ms - true_ms());
+  unsigned long predicted = clock.get_error_ms();
+
+  TEST_CHECK(error <= predicted + SLACK);
+  TEST_CHECK(error <= SYNC_CLOCK_DEFAULT_MAX_ERROR);
+
+  /* The seconds may have turned since `ms'. */
+  TEST_CHECK(clock.get_time() - (unsigned long) (ms / 1000) <= 1);
+
+  if (error / predicted > worst_ratio)
+    worst_ratio = error / predicted;
+}
+
+/* The drift of the true clock in parts per million: an oscillator
+   that is fast loses time. */
+static long
+true_drift(void)
+{
+  return lround((rate - 1.0) * 1e6);
+}
+
+/* Start a new clock on an oscillator that is `ppm' fast. */
+static void
+start(SyncClock &clock, long ppm)
+{
+  host_advance_time(DAY);
+
+  start_local = millis();
+  rate = 1.0 / (1.0 + ppm / 1e6);
+  worst_ratio = 0;
+
+  TEST_CHECK(!clock.is_set());
+  TEST_CHECK(clock.needs_sync());
+  TEST_CHECK(clock.get_time_ms() == 0);
+}
+
+/* Run the clock for `days' and return the number of
+   synchronizations. */
+static unsigned long
+run(SyncClock &clock, unsigned long days)
+{
+  unsigned long t, syncs = 0;
+
+  for (t = 0; t < days * DAY; t += STEP)
+    {
+      if (clock.needs_sync())
+        {
+          sync(clock, 0);
+          syncs++;
+        }
+
+      check(clock);
+      host_advance_time(STEP * 1000ULL);
+    }
+
+  return syncs;
+}
+
+static void
+test_drift(long ppm)
+{
+  SyncClock clock;
+  unsigned long syncs;
+
+  start(clock, ppm);
+  syncs = run(clock, DAYS);
+
+  printf("%+5ld ppm: %lu syncs in %d days, drift %+ld ppm, "
+         "worst error %.0f%% of predicted\n",
+         ppm, syncs, DAYS, clock.get_drift_ppm(), worst_ratio * 100);
+
+  TEST_CHECK(syncs <= MAX_SYNCS);
+  TEST_CHECK(labs(clock.get_drift_ppm() - true_drift()) <= MAX_DRIFT_ERROR);
+}
+
+static void
+test_outliers(void)
+{
+  SyncClock clock;
+  long ppm = 120;
+  long drift;
+  unsigned long error;
+
+  start(clock, ppm);
+  run(clock, 30);
+
+  drift = clock.get_drift_ppm();
+  TEST_CHECK(labs(drift - true_drift()) <= MAX_DRIFT_ERROR);
+
+  /* A stale Date an hour off becomes a sample but it is evicted and
+     the clock and the drift stay. */
+  while (!clock.needs_sync())
+    host_advance_time(STEP * 1000ULL);
+
+  sync(clock, -3600);
+  check(clock);
+  TEST_CHECK(clock.get_drift_ppm() == drift);
+  TEST_CHECK(clock.get_error_ms() <= 2 * SYNC_CLOCK_SAMPLE_ERROR);
+
+  /* A bad Date soon after a sample is ignored; a good one keeps the
+     clock within its error. */
+  host_advance_time(SYNC_CLOCK_MIN_INTERVAL * 1000ULL);
+  sync(clock, 0);
+  check(clock);
+  drift = clock.get_drift_ppm();
+
+  host_advance_time(SYNC_CLOCK_MIN_INTERVAL / 2 * 1000ULL);
+  error = clock.get_error_ms();
+  sync(clock, 7200);
+  check(clock);
+  TEST_CHECK(clock.get_error_ms() == error);
+
+  sync(clock, 0);
+  check(clock);
+  TEST_CHECK(clock.get_drift_ppm() == drift);
+
+  run(clock, 30);
+  TEST_CHECK(labs(clock.get_drift_ppm() - true_drift()) <= MAX_DRIFT_ERROR);
+
+  printf("outliers: drift %+ld ppm, worst error %.0f%% of predicted\n",
+         clock.get_drift_ppm(), worst_ratio * 100);
+}
+
+/* Run the clock for 100 days without synchronizing it.  The anchor
+   point of the clock moves forward every 2^31 milliseconds. */
+static void
+test_long_gap(void)
+{
+  SyncClock clock;
+  long ppm = -900;
+  unsigned long syncs;
+
+  start(clock, ppm);
+  run(clock, 30);
+
+  clock.set_max_error(0xffffffffUL);
+  syncs = run(clock, 100);
+
+  printf("long gap: %lu syncs in 100 days, error %lu ms, "
+         "worst error %.0f%% of predicted\n",
+         syncs, clock.get_error_ms(), worst_ratio * 100);
+
+  TEST_CHECK(syncs == 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  static const long drifts[] = {-3000, -150, 0, 80, 2500, 4900};
+  size_t i;
+
+  host_init();
+  randomSeed(42);
+
+  for (i = 0; i < sizeof(drifts) / sizeof(drifts[0]); i++)
+    test_drift(drifts[i]);
+
+  test_outliers();
+  test_long_gap();
+
+  return test_exit("syncclock");
+}
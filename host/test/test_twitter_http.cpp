@@ -0,0 +1,756 @@
+/*
+ * test_twitter_http.cpp - Twitter HTTP requests against a local server
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The test runs a stand-in HTTP server in a child process and posts status
+   updates and media to it through the EthernetClient stand-in.  The
+   server answers from a script: replies with Content-Length, chunked
+   replies and replies that end when the connection closes, with
+   bodies of several hundred KB, and a kept-alive connection that it
+   closes after reading the next request.  It records every request
+   and the test compares the bodies byte for byte with ones built
+   here from the HTTP and multipart specifications. */
+
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <Twitter.h>
+
+#include "test.h"
+
+/* The time of the `Date' header of the replies. */
+#define SERVER_TIME 1792238400UL
+
+/* How the server replies to a request. */
+#define REPLY_LENGTH	0	/* Body with Content-Length */
+#define REPLY_CHUNKED	1	/* Chunked body */
+#define REPLY_EOF	2	/* Body ends when the connection closes */
+#define REPLY_DROP	3	/* Close the connection without a reply */
+
+struct Reply
+{
+  int kind;
+  size_t body_len;
+  const char *id_str;
+
+  /* The HTTP status; 0 for 200. */
+  int status;
+};
+
+/* The server script, one reply per request in this order. */
+static const Reply script[] =
+  {
+    {REPLY_LENGTH, 300000, "1001"},
+    {REPLY_CHUNKED, 400000, "1002"},
+    {REPLY_DROP, 0, 0},
+    {REPLY_EOF, 250000, "1003"},
+    {REPLY_CHUNKED, 350000, "1004"},
+    {REPLY_LENGTH, 0, 0},
+    {REPLY_LENGTH, 0, 0, 403},
+    {REPLY_EOF, 0, 0, 401},
+    {REPLY_LENGTH, 0, 0, 401},
+    {REPLY_LENGTH, 0, 0, 401},
+  };
+
+#define NUM_REPLIES (sizeof(script) / sizeof(script[0]))
+
+/* A request as the server received it. */
+struct Request
+{
+  /* The number of the connection it came in, from 1. */
+  int connection;
+
+  /* The request line and the headers without the final empty
+     line. */
+  char *head;
+
+  /* The body. */
+  uint8_t *body;
+  size_t body_len;
+};
+
+/* The space for the recorded requests. */
+#define SERVER_DATA_LEN (8 * 1024 * 1024)
+
+/* The server records the requests in memory shared with the test
+   before it replies to them. */
+struct ServerState
+{
+  size_t num_requests;
+  Request requests[NUM_REPLIES];
+
+  /* The failed checks of the server. */
+  unsigned long failures;
+
+  size_t data_used;
+  uint8_t data[SERVER_DATA_LEN];
+};
+
+static ServerState *server;
+
+static int listen_fd;
+static pid_t server_pid;
+static uint16_t server_port;
+
+/* The receive buffer of the current server connection. */
+static uint8_t *inbuf;
+static size_t inbuf_len;
+static size_t inbuf_size;
+
+/* Read more data from `fd' to `inbuf'.  The function returns false on
+   EOF, error or timeout. */
+static bool
+server_fill(int fd)
+{
+  ssize_t got;
+
+  if (inbuf_len == inbuf_size)
+    {
+      inbuf_size = inbuf_size ? inbuf_size * 2 : 65536;
+      inbuf = (uint8_t *) realloc(inbuf, inbuf_size);
+    }
+
+  got = recv(fd, inbuf + inbuf_len, inbuf_size - inbuf_len, 0);
+  if (got <= 0)
+    return false;
+
+  inbuf_len += got;
+
+  return true;
+}
+
+/* Find the value of the header `name' in the request head `head'. */
+static const char *
+find_header(const char *head, const char *name)
+{
+  size_t len = strlen(name);
+  const char *cp;
+
+  for (cp = strstr(head, "\r\n"); cp; cp = strstr(cp, "\r\n"))
+    {
+      cp += 2;
+      if (strncasecmp(cp, name, len) == 0 && cp[len] == ':')
+        {
+          for (cp += len + 1; *cp == ' '; cp++)
+            ;
+          return cp;
+        }
+    }
+
+  return 0;
+}
+
+/* Allocate `len' bytes from the shared memory. */
+static void *
+server_alloc(size_t len)
+{
+  void *ptr;
+
+  if (server->data_used + len > SERVER_DATA_LEN)
+    {
+      fprintf(stderr, "server: out of memory for the requests\n");
+      exit(1);
+    }
+
+  ptr = server->data + server->data_used;
+  server->data_used += len;
+
+  return ptr;
+}
+
+/* Record a failed check of the server. */
+static void
+server_fail(const char *what)
+{
+  fprintf(stderr, "server: %s\n", what);
+  server->failures++;
+}
+
+/* Read a request from `fd' into `request'.  The function returns
+   false if the connection was closed. */
+static bool
+server_read_request(int fd, Request *request)
+{
+  uint8_t *end;
+  size_t head_len, body_len;
+  const char *value;
+
+  while ((end = (uint8_t *) memmem(inbuf, inbuf_len, "\r\n\r\n", 4)) == 0)
+    if (!server_fill(fd))
+      return false;
+
+  head_len = end - inbuf;
+  request->head = (char *) server_alloc(head_len + 1);
+  memcpy(request->head, inbuf, head_len);
+  request->head[head_len] = '\0';
+
+  value = find_header(request->head, "Content-Length");
+  body_len = value ? strtoul(value, 0, 10) : 0;
+
+  while (inbuf_len < head_len + 4 + body_len)
+    if (!server_fill(fd))
+      {
+        server_fail("request body shorter than its Content-Length");
+        return false;
+      }
+
+  request->body = (uint8_t *) server_alloc(body_len + 1);
+  request->body_len = body_len;
+  memcpy(request->body, inbuf + head_len + 4, body_len);
+
+  inbuf_len -= head_len + 4 + body_len;
+  memmove(inbuf, inbuf + head_len + 4 + body_len, inbuf_len);
+
+  return true;
+}
+
+static bool
+server_write(int fd, const void *data, size_t len)
+{
+  const uint8_t *cp = (const uint8_t *) data;
+  ssize_t got;
+
+  while (len > 0)
+    {
+      got = send(fd, cp, len, MSG_NOSIGNAL);
+      if (got < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return false;
+        }
+
+      cp += got;
+      len -= got;
+    }
+
+  return true;
+}
+
+/* Build a JSON response body of exactly `len' bytes with the status ID
+   `id_str'.  The body is a long string value with escapes, an array
+   of small objects and the ID last, so a byte lost or repeated
+   anywhere breaks the document or the ID. */
+static char *
+make_body(size_t len, const char *id_str)
+{
+  static const char piece[] = "Sensor \\\"1\\\" at 21.5\\u00b0C\\n\\\\ ";
+  char *body = (char *) malloc(len + 1);
+  char tail[64];
+  size_t pos, tail_len;
+  int n;
+
+  snprintf(tail, sizeof(tail), "\"}],\"id_str\":\"%s\"}", id_str);
+  tail_len = strlen(tail);
+
+  pos = sprintf(body, "{\"text\":\"");
+  while (pos + sizeof(piece) - 1 < len / 2)
+    {
+      memcpy(body + pos, piece, sizeof(piece) - 1);
+      pos += sizeof(piece) - 1;
+    }
+
+  pos += sprintf(body + pos, "\",\"entities\":[");
+  for (n = 0; pos + 32 + tail_len < len; n++)
+    pos += sprintf(body + pos, "{\"n\":%d},", n);
+
+  /* Pad the last string to the exact length. */
+  pos += sprintf(body + pos, "{\"pad\":\"");
+  while (pos + tail_len < len)
+    body[pos++] = 'x';
+
+  memcpy(body + pos, tail, tail_len + 1);
+
+  return body;
+}
+
+static bool
+server_reply(int fd, const Reply *reply)
+{
+  static const size_t chunk_sizes[] = {1, 7, 0x100, 0x1fff, 4099, 65536};
+  char head[512];
+  char *body = 0;
+  size_t pos, len;
+  int i;
+  bool ok;
+
+  if (reply->kind == REPLY_DROP)
+    return false;
+
+  if (reply->id_str)
+    body = make_body(reply->body_len, reply->id_str);
+
+  len = snprintf(head, sizeof(head),
+                 "HTTP/1.1 %d Status\r\n"
+                 "Date: Sat, 17 Oct 2026 12:00:00 GMT\r\n"
+                 "Content-Type: application/json; charset=utf-8\r\n",
+                 reply->status ? reply->status : 200);
+
+  switch (reply->kind)
+    {
+    case REPLY_LENGTH:
+      len += snprintf(head + len, sizeof(head) - len,
+                      "Content-Length: %lu\r\n",
+                      (unsigned long) reply->body_len);
+      break;
+
+    case REPLY_CHUNKED:
+      len += snprintf(head + len, sizeof(head) - len,
+                      "Transfer-Encoding: chunked\r\n");
+      break;
+
+    case REPLY_EOF:
+      len += snprintf(head + len, sizeof(head) - len,
+                      "Connection: close\r\n");
+      break;
+    }
+
+  len += snprintf(head + len, sizeof(head) - len, "\r\n");
+  ok = server_write(fd, head, len);
+
+  if (reply->kind != REPLY_CHUNKED)
+    {
+      if (body)
+        ok = ok && server_write(fd, body, reply->body_len);
+    }
+  else
+    {
+      /* Chunks of varying sizes with upper and lower case digits and
+         an extension, then a trailer. */
+      for (pos = 0, i = 0; pos < reply->body_len; pos += len, i++)
+        {
+          len = chunk_sizes[i % 6];
+          if (len > reply->body_len - pos)
+            len = reply->body_len - pos;
+
+          snprintf(head, sizeof(head), i % 2 ? "%lX\r\n" : "%lx;ext=%d\r\n",
+                   (unsigned long) len, i);
+          ok = ok && server_write(fd, head, strlen(head));
+          ok = ok && server_write(fd, body + pos, len);
+          ok = ok && server_write(fd, "\r\n", 2);
+        }
+
+      ok = ok && server_write(fd, "0\r\nX-Trailer: 1\r\n\r\n", 19);
+    }
+
+  free(body);
+
+  return ok && reply->kind != REPLY_EOF;
+}
+
+static void
+server_main(void)
+{
+  int connection = 0;
+  int fd;
+  size_t n;
+  Request request;
+
+  /* Do not hang the test if the client stops sending. */
+  alarm(60);
+
+  for (;;)
+    {
+      fd = accept(listen_fd, 0, 0);
+      if (fd < 0)
+        exit(1);
+
+      connection++;
+      inbuf_len = 0;
+
+      while (server_read_request(fd, &request))
+        {
+          request.connection = connection;
+
+          n = server->num_requests;
+          if (n >= NUM_REPLIES)
+            {
+              server_fail("more requests than replies");
+              break;
+            }
+
+          server->requests[n] = request;
+          server->num_requests++;
+
+          if (!server_reply(fd, &script[n]))
+            break;
+        }
+
+      close(fd);
+    }
+}
+
+static void
+start_server(void)
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  int on = 1;
+
+  server = (ServerState *) mmap(0, sizeof(ServerState),
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (server == MAP_FAILED)
+    {
+      perror("mmap");
+      exit(1);
+    }
+
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+
+  if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+      || listen(listen_fd, 4) < 0
+      || getsockname(listen_fd, (struct sockaddr *) &addr, &addr_len) < 0)
+    {
+      perror("server");
+      exit(1);
+    }
+
+  server_port = ntohs(addr.sin_port);
+
+  server_pid = fork();
+  if (server_pid < 0)
+    {
+      perror("fork");
+      exit(1);
+    }
+  if (server_pid == 0)
+    server_main();
+
+  close(listen_fd);
+}
+
+/* Get the request `n' or 0 if the server has not received it.  The
+   server records a request before replying to it, so the requests of
+   the completed posts are there. */
+static Request *
+get_request(size_t n)
+{
+  if (n >= server->num_requests)
+    return 0;
+
+  return &server->requests[n];
+}
+
+/* The `application/x-www-form-urlencoded' body of the status
+   `message' with the RFC 3986 unreserved characters as-is. */
+static char *
+status_body(const char *message, size_t *len_return)
+{
+  char *body = (char *) malloc(7 + 3 * strlen(message) + 1);
+  char *cp = body + sprintf(body, "status=");
+  const uint8_t *mp;
+
+  for (mp = (const uint8_t *) message; *mp; mp++)
+    if (isalnum(*mp) || *mp == '-' || *mp == '.' || *mp == '_'
+        || *mp == '~')
+      *cp++ = *mp;
+    else
+      cp += sprintf(cp, "%%%02X", *mp);
+
+  *cp = '\0';
+  *len_return = cp - body;
+
+  return body;
+}
+
+/* The value of the OAuth parameter `name' in the Authorization header
+   of the request `n' as a number, or 0 if it is missing. */
+static unsigned long
+oauth_value(size_t n, const char *name)
+{
+  Request *request = get_request(n);
+  const char *value;
+  char key[64];
+
+  value = request ? find_header(request->head, "Authorization") : 0;
+  if (!value)
+    return 0;
+
+  snprintf(key, sizeof(key), "%s=\"", name);
+  value = strstr(value, key);
+  if (!value)
+    return 0;
+
+  return strtoul(value + strlen(key), 0, 10);
+}
+
+/* Check the request `n' for the URI `uri' and the body `body',
+   `body_len'. */
+static void
+check_request(size_t n, const char *uri, const void *body, size_t body_len)
+{
+  Request *request = get_request(n);
+  char line[128];
+  const char *value;
+
+  if (!TEST_CHECK(request != 0))
+    return;
+
+  snprintf(line, sizeof(line), "POST %s HTTP/1.1\r\n", uri);
+  TEST_CHECK(strncmp(request->head, line, strlen(line)) == 0);
+
+  value = find_header(request->head, "Host");
+  TEST_CHECK(value && strncmp(value, "api.twitter.com\r\n", 17) == 0);
+
+  value = find_header(request->head, "Connection");
+  TEST_CHECK(value && strncmp(value, "keep-alive\r\n", 12) == 0);
+
+  value = find_header(request->head, "Authorization");
+  TEST_CHECK(value && strncmp(value, "OAuth oauth_consumer_key=\"", 26) == 0);
+
+  value = find_header(request->head, "Content-Length");
+  TEST_CHECK(value && strtoul(value, 0, 10) == body_len);
+
+  if (TEST_CHECK(request->body_len == body_len))
+    TEST_CHECK_BYTES(request->body, body, body_len);
+}
+
+static const char message[] =
+  "Temperature 21.5\xc2\xb0" "C & humidity 40% (sensor #1) ~ok";
+
+/* The media to upload.  The length is not a multiple of the work
+   buffer size. */
+#define MEDIA_LEN 300001
+
+static uint8_t
+media_byte(unsigned long offset)
+{
+  /* Include CR LF and dash runs that resemble a boundary. */
+  if (offset % 1000 < 4)
+    return "\r\n--"[offset % 1000];
+
+  return (offset * 2654435761UL) >> 13;
+}
+
+static unsigned long media_reads;
+
+/* Return less than asked to test short reads. */
+static size_t
+media_reader(unsigned long offset, uint8_t *buffer, size_t len)
+{
+  size_t i;
+
+  media_reads++;
+
+  if (len > 200)
+    len = 200;
+
+  for (i = 0; i < len; i++)
+    buffer[i] = media_byte(offset + i);
+
+  return len;
+}
+
+/* The multipart/form-data body of RFC 7578 for the status `message'
+   and the media, with the boundary of the request `n'. */
+static uint8_t *
+media_body(size_t n, size_t *len_return)
+{
+  Request *request = get_request(n);
+  const char *value;
+  char boundary[128];
+  uint8_t *body, *cp;
+  unsigned long i;
+  size_t len;
+
+  value = request ? find_header(request->head, "Content-Type") : 0;
+  if (!TEST_CHECK(value
+                  && strncmp(value, "multipart/form-data; boundary=", 30)
+                  == 0))
+    return 0;
+
+  value += 30;
+  len = strcspn(value, "\r");
+  if (!TEST_CHECK(len > 0 && len < sizeof(boundary)))
+    return 0;
+
+  memcpy(boundary, value, len);
+  boundary[len] = '\0';
+
+  body = (uint8_t *) malloc(MEDIA_LEN + 1024);
+  cp = body;
+  cp += sprintf((char *) cp,
+                "--%s\r\n"
+                "Content-Disposition: form-data; name=\"status\"\r\n"
+                "\r\n"
+                "%s\r\n"
+                "--%s\r\n"
+                "Content-Disposition: form-data; name=\"media[]\"; "
+                "filename=\"media\"\r\n"
+                "Content-Type: image/png\r\n"
+                "\r\n",
+                boundary, message, boundary);
+
+  for (i = 0; i < MEDIA_LEN; i++)
+    *cp++ = media_byte(i);
+
+  cp += sprintf((char *) cp, "\r\n--%s--\r\n", boundary);
+
+  *len_return = cp - body;
+
+  return body;
+}
+
+static void
+setup(Twitter *twitter)
+{
+  twitter->set_twitter_endpoint(PSTR("api.twitter.com"),
+                                PSTR("/1/statuses/update.json"),
+                                IPAddress(127, 0, 0, 1), server_port, false);
+  twitter->set_media_uri(PSTR("/1/statuses/update_with_media.json"));
+  twitter->set_client_id(PSTR("3azqS8rD5Ku7MRHY74qFRg"),
+                         PSTR("S67Jon338GJ0sNxMyWVe5ccfrH1z3HtjrVGj3xiXApQ"));
+  twitter->set_account_id(PSTR("123456789-AbCdEfGhIjKlMnOpQrStUvWxYz"),
+                          PSTR("AbCdEfGhIjKlMnOpQrStUvWxYz0123456789AbCdEf"));
+  twitter->set_keep_alive(true);
+  twitter->set_timeout(10000);
+}
+
+static char work_buffer[256];
+static Twitter twitter(work_buffer, sizeof(work_buffer));
+static char queue[64];
+
+/* A client that has not set its clock yet. */
+static char lazy_work_buffer[256];
+static Twitter lazy(lazy_work_buffer, sizeof(lazy_work_buffer));
+
+int
+main(int argc, char *argv[])
+{
+  char *body;
+  uint8_t *mbody;
+  size_t len;
+  Request *first, *retry;
+
+  host_init();
+  start_server();
+
+  setup(&twitter);
+  setup(&lazy);
+  lazy.set_lazy_clock(true);
+
+  body = status_body(message, &len);
+
+  /* Content-Length reply on a new connection. */
+  TEST_CHECK(twitter.post_status(message));
+  TEST_CHECK(twitter.get_response_code() == 200);
+  TEST_CHECK(strcmp(twitter.get_status_id(), "1001") == 0);
+  TEST_CHECK(twitter.get_time() != 0);
+  check_request(0, "/1/statuses/update.json", body, len);
+
+  /* Chunked reply on the kept-alive connection.  The request is only
+     answered if the client consumed exactly the previous body. */
+  TEST_CHECK(twitter.post_status(message));
+  TEST_CHECK(strcmp(twitter.get_status_id(), "1002") == 0);
+  check_request(1, "/1/statuses/update.json", body, len);
+  TEST_CHECK(get_request(1) && get_request(1)->connection == 1);
+
+  /* The server closes the kept-alive connection after reading the
+     request.  The client sends it again on a new connection, whose
+     reply ends when the server closes it. */
+  TEST_CHECK(twitter.post_status(message));
+  TEST_CHECK(strcmp(twitter.get_status_id(), "1003") == 0);
+  check_request(2, "/1/statuses/update.json", body, len);
+  check_request(3, "/1/statuses/update.json", body, len);
+  first = get_request(2);
+  retry = get_request(3);
+  TEST_CHECK(first && first->connection == 1);
+  TEST_CHECK(retry && retry->connection == 2);
+
+  /* Multipart media upload on a new connection with a chunked
+     reply. */
+  TEST_CHECK(twitter.post_media(message, PSTR("image/png"), MEDIA_LEN,
+                                media_reader));
+  TEST_CHECK(strcmp(twitter.get_status_id(), "1004") == 0);
+  TEST_CHECK(media_reads >= MEDIA_LEN / 200);
+  mbody = media_body(4, &len);
+  if (mbody)
+    check_request(4, "/1/statuses/update_with_media.json", mbody, len);
+  TEST_CHECK(get_request(4) && get_request(4)->connection == 3);
+
+  /* An empty reply after the chunked one on the same connection. */
+  body = status_body(message, &len);
+  TEST_CHECK(twitter.post_status(message));
+  TEST_CHECK(twitter.get_response_code() == 200);
+  TEST_CHECK(twitter.get_status_id()[0] == '\0');
+  check_request(5, "/1/statuses/update.json", body, len);
+  TEST_CHECK(get_request(5) && get_request(5)->connection == 3);
+
+  /* The queue drops a message on 403 and posts the next one right
+     away.  It keeps the message on 401 and holds before retrying.
+     The server closes the connection after the 401. */
+  twitter.set_queue(queue, sizeof(queue), -1);
+  TEST_CHECK(twitter.queue_status(message));
+  TEST_CHECK(twitter.queue_status("second"));
+  while (twitter.process_queue() == 2 && !test_failures)
+    ;
+  TEST_CHECK(twitter.get_response_code() == 403);
+  check_request(6, "/1/statuses/update.json", body, len);
+
+  body = status_body("second", &len);
+  while (twitter.get_response_code() != 401 && !test_failures)
+    TEST_CHECK(twitter.process_queue() == 1);
+  check_request(7, "/1/statuses/update.json", body, len);
+  for (len = 0; len < 1000; len++)
+    TEST_CHECK(twitter.process_queue() == 1);
+
+  /* The lazy clock: the first post is signed with the unset clock and
+     the server rejects its timestamp.  The `Date' header of the 401
+     sets the clock and the post is signed again with the new time and
+     retried once.  The 401 of the retry is final. */
+  TEST_CHECK(!lazy.get_clock()->is_set());
+  TEST_CHECK(lazy.is_ready());
+  body = status_body(message, &len);
+  TEST_CHECK(!lazy.post_status(message));
+  TEST_CHECK(lazy.get_response_code() == 401);
+  TEST_CHECK(lazy.get_time() - SERVER_TIME <= TWITTER_TIMESTAMP_SKEW);
+  check_request(8, "/1/statuses/update.json", body, len);
+  check_request(9, "/1/statuses/update.json", body, len);
+  TEST_CHECK(oauth_value(8, "oauth_timestamp")
+             + TWITTER_TIMESTAMP_SKEW < SERVER_TIME);
+  TEST_CHECK(oauth_value(9, "oauth_timestamp") - SERVER_TIME
+             <= TWITTER_TIMESTAMP_SKEW);
+
+  TEST_CHECK(server->num_requests == NUM_REPLIES);
+
+  kill(server_pid, SIGTERM);
+  test_failures += server->failures;
+
+  return test_exit("twitter_http");
+}
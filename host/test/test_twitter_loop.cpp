@@ -0,0 +1,336 @@
+/*
+ * test_twitter_loop.cpp - loop() latency during a Twitter post
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The test replaces the EthernetClient stand-in with a fake one that
+   injects the delays of a slow board and network into a simulated
+   clock: connecting takes CONNECT_DELAY, every byte moved over the
+   client costs BYTE_DELAY like the SPI transfers of the Ethernet
+   shield, and the response arrives in SEGMENT_LEN byte segments
+   SEGMENT_DELAY apart.  A sketch-like loop posts with begin_post()
+   and poll(), spending LOOP_WORK on its other work in each iteration,
+   and the test checks that no poll() takes longer than POLL_BOUND
+   while the post takes many times that.  The blocking post_status()
+   is run for comparison with the loop work in its idle callback.
+
+   The simulated clock keeps the test independent of the load of the
+   host.  The Twitter response timeout still runs on millis().
+
+   The fake client is linked instead of the one in libhost.a since
+   this program defines all the EthernetClient methods. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <Twitter.h>
+
+#include "test.h"
+
+/* The simulated delays in microseconds. */
+#define CONNECT_DELAY	30000
+#define FIRST_BYTE_DELAY 50000
+#define SEGMENT_DELAY	5000
+#define BYTE_DELAY	4
+#define LOOP_WORK	1000
+
+#define SEGMENT_LEN	64
+
+/* The longest allowed poll().  The loop work is shorter than the
+   segment delay so that a poll finds at most one new segment. */
+#define POLL_BOUND	(SEGMENT_LEN * BYTE_DELAY)
+
+/* The simulated time in microseconds. */
+static unsigned long sim_time;
+
+/* The response: a chunked body of several segments after the
+   headers. */
+static char response[8192];
+static size_t response_len;
+
+/* The request written to the client. */
+static char request[2048];
+static size_t request_len;
+
+/* The position in the response and the time when it started to
+   arrive. */
+static size_t response_pos;
+static unsigned long response_start;
+
+static void
+build_response(void)
+{
+  char chunk[200];
+  int i;
+
+  response_len = snprintf(response, sizeof(response),
+                          "HTTP/1.1 200 OK\r\n"
+                          "Date: Sat, 17 Oct 2026 12:00:00 GMT\r\n"
+                          "Content-Type: application/json\r\n"
+                          "Transfer-Encoding: chunked\r\n"
+                          "\r\n");
+
+  /* The interesting value first, then padding to spread the body
+     over many segments. */
+  snprintf(chunk, sizeof(chunk), "{\"id_str\":\"4711\",\"text\":\"");
+  response_len += snprintf(response + response_len,
+                           sizeof(response) - response_len,
+                           "%x\r\n%s\r\n", (int) strlen(chunk), chunk);
+
+  memset(chunk, 'x', 150);
+  chunk[150] = '\0';
+  for (i = 0; i < 30; i++)
+    response_len += snprintf(response + response_len,
+                             sizeof(response) - response_len,
+                             "%x\r\n%s\r\n", (int) strlen(chunk), chunk);
+
+  response_len += snprintf(response + response_len,
+                           sizeof(response) - response_len,
+                           "2\r\n\"}\r\n0\r\n\r\n");
+}
+
+/* The number of response bytes that have arrived by now. */
+static size_t
+response_arrived(void)
+{
+  unsigned long elapsed = sim_time - response_start;
+  size_t len;
+
+  if (elapsed < FIRST_BYTE_DELAY)
+    return 0;
+
+  len = ((elapsed - FIRST_BYTE_DELAY) / SEGMENT_DELAY + 1) * SEGMENT_LEN;
+
+  return len < response_len ? len : response_len;
+}
+
+EthernetClient::EthernetClient()
+  : fd(-1),
+    eof(false)
+{
+}
+
+int
+EthernetClient::connect(IPAddress ip, uint16_t port)
+{
+  sim_time += CONNECT_DELAY;
+
+  fd = 1;
+  request_len = 0;
+  response_pos = 0;
+  response_start = sim_time;
+
+  return 1;
+}
+
+int
+EthernetClient::connect(const char *host, uint16_t port)
+{
+  return connect(IPAddress(127, 0, 0, 1), port);
+}
+
+size_t
+EthernetClient::write(uint8_t byte)
+{
+  return write(&byte, 1);
+}
+
+size_t
+EthernetClient::write(const uint8_t *buffer, size_t size)
+{
+  if (fd < 0)
+    return 0;
+
+  sim_time += size * BYTE_DELAY;
+
+  if (size > sizeof(request) - request_len)
+    size = sizeof(request) - request_len;
+
+  memcpy(request + request_len, buffer, size);
+  request_len += size;
+
+  return size;
+}
+
+int
+EthernetClient::available(void)
+{
+  if (fd < 0)
+    return 0;
+
+  return response_arrived() - response_pos;
+}
+
+int
+EthernetClient::read(void)
+{
+  if (available() <= 0)
+    return -1;
+
+  sim_time += BYTE_DELAY;
+
+  return (uint8_t) response[response_pos++];
+}
+
+int
+EthernetClient::read(uint8_t *buffer, size_t size)
+{
+  size_t i;
+  int ch;
+
+  for (i = 0; i < size && (ch = read()) >= 0; i++)
+    buffer[i] = ch;
+
+  return i ? i : -1;
+}
+
+int
+EthernetClient::peek(void)
+{
+  if (available() <= 0)
+    return -1;
+
+  return (uint8_t) response[response_pos];
+}
+
+void
+EthernetClient::flush(void)
+{
+}
+
+void
+EthernetClient::stop(void)
+{
+  fd = -1;
+}
+
+uint8_t
+EthernetClient::connected(void)
+{
+  return fd >= 0;
+}
+
+EthernetClient::operator bool()
+{
+  return fd >= 0;
+}
+
+/* The longest gap between the idle callbacks of post_status() other
+   than the first one, which includes connecting and sending. */
+static unsigned long idle_last;
+static unsigned long idle_max;
+static unsigned long idle_calls;
+
+static void
+idle(void)
+{
+  if (idle_calls++ && sim_time - idle_last > idle_max)
+    idle_max = sim_time - idle_last;
+
+  sim_time += LOOP_WORK;
+  idle_last = sim_time;
+}
+
+static char work_buffer[256];
+static Twitter twitter(work_buffer, sizeof(work_buffer));
+
+int
+main(int argc, char *argv[])
+{
+  static const char message[] = "Loop latency";
+  unsigned long start, now, poll_start, poll_max, loops;
+  unsigned long min_post;
+  int result;
+
+  host_init();
+  build_response();
+
+  twitter.set_twitter_endpoint(PSTR("api.twitter.com"),
+                               PSTR("/1/statuses/update.json"),
+                               IPAddress(127, 0, 0, 1), 80, false);
+  twitter.set_client_id(PSTR("3azqS8rD5Ku7MRHY74qFRg"),
+                        PSTR("S67Jon338GJ0sNxMyWVe5ccfrH1z3HtjrVGj3xiXApQ"));
+  twitter.set_account_id(PSTR("123456789-AbCdEfGhIjKlMnOpQrStUvWxYz"),
+                         PSTR("AbCdEfGhIjKlMnOpQrStUvWxYz0123456789AbCdEf"));
+  twitter.set_timeout(10000);
+
+  /* The time the whole response takes to arrive. */
+  min_post = FIRST_BYTE_DELAY
+    + (response_len / SEGMENT_LEN) * SEGMENT_DELAY;
+
+  /* Connecting and sending are synchronous: begin_post() takes the
+     connect delay and the cost of writing the request. */
+  start = sim_time;
+  TEST_CHECK(twitter.begin_post(message));
+  now = sim_time;
+  TEST_CHECK(now - start == CONNECT_DELAY + request_len * BYTE_DELAY);
+  TEST_CHECK(strncmp(request, "POST /1/statuses/update.json ", 29) == 0);
+
+  /* The sketch loop: the response is processed as it arrives and the
+     other work of the loop keeps running. */
+  poll_max = 0;
+  loops = 0;
+  do
+    {
+      poll_start = sim_time;
+      result = twitter.poll();
+      if (sim_time - poll_start > poll_max)
+        poll_max = sim_time - poll_start;
+
+      sim_time += LOOP_WORK;
+      loops++;
+    }
+  while (result == TWITTER_IN_PROGRESS);
+  now = sim_time;
+
+  printf("poll: %lu loops in %lu us, longest poll %lu us\n",
+         loops, now - start, poll_max);
+
+  TEST_CHECK(result == TWITTER_DONE);
+  TEST_CHECK(twitter.get_response_code() == 200);
+  TEST_CHECK(strcmp(twitter.get_status_id(), "4711") == 0);
+  TEST_CHECK(response_pos == response_len);
+  TEST_CHECK(now - start >= min_post);
+  TEST_CHECK(poll_max <= POLL_BOUND);
+  TEST_CHECK(loops >= (now - start - CONNECT_DELAY)
+             / (LOOP_WORK + POLL_BOUND));
+
+  /* The blocking post keeps the caller for the whole response but
+     calls the idle callback between the polls. */
+  twitter.set_idle_callback(idle);
+  idle_calls = 0;
+  idle_max = 0;
+  start = sim_time;
+  TEST_CHECK(twitter.post_status(message));
+  now = sim_time;
+
+  printf("post_status: %lu us, %lu idle calls, longest gap %lu us\n",
+         now - start, idle_calls, idle_max);
+
+  TEST_CHECK(twitter.get_response_code() == 200);
+  TEST_CHECK(strcmp(twitter.get_status_id(), "4711") == 0);
+  TEST_CHECK(now - start >= CONNECT_DELAY + min_post);
+  TEST_CHECK(idle_calls >= (now - start - CONNECT_DELAY)
+             / (LOOP_WORK + POLL_BOUND));
+  TEST_CHECK(idle_max <= POLL_BOUND);
+
+  return test_exit("twitter_loop");
+}
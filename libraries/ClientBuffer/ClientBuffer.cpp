@@ -0,0 +1,92 @@
+/*
+ * ClientBuffer.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2011 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ClientBuffer.h"
+
+ClientBuffer::ClientBuffer(Client *client, uint8_t *buffer, size_t buffer_len)
+  : client(client),
+    buffer(buffer),
+    buffer_len(buffer_len),
+    buffer_pos(0)
+{
+}
+
+size_t
+ClientBuffer::write(uint8_t byte)
+{
+#ifdef CLIENT_BUFFER_UNBUFFERED
+  return client->write(byte);
+#else /* not CLIENT_BUFFER_UNBUFFERED */
+  if (buffer_pos >= buffer_len && !flush())
+    return 0;
+
+  buffer[buffer_pos++] = byte;
+
+  return 1;
+#endif /* not CLIENT_BUFFER_UNBUFFERED */
+}
+
+size_t
+ClientBuffer::write(const uint8_t *data, size_t len)
+{
+#ifdef CLIENT_BUFFER_UNBUFFERED
+  return client->write(data, len);
+#else /* not CLIENT_BUFFER_UNBUFFERED */
+  size_t done = 0;
+  size_t n;
+
+  while (buffer_pos + len - done > buffer_len)
+    {
+      if (buffer_pos == 0)
+        /* More than a buffer full left, no point copying it. */
+        return done + client->write(data + done, len - done);
+
+      /* Fill the buffer and send it. */
+      n = buffer_len - buffer_pos;
+      memcpy(buffer + buffer_pos, data + done, n);
+      buffer_pos += n;
+      done += n;
+
+      if (!flush())
+        return 0;
+    }
+
+  memcpy(buffer + buffer_pos, data + done, len - done);
+  buffer_pos += len - done;
+
+  return len;
+#endif /* not CLIENT_BUFFER_UNBUFFERED */
+}
+
+bool
+ClientBuffer::flush(void)
+{
+  size_t len = buffer_pos;
+
+  if (len == 0)
+    return true;
+
+  buffer_pos = 0;
+
+  return client->write(buffer, len) == len;
+}
@@ -0,0 +1,76 @@
+/* -*- c++ -*-
+ *
+ * ClientBuffer.h
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CLIENTBUFFER_H
+#define CLIENTBUFFER_H
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include <Ethernet.h>
+
+/* A write-combining output stage for network clients.  Small writes
+   are collected into the buffer and sent to the client with a single
+   write when the buffer fills up or when flush() is called.  Every
+   client write is a separate operation with the Ethernet controller
+   and often a separate TCP segment, so this cuts down the packets and
+   the latency of requests that are printed piece by piece.
+
+   If CLIENT_BUFFER_UNBUFFERED is defined, every write is passed to
+   the client as it is made, e.g. to count the writes that the buffer
+   saves. */
+class ClientBuffer : public Print
+{
+public:
+
+  /* Constructs a new buffer for the client `client' with the output
+     buffer `buffer', `buffer_len'. */
+  ClientBuffer(Client *client, uint8_t *buffer, size_t buffer_len);
+
+  virtual size_t write(uint8_t byte);
+
+  /* Write `len' bytes from `data'.  The data fills up the buffer
+     before it is sent, and the data left over after that is written
+     directly to the client if it is more than a buffer full. */
+  virtual size_t write(const uint8_t *data, size_t len);
+
+  using Print::write;
+
+  /* Send the buffered data to the client.  The method returns true if
+     the data was written and false on error. */
+  bool flush(void);
+
+private:
+
+  Client *client;
+
+  uint8_t *buffer;
+  size_t buffer_len;
+  size_t buffer_pos;
+};
+
+#endif /* not CLIENTBUFFER_H */
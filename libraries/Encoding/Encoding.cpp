@@ -0,0 +1,178 @@
+/*
+ * Encoding.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2011 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "Encoding.h"
+
+#ifdef ENCODING_HEX_PAIR_TABLE
+
+/* The digit pairs of all byte values, the first digit in the high
+   byte. */
+#define HEX_DIGIT(v, a) ((v) < 10 ? '0' + (v) : (a) + (v) - 10)
+#define HEX_PAIR(h, l, a) ((HEX_DIGIT(h, a) << 8) | HEX_DIGIT(l, a))
+#define HEX_ROW(h, a)                                                   \
+  HEX_PAIR(h, 0, a), HEX_PAIR(h, 1, a), HEX_PAIR(h, 2, a),              \
+    HEX_PAIR(h, 3, a), HEX_PAIR(h, 4, a), HEX_PAIR(h, 5, a),            \
+    HEX_PAIR(h, 6, a), HEX_PAIR(h, 7, a), HEX_PAIR(h, 8, a),            \
+    HEX_PAIR(h, 9, a), HEX_PAIR(h, 10, a), HEX_PAIR(h, 11, a),          \
+    HEX_PAIR(h, 12, a), HEX_PAIR(h, 13, a), HEX_PAIR(h, 14, a),         \
+    HEX_PAIR(h, 15, a)
+#define HEX_TABLE(a)                                                    \
+  HEX_ROW(0, a), HEX_ROW(1, a), HEX_ROW(2, a), HEX_ROW(3, a),           \
+    HEX_ROW(4, a), HEX_ROW(5, a), HEX_ROW(6, a), HEX_ROW(7, a),         \
+    HEX_ROW(8, a), HEX_ROW(9, a), HEX_ROW(10, a), HEX_ROW(11, a),       \
+    HEX_ROW(12, a), HEX_ROW(13, a), HEX_ROW(14, a), HEX_ROW(15, a)
+
+const static uint16_t hex_lower[256] PROGMEM = { HEX_TABLE('a') };
+const static uint16_t hex_upper[256] PROGMEM = { HEX_TABLE('A') };
+
+#else /* not ENCODING_HEX_PAIR_TABLE */
+
+const static char hex_lower[] PROGMEM = "0123456789abcdef";
+const static char hex_upper[] PROGMEM = "0123456789ABCDEF";
+
+#endif /* not ENCODING_HEX_PAIR_TABLE */
+
+const static char base64_table[] PROGMEM
+= "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const static char base64url_table[] PROGMEM
+= "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+char *
+Encoding::hex_encode(char *buffer, const uint8_t *data, size_t data_len)
+{
+  return hex_encode(buffer, data, data_len, false);
+}
+
+char *
+Encoding::hex_encode_upper(char *buffer, const uint8_t *data,
+                           size_t data_len)
+{
+  return hex_encode(buffer, data, data_len, true);
+}
+
+char *
+Encoding::hex_encode(char *buffer, const uint8_t *data, size_t data_len,
+                     bool upper)
+{
+#ifdef ENCODING_HEX_PAIR_TABLE
+  const uint16_t *table = upper ? hex_upper : hex_lower;
+  uint16_t pair;
+
+  for (; data_len > 0; data_len--)
+    {
+      pair = pgm_read_word(table + *data++);
+
+      *buffer++ = (char) (pair >> 8);
+      *buffer++ = (char) (pair & 0xff);
+    }
+#else /* not ENCODING_HEX_PAIR_TABLE */
+  const prog_char *table = upper ? hex_upper : hex_lower;
+  uint8_t byte;
+
+  for (; data_len > 0; data_len--)
+    {
+      byte = *data++;
+
+      *buffer++ = (char) pgm_read_byte(table + (byte >> 4));
+      *buffer++ = (char) pgm_read_byte(table + (byte & 0x0f));
+    }
+#endif /* not ENCODING_HEX_PAIR_TABLE */
+
+  *buffer = '\0';
+
+  return buffer;
+}
+
+char *
+Encoding::base64_encode(char *buffer, const uint8_t *data, size_t data_len)
+{
+  return base64_encode(buffer, data, data_len, base64_table, true);
+}
+
+char *
+Encoding::base64url_encode(char *buffer, const uint8_t *data,
+                           size_t data_len)
+{
+  return base64_encode(buffer, data, data_len, base64url_table, false);
+}
+
+char *
+Encoding::base64_encode(char *buffer, const uint8_t *data, size_t data_len,
+                        const prog_char table[], bool pad)
+{
+  uint8_t a, b, c;
+
+  /* Encode full groups of 3 bytes into 4 symbols.  The 6-bit symbols
+     are extracted with 8-bit operations; this avoids the 32-bit
+     shifts that are expensive on AVR. */
+  for (; data_len >= 3; data_len -= 3, data += 3, buffer += 4)
+    {
+      a = data[0];
+      b = data[1];
+      c = data[2];
+
+      buffer[0] = (char) pgm_read_byte(table + (a >> 2));
+      buffer[1] = (char) pgm_read_byte(table + (((a & 0x03) << 4) | (b >> 4)));
+      buffer[2] = (char) pgm_read_byte(table + (((b & 0x0f) << 2) | (c >> 6)));
+      buffer[3] = (char) pgm_read_byte(table + (c & 0x3f));
+    }
+
+  /* The final partial group. */
+  if (data_len > 0)
+    {
+      a = data[0];
+      b = data_len > 1 ? data[1] : 0;
+
+      *buffer++ = (char) pgm_read_byte(table + (a >> 2));
+      *buffer++ = (char) pgm_read_byte(table + (((a & 0x03) << 4) | (b >> 4)));
+
+      if (data_len > 1)
+        *buffer++ = (char) pgm_read_byte(table + ((b & 0x0f) << 2));
+      else if (pad)
+        *buffer++ = '=';
+
+      if (pad)
+        *buffer++ = '=';
+    }
+
+  *buffer = '\0';
+
+  return buffer;
+}
+
+void
+Encoding::hex_print(Print *out, const uint8_t *data, size_t data_len,
+                    bool upper)
+{
+  char buf[ENCODING_HEX_LENGTH(16) + 1];
+  size_t len;
+
+  for (; data_len > 0; data_len -= len, data += len)
+    {
+      len = data_len < 16 ? data_len : 16;
+
+      hex_encode(buf, data, len, upper);
+      out->write((const uint8_t *) buf, ENCODING_HEX_LENGTH(len));
+    }
+}
@@ -0,0 +1,89 @@
+/* -*- c++ -*-
+ *
+ * Encoding.h
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include <avr/pgmspace.h>
+
+/* Define ENCODING_HEX_PAIR_TABLE to encode hex from a table of the
+   256 digit pairs.  It takes 1024 bytes of program memory instead of
+   32 bytes but reads one table word per input byte instead of two
+   table bytes. */
+
+/* The lengths of the encoded values of `len' bytes, without the
+   terminating null character. */
+#define ENCODING_HEX_LENGTH(len)	((len) * 2)
+#define ENCODING_BASE64_LENGTH(len)	(((len) + 2) / 3 * 4)
+#define ENCODING_BASE64URL_LENGTH(len)	(((len) * 4 + 2) / 3)
+
+/* Binary-to-text encoders.  The encoders write the encoded value and
+   a terminating null character into the buffer `buffer' that must
+   have space for them, and return a pointer to the null
+   character. */
+class Encoding
+{
+public:
+
+  /* Hex encode `data', `data_len' with lowercase digits. */
+  static char *hex_encode(char *buffer, const uint8_t *data,
+                          size_t data_len);
+
+  /* Hex encode `data', `data_len' with uppercase digits. */
+  static char *hex_encode_upper(char *buffer, const uint8_t *data,
+                                size_t data_len);
+
+  /* Base64 encode `data', `data_len' with the standard alphabet and
+     `=' padding. */
+  static char *base64_encode(char *buffer, const uint8_t *data,
+                             size_t data_len);
+
+  /* Base64 encode `data', `data_len' with the URL and filename safe
+     alphabet and without padding. */
+  static char *base64url_encode(char *buffer, const uint8_t *data,
+                                size_t data_len);
+
+  /* Print `data', `data_len' hex encoded to the output stream `out'.
+     The argument `upper' selects the uppercase digits.  The data is
+     encoded in pieces through a small stack buffer. */
+  static void hex_print(Print *out, const uint8_t *data, size_t data_len,
+                        bool upper);
+
+private:
+
+  static char *hex_encode(char *buffer, const uint8_t *data, size_t data_len,
+                          bool upper);
+
+  static char *base64_encode(char *buffer, const uint8_t *data,
+                             size_t data_len, const prog_char table[],
+                             bool pad);
+};
+
+#endif /* not ENCODING_H */
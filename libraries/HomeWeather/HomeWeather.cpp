@@ -39,12 +39,9 @@ void
 HomeWeather::print_data(int indent, const prog_char label[],
                         uint8_t *data, size_t datalen)
 {
-  int i;
-
   print_label(indent, label);
 
-  for (i = 0; i < datalen; i++)
-    Serial.print(data[i], HEX);
+  Encoding::hex_print(&Serial, data, datalen, true);
 
   newline();
 }
@@ -88,7 +85,7 @@ HomeWeather::println(const prog_char str[])
 }
 
 void
-HomeWeather::print(Client *client, const prog_char str[])
+HomeWeather::print(Print *client, const prog_char str[])
 {
   int i;
   uint8_t c;
@@ -101,7 +98,7 @@ HomeWeather::print(Client *client, const prog_char str[])
 }
 
 void
-HomeWeather::println(Client *client, const prog_char str[])
+HomeWeather::println(Print *client, const prog_char str[])
 {
   print(client, str);
   newline(client);
@@ -115,7 +112,7 @@ HomeWeather::newline(void)
 }
 
 void
-HomeWeather::newline(Client *client)
+HomeWeather::newline(Print *client)
 {
   client->write('\r');
   client->write('\n');
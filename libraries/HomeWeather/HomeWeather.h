@@ -30,6 +30,7 @@
 
 #include <Ethernet.h>
 #include <avr/pgmspace.h>
+#include <Encoding.h>
 
 #define MSG_CLIENT_ID		0
 #define MSG_SEQNUM		1
@@ -57,11 +58,11 @@ public:
 
   static void println(const prog_char str[]);
 
-  static void print(Client *client, const prog_char str[]);
+  static void print(Print *client, const prog_char str[]);
 
-  static void println(Client *client, const prog_char str[]);
+  static void println(Print *client, const prog_char str[]);
 
   static void newline(void);
 
-  static void newline(Client *client);
+  static void newline(Print *client);
 };
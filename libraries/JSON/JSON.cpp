@@ -78,9 +78,6 @@ JSON::add(const prog_char key[], const char *value)
 bool
 JSON::add(const prog_char key[], const uint8_t *data, size_t data_len)
 {
-  size_t i;
-  char buf[4];
-
   if (!is_object())
     return false;
 
@@ -90,12 +87,13 @@ JSON::add(const prog_char key[], const uint8_t *data, size_t data_len)
   if (!append("\"") || !append_progstr(key) || !append("\":\""))
     return false;
 
-  for (i = 0; i < data_len; i++)
-    {
-      snprintf(buf, sizeof(buf), "%02x", data[i]);
-      if (!append(buf))
-        return false;
-    }
+  /* The encoder writes a terminating null character after the
+     digits. */
+  if (buffer_pos + ENCODING_HEX_LENGTH(data_len) + 1 > buffer_len)
+    return false;
+
+  Encoding::hex_encode(buffer + buffer_pos, data, data_len);
+  buffer_pos += ENCODING_HEX_LENGTH(data_len);
 
   return append("\"");
 }
@@ -146,7 +144,7 @@ JSON::finish(void)
       return 0;
 
   if (!append("x"))
-    return false;
+    return 0;
 
   buffer[buffer_pos - 1] = '\0';
 
@@ -32,6 +32,7 @@
 #endif
 
 #include <avr/pgmspace.h>
+#include <Encoding.h>
 
 #define JSON_STACK_SIZE 8
 
@@ -0,0 +1,421 @@
+/*
+ * JSONParser.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "JSONParser.h"
+
+/* Parser states. */
+#define PS_VALUE	0	/* Expecting a value. */
+#define PS_ARRAY_FIRST	1	/* Expecting a value or `]'. */
+#define PS_KEY_FIRST	2	/* Expecting a key or `}'. */
+#define PS_KEY		3	/* Expecting a key. */
+#define PS_COLON	4	/* Expecting `:'. */
+#define PS_AFTER	5	/* Expecting `,' or the container end. */
+#define PS_STRING	6	/* In a string. */
+#define PS_ESCAPE	7	/* After `\' in a string. */
+#define PS_UNICODE	8	/* In a `\uXXXX' escape. */
+#define PS_LITERAL	9	/* In a number or literal. */
+#define PS_DONE		10	/* After the document. */
+#define PS_ERROR	11	/* The document is not valid. */
+
+JSONParser::JSONParser(char *buffer, size_t buffer_len)
+  : buffer(buffer),
+    buffer_len(buffer_len),
+    paths(0),
+    num_paths(0),
+    callback(0),
+    context(0)
+{
+  reset();
+}
+
+void
+JSONParser::set_paths(const prog_char *const *paths, uint8_t num_paths,
+                      void (*callback)(void *context, uint8_t path,
+                                       const char *value),
+                      void *context)
+{
+  this->paths = paths;
+  this->num_paths = num_paths;
+  this->callback = callback;
+  this->context = context;
+}
+
+void
+JSONParser::reset(void)
+{
+  state = PS_VALUE;
+  key = false;
+  depth = 0;
+  arrays = 0;
+  path_len = 0;
+  pos = 0;
+
+  if (buffer_len > 0)
+    buffer[0] = '\0';
+}
+
+bool
+JSONParser::feed(uint8_t byte)
+{
+  char ch = byte;
+
+  switch (state)
+    {
+    case PS_STRING:
+      if (ch == '"')
+        {
+          if (key)
+            {
+              end_key();
+              state = PS_COLON;
+            }
+          else
+            {
+              end_value();
+              after_value();
+            }
+        }
+      else if (ch == '\\')
+        state = PS_ESCAPE;
+      else if (byte < 0x20)
+        state = PS_ERROR;
+      else
+        put(ch);
+      return state != PS_ERROR;
+
+    case PS_ESCAPE:
+      state = PS_STRING;
+      switch (ch)
+        {
+        case '"':
+        case '\\':
+        case '/':
+          put(ch);
+          break;
+
+        case 'b':
+          put('\b');
+          break;
+
+        case 'f':
+          put('\f');
+          break;
+
+        case 'n':
+          put('\n');
+          break;
+
+        case 'r':
+          put('\r');
+          break;
+
+        case 't':
+          put('\t');
+          break;
+
+        case 'u':
+          unicode = 0;
+          unicode_digits = 0;
+          state = PS_UNICODE;
+          break;
+
+        default:
+          state = PS_ERROR;
+          break;
+        }
+      return state != PS_ERROR;
+
+    case PS_UNICODE:
+      if (!isxdigit(ch))
+        {
+          state = PS_ERROR;
+          return false;
+        }
+
+      unicode <<= 4;
+      unicode |= isdigit(ch) ? ch - '0' : (ch | 0x20) - 'a' + 10;
+
+      if (++unicode_digits < 4)
+        return true;
+
+      /* UTF-8 encode the character.  The halves of a surrogate pair
+         are encoded separately. */
+      if (unicode < 0x80)
+        {
+          put(unicode);
+        }
+      else if (unicode < 0x800)
+        {
+          put(0xc0 | (unicode >> 6));
+          put(0x80 | (unicode & 0x3f));
+        }
+      else
+        {
+          put(0xe0 | (unicode >> 12));
+          put(0x80 | ((unicode >> 6) & 0x3f));
+          put(0x80 | (unicode & 0x3f));
+        }
+
+      state = PS_STRING;
+      return true;
+
+    case PS_LITERAL:
+      if (isalnum(ch) || ch == '.' || ch == '+' || ch == '-')
+        {
+          put(ch);
+          return true;
+        }
+
+      /* The byte after the literal ends it.  Process the byte again in
+         the new state. */
+      end_value();
+      after_value();
+      return feed(byte);
+
+    default:
+      break;
+    }
+
+  /* The structural states skip whitespace. */
+  if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
+    return state != PS_ERROR;
+
+  switch (state)
+    {
+    case PS_ARRAY_FIRST:
+      if (ch == ']')
+        {
+          if (!pop(ch))
+            state = PS_ERROR;
+          break;
+        }
+      /* FALLTHROUGH */
+
+    case PS_VALUE:
+      if (ch == '{')
+        state = push(false) ? PS_KEY_FIRST : PS_ERROR;
+      else if (ch == '[')
+        state = push(true) ? PS_ARRAY_FIRST : PS_ERROR;
+      else if (ch == '"')
+        start_string(false);
+      else if (isalnum(ch) || ch == '-')
+        {
+          start_string(false);
+          put(ch);
+          state = PS_LITERAL;
+        }
+      else
+        state = PS_ERROR;
+      break;
+
+    case PS_KEY_FIRST:
+      if (ch == '}')
+        {
+          if (!pop(ch))
+            state = PS_ERROR;
+          break;
+        }
+      /* FALLTHROUGH */
+
+    case PS_KEY:
+      if (ch == '"')
+        start_string(true);
+      else
+        state = PS_ERROR;
+      break;
+
+    case PS_COLON:
+      state = ch == ':' ? PS_VALUE : PS_ERROR;
+      break;
+
+    case PS_AFTER:
+      if (ch == ',')
+        state = in_array() ? PS_VALUE : PS_KEY;
+      else if ((ch != '}' && ch != ']') || !pop(ch))
+        state = PS_ERROR;
+      break;
+
+    default:
+      /* Only whitespace can follow the document. */
+      state = PS_ERROR;
+      break;
+    }
+
+  return state != PS_ERROR;
+}
+
+bool
+JSONParser::is_done(void)
+{
+  return state == PS_DONE;
+}
+
+bool
+JSONParser::is_error(void)
+{
+  return state == PS_ERROR;
+}
+
+void
+JSONParser::start_string(bool key)
+{
+  this->key = key;
+  state = PS_STRING;
+
+  /* Strings of the untracked levels and under a lost key path are
+     not stored. */
+  if (!tracked() || path_len >= buffer_len)
+    {
+      pos = buffer_len;
+      return;
+    }
+
+  if (key)
+    {
+      pos = path_len;
+      if (path_len > 0)
+        put('.');
+    }
+  else
+    {
+      /* The value follows the key path and its null character. */
+      pos = path_len + 1;
+    }
+}
+
+void
+JSONParser::put(char ch)
+{
+  /* Keep room for the null character, and for keys also for the
+     null character of the value that follows.  A string that does not
+     fit is dropped. */
+  if (pos + (key ? 2 : 1) < buffer_len)
+    buffer[pos++] = ch;
+  else
+    pos = buffer_len;
+}
+
+void
+JSONParser::end_key(void)
+{
+  if (!tracked() || path_len >= buffer_len)
+    return;
+
+  /* A key that did not fit loses the key path until the value
+     ends. */
+  path_len = pos;
+  if (path_len < buffer_len)
+    buffer[path_len] = '\0';
+}
+
+void
+JSONParser::end_value(void)
+{
+  uint8_t i;
+
+  if (!tracked() || pos >= buffer_len || callback == 0)
+    return;
+
+  buffer[pos] = '\0';
+
+  for (i = 0; i < num_paths; i++)
+    if (strcmp_P(buffer, paths[i]) == 0)
+      callback(context, i, buffer + path_len + 1);
+}
+
+bool
+JSONParser::push(bool array)
+{
+  if (depth >= JSON_PARSER_MAX_DEPTH)
+    return false;
+
+  depth++;
+  arrays = (arrays << 1) | (array ? 1 : 0);
+
+  if (tracked())
+    {
+      if (array && path_len < buffer_len)
+        {
+          if (path_len + 3 < buffer_len)
+            {
+              buffer[path_len++] = '[';
+              buffer[path_len++] = ']';
+              buffer[path_len] = '\0';
+            }
+          else
+            {
+              path_len = buffer_len;
+            }
+        }
+
+      bases[depth - 1] = path_len;
+    }
+
+  return true;
+}
+
+bool
+JSONParser::pop(char ch)
+{
+  if (depth == 0 || (ch == ']') != in_array())
+    return false;
+
+  depth--;
+  arrays >>= 1;
+
+  after_value();
+
+  return true;
+}
+
+bool
+JSONParser::in_array(void)
+{
+  return depth > 0 && (arrays & 1);
+}
+
+bool
+JSONParser::tracked(void)
+{
+  return depth <= JSON_PARSER_STACK_SIZE;
+}
+
+void
+JSONParser::after_value(void)
+{
+  if (depth == 0)
+    {
+      state = PS_DONE;
+      return;
+    }
+
+  state = PS_AFTER;
+
+  /* Drop the key of the value from the key path. */
+  if (tracked())
+    {
+      path_len = bases[depth - 1];
+      if (path_len < buffer_len)
+        buffer[path_len] = '\0';
+    }
+}
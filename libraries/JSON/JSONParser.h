@@ -0,0 +1,158 @@
+/* -*- c++ -*-
+ *
+ * JSONParser.h
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef JSONPARSER_H
+#define JSONPARSER_H
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include <avr/pgmspace.h>
+
+/* The number of nesting levels whose key paths are tracked.  Values
+   below this depth are parsed but never reported. */
+#define JSON_PARSER_STACK_SIZE 8
+
+/* The maximum nesting depth of the parsed documents. */
+#define JSON_PARSER_MAX_DEPTH 32
+
+/* A push-based JSON parser.  The document is fed to the parser a byte
+   at a time as it arrives, and the parser calls a callback for the
+   scalar values whose key paths have been selected.  The parser
+   never holds more than the current key path and value so documents
+   of any size can be parsed with a small buffer.
+
+   The key path of a value is its object keys separated by `.', with
+   `[]' for an array level, e.g. `id_str', `user.screen_name' or
+   `errors[].code'.  String values are reported unescaped, and number,
+   `true', `false' and `null' values as they appear in the document.
+   The parser checks the document structure but not the syntax of the
+   number and literal values. */
+class JSONParser
+{
+public:
+
+  /* Constructs a new parser with the work buffer `buffer',
+     `buffer_len'.  The buffer holds the current key path and value.
+     The values that do not fit in the space left after their key
+     path are not reported. */
+  JSONParser(char *buffer, size_t buffer_len);
+
+  /* Select the key paths to report.  The array `paths' of
+     `num_paths' program memory strings must remain valid while the
+     parser is used.  The function `callback' is called with the
+     argument `context', the index of the matching path in `paths',
+     and the value. */
+  void set_paths(const prog_char *const *paths, uint8_t num_paths,
+                 void (*callback)(void *context, uint8_t path,
+                                  const char *value),
+                 void *context);
+
+  /* Reset the parser for a new document. */
+  void reset(void);
+
+  /* Feed the document byte `byte' to the parser.  The method returns
+     false if the document is not valid JSON and true otherwise. */
+  bool feed(uint8_t byte);
+
+  /* Tests if a complete document has been parsed. */
+  bool is_done(void);
+
+  /* Tests if the document was not valid JSON. */
+  bool is_error(void);
+
+private:
+
+  /* Start a string value or key. */
+  void start_string(bool key);
+
+  /* Store the character `ch' of the current string, number or
+     literal. */
+  void put(char ch);
+
+  /* Finish the current key.  The key is appended to the key path. */
+  void end_key(void);
+
+  /* Finish the current value and report it if its key path has been
+     selected. */
+  void end_value(void);
+
+  /* Enter a new object or array.  The method returns false if the
+     document is nested too deep. */
+  bool push(bool array);
+
+  /* Leave the current object or array that is closed with `ch'.  The
+     method returns false if `ch' does not match the container. */
+  bool pop(char ch);
+
+  /* Tests if the current container is an array. */
+  bool in_array(void);
+
+  /* Tests if the key path of the current level is tracked. */
+  bool tracked(void);
+
+  /* Set the parser state after a complete value. */
+  void after_value(void);
+
+  /* Work buffer for the key path and the value. */
+  char *buffer;
+  size_t buffer_len;
+
+  /* The length of the current key path in `buffer'. */
+  size_t path_len;
+
+  /* The write position of the current string or literal in
+     `buffer'. */
+  size_t pos;
+
+  /* Parser state. */
+  uint8_t state;
+
+  /* Is the current string a key? */
+  bool key;
+
+  /* Current nesting depth and a bitmap of the containers that are
+     arrays, the innermost in the lowest bit. */
+  uint8_t depth;
+  uint32_t arrays;
+
+  /* The key path lengths of the tracked containers. */
+  uint16_t bases[JSON_PARSER_STACK_SIZE];
+
+  /* The value of the `\uXXXX' escape being parsed and the number of
+     its digits seen. */
+  uint16_t unicode;
+  uint8_t unicode_digits;
+
+  /* The selected key paths and their callback. */
+  const prog_char *const *paths;
+  uint8_t num_paths;
+  void (*callback)(void *context, uint8_t path, const char *value);
+  void *context;
+};
+
+#endif /* not JSONPARSER_H */
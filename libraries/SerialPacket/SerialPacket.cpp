@@ -58,6 +58,7 @@ SerialPacket::send(uint8_t *data, size_t data_len)
 
   /* Trailer. */
   serial->write(SP_SEP);
+  serial->write(SP_TRL);
 
   /* CRC. */
   serial->write((crc >> 24) & 0xff);
@@ -0,0 +1,108 @@
+#include "sha1.h"
+#include "sha256.h"
+
+// Known answer tests of SHA-1, SHA-256 and their HMACs linked into
+// the same sketch.  Each test prints `ok' or `FAIL' with the result.
+
+const char abc[] = "abc";
+const char twoBlocks[] =
+  "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+const char jefeText[] = "what do ya want for nothing?";
+const char longKeyText[] =
+  "Test Using Larger Than Block-Size Key - Hash Key First";
+
+uint8_t longKey[131];
+int failures;
+
+void check(const char* name, uint8_t* hash, uint8_t length,
+           const char* expect) {
+  char hex[2*SHA_MAX_HASH_LENGTH+1];
+  uint8_t i;
+  for (i=0; i<length; i++) {
+    hex[2*i] = "0123456789abcdef"[hash[i]>>4];
+    hex[2*i+1] = "0123456789abcdef"[hash[i]&0xf];
+  }
+  hex[2*i] = 0;
+  if (strcmp(hex,expect) == 0) {
+    Serial.print("ok   ");
+  } else {
+    Serial.print("FAIL ");
+    failures++;
+  }
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.println(hex);
+}
+
+void checkHash(ShaBase& sha, const char* name, uint8_t length,
+               const char* text, const char* expect) {
+  sha.init();
+  sha.print(text);
+  check(name,sha.result(),length,expect);
+}
+
+void checkHmac(ShaBase& sha, const char* name, uint8_t length,
+               const uint8_t* key, int keyLength, const char* text,
+               const char* expect) {
+  sha.initHmac(key,keyLength);
+  sha.print(text);
+  check(name,sha.resultHmac(),length,expect);
+}
+
+void setup() {
+  Sha1Class sha1;
+  Sha256Class sha256;
+
+  Serial.begin(9600);
+  memset(longKey,0xaa,sizeof(longKey));
+
+  // FIPS 180-2 C.1, C.2, B.1 and B.2
+  checkHash(sha1,"SHA-1 abc",SHA1_HASH_LENGTH,abc,
+            "a9993e364706816aba3e25717850c26c9cd0d89d");
+  checkHash(sha1,"SHA-1 two blocks",SHA1_HASH_LENGTH,twoBlocks,
+            "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+  checkHash(sha256,"SHA-256 abc",SHA256_HASH_LENGTH,abc,
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  checkHash(sha256,"SHA-256 two blocks",SHA256_HASH_LENGTH,twoBlocks,
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+  // RFC 2202 2 and 6, RFC 4231 4.3 and 4.7
+  checkHmac(sha1,"HMAC-SHA-1 Jefe",SHA1_HASH_LENGTH,
+            (const uint8_t*)"Jefe",4,jefeText,
+            "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79");
+  checkHmac(sha1,"HMAC-SHA-1 long key",SHA1_HASH_LENGTH,longKey,80,
+            longKeyText,"aa4ae5e15272d00e95705637ce8a3b55ed402112");
+  checkHmac(sha256,"HMAC-SHA-256 Jefe",SHA256_HASH_LENGTH,
+            (const uint8_t*)"Jefe",4,jefeText,
+            "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+  checkHmac(sha256,"HMAC-SHA-256 long key",SHA256_HASH_LENGTH,longKey,131,
+            longKeyText,
+            "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+
+  // Both HMACs in flight at the same time
+  sha1.initHmac((const uint8_t*)"Jefe",4);
+  sha256.initHmac((const uint8_t*)"Jefe",4);
+  for (const char* cp=jefeText; *cp; cp++) {
+    sha1.write(*cp);
+    sha256.write(*cp);
+  }
+  check("interleaved HMAC-SHA-1",sha1.resultHmac(),SHA1_HASH_LENGTH,
+        "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79");
+  check("interleaved HMAC-SHA-256",sha256.resultHmac(),SHA256_HASH_LENGTH,
+        "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+
+  // A copy forks the hash: the original is not affected
+  sha256.init();
+  sha256.print("ab");
+  Sha256Class fork = sha256;
+  fork.print("x");
+  sha256.print("c");
+  check("forked SHA-256 abc",sha256.result(),SHA256_HASH_LENGTH,
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+  Serial.print(failures);
+  Serial.println(" failures");
+}
+
+void loop() {
+}
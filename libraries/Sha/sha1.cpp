@@ -1,10 +1,7 @@
 #include <string.h>
-#include <avr/io.h>
 #include <avr/pgmspace.h>
 #include "sha1.h"
 
-#include "debugstuff.c"
-
 #define SHA1_K0 0x5a827999
 #define SHA1_K20 0x6ed9eba1
 #define SHA1_K40 0x8f1bbcdc
@@ -18,47 +15,47 @@ uint8_t sha1InitState[] PROGMEM = {
   0xf0,0xe1,0xd2,0xc3  // H4
 };
 
-void Sha1Class::init(void) {
-  memcpy_P(state.b,sha1InitState,HASH_LENGTH);
-  byteCount = 0;
-  bufferOffset = 0;
+Sha1Class::Sha1Class()
+  : ShaBase(sha1InitState,SHA1_HASH_LENGTH) {
 }
 
-uint32_t Sha1Class::rol32(uint32_t number, uint8_t bits) {
+static inline uint32_t rol32(uint32_t number, uint8_t bits) {
   return ((number << bits) | (number >> (32-bits)));
 }
 
+// Round functions and the in-place message schedule of the 16 word
+// block buffer `w'
+#define SHA1_F0(b,c,d) ((d) ^ ((b) & ((c) ^ (d))))
+#define SHA1_F1(b,c,d) ((b) ^ (c) ^ (d))
+#define SHA1_F2(b,c,d) (((b) & (c)) | ((d) & ((b) | (c))))
+#define SHA1_F3(b,c,d) SHA1_F1(b,c,d)
+
+#define SHA1_SCHEDULE(i) (w[(i)&15] = rol32(w[((i)+13)&15] ^ \
+  w[((i)+8)&15] ^ w[((i)+2)&15] ^ w[(i)&15],1))
+
+#if defined(__AVR__)
+
+// One round per loop iteration and one loop per round function keeps
+// the code small; a full unroll would not fit the flash.
+#define SHA1_STEP(f,k,wi) \
+  t = rol32(a,5) + f(b,c,d) + e + (k) + (wi); \
+  e = d; d = c; c = rol32(b,30); b = a; a = t
+
 void Sha1Class::hashBlock() {
-  // SHA1 only for now
   uint8_t i;
   uint32_t a,b,c,d,e,t;
+  uint32_t* w = buffer.w;
 
   a=state.w[0];
   b=state.w[1];
   c=state.w[2];
   d=state.w[3];
   e=state.w[4];
-  for (i=0; i<80; i++) {
-    if (i>=16) {
-      t = buffer.w[(i+13)&15] ^ buffer.w[(i+8)&15] ^ buffer.w[(i+2)&15] ^ buffer.w[i&15];
-      buffer.w[i&15] = rol32(t,1);
-    }
-    if (i<20) {
-      t = (d ^ (b & (c ^ d))) + SHA1_K0;
-    } else if (i<40) {
-      t = (b ^ c ^ d) + SHA1_K20;
-    } else if (i<60) {
-      t = ((b & c) | (d & (b | c))) + SHA1_K40;
-    } else {
-      t = (b ^ c ^ d) + SHA1_K60;
-    }
-    t+=rol32(a,5) + e + buffer.w[i&15];
-    e=d;
-    d=c;
-    c=rol32(b,30);
-    b=a;
-    a=t;
-  }
+  for (i=0; i<16; i++) { SHA1_STEP(SHA1_F0,SHA1_K0,w[i]); }
+  for (; i<20; i++) { SHA1_STEP(SHA1_F0,SHA1_K0,SHA1_SCHEDULE(i)); }
+  for (; i<40; i++) { SHA1_STEP(SHA1_F1,SHA1_K20,SHA1_SCHEDULE(i)); }
+  for (; i<60; i++) { SHA1_STEP(SHA1_F2,SHA1_K40,SHA1_SCHEDULE(i)); }
+  for (; i<80; i++) { SHA1_STEP(SHA1_F3,SHA1_K60,SHA1_SCHEDULE(i)); }
   state.w[0] += a;
   state.w[1] += b;
   state.w[2] += c;
@@ -66,95 +63,248 @@ void Sha1Class::hashBlock() {
   state.w[4] += e;
 }
 
-void Sha1Class::addUncounted(uint8_t data) {
-  buffer.b[bufferOffset ^ 3] = data;
-  bufferOffset++;
-  if (bufferOffset == BLOCK_LENGTH) {
-    hashBlock();
-    bufferOffset = 0;
-  }
-}
+#else /* not __AVR__ */
 
-size_t Sha1Class::write(uint8_t data) {
-  ++byteCount;
-  addUncounted(data);
-  return 1;
-}
+// Fully unrolled.  The variables rotate through the argument
+// positions so no round moves them, and the round functions and
+// message word indexes are constants.
+#define SHA1_W(i) ((i) < 16 ? w[(i)&15] : SHA1_SCHEDULE(i))
 
-void Sha1Class::pad() {
-  // Implement SHA-1 padding (fips180-2 §5.1.1)
-
-  // Pad with 0x80 followed by 0x00 until the end of the block
-  addUncounted(0x80);
-  while (bufferOffset != 56) addUncounted(0x00);
-
-  // Append length in the last 8 bytes
-  addUncounted(0); // We're only using 32 bit lengths
-  addUncounted(0); // But SHA-1 supports 64 bit lengths
-  addUncounted(0); // So zero pad the top bits
-  addUncounted(byteCount >> 29); // Shifting to multiply by 8
-  addUncounted(byteCount >> 21); // as SHA-1 supports bitstreams as well as
-  addUncounted(byteCount >> 13); // byte.
-  addUncounted(byteCount >> 5);
-  addUncounted(byteCount << 3);
-}
+#define SHA1_ROUND(a,b,c,d,e,f,k,i) \
+  e += rol32(a,5) + f(b,c,d) + (k) + SHA1_W(i); b = rol32(b,30)
 
+#define SHA1_ROUND5(f,k,i) \
+  SHA1_ROUND(a,b,c,d,e,f,k,(i)); \
+  SHA1_ROUND(e,a,b,c,d,f,k,(i)+1); \
+  SHA1_ROUND(d,e,a,b,c,f,k,(i)+2); \
+  SHA1_ROUND(c,d,e,a,b,f,k,(i)+3); \
+  SHA1_ROUND(b,c,d,e,a,f,k,(i)+4)
 
-uint8_t* Sha1Class::result(void) {
-  // Pad to complete the last block
-  pad();
+#define SHA1_ROUND20(f,k,i) \
+  SHA1_ROUND5(f,k,(i)); \
+  SHA1_ROUND5(f,k,(i)+5); \
+  SHA1_ROUND5(f,k,(i)+10); \
+  SHA1_ROUND5(f,k,(i)+15)
 
-  // Swap byte order back
-  for (int i=0; i<5; i++) {
-    uint32_t a,b;
-    a=state.w[i];
-    b=a<<24;
-    b|=(a<<8) & 0x00ff0000;
-    b|=(a>>8) & 0x0000ff00;
-    b|=a>>24;
-    state.w[i]=b;
-  }
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+  && !defined(SHA1_NO_SHA_NI)
+#define SHA1_SHA_NI
+#include <cpuid.h>
+#include <immintrin.h>
 
-  // Return pointer to hash (20 characters)
-  return state.b;
-}
+// Hash the block `w' into `state' with the x86 SHA extensions
+__attribute__((target("sha,sse4.1")))
+static void sha1ShaNi(uint32_t* state, const uint32_t* w) {
+  __m128i ABCD, ABCD_SAVE, E0, E0_SAVE, E1;
+  __m128i MSG0, MSG1, MSG2, MSG3;
 
+  // A is in the highest lane
+  ABCD = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state),0x1b);
+  E0 = _mm_set_epi32(state[4],0,0,0);
+  ABCD_SAVE = ABCD;
+  E0_SAVE = E0;
 
-#define HMAC_IPAD 0x36
-#define HMAC_OPAD 0x5c
+  // Rounds 0-3
+  MSG0 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(w+0)),0x1b);
+  E0 = _mm_add_epi32(E0,MSG0);
+  E1 = ABCD;
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E0,0);
 
+  // Rounds 4-7
+  MSG1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(w+4)),0x1b);
+  E1 = _mm_sha1nexte_epu32(E1,MSG1);
+  E0 = ABCD;
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E1,0);
+  MSG0 = _mm_sha1msg1_epu32(MSG0,MSG1);
 
+  // Rounds 8-11
+  MSG2 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(w+8)),0x1b);
+  E0 = _mm_sha1nexte_epu32(E0,MSG2);
+  E1 = ABCD;
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E0,0);
+  MSG1 = _mm_sha1msg1_epu32(MSG1,MSG2);
+  MSG0 = _mm_xor_si128(MSG0,MSG2);
 
-void Sha1Class::initHmac(const uint8_t* key, int keyLength) {
-  uint8_t i;
-  memset(keyBuffer,0,BLOCK_LENGTH);
-  if (keyLength > BLOCK_LENGTH) {
-    // Hash long keys
-    init();
-    for (;keyLength--;) write(*key++);
-    memcpy(keyBuffer,result(),HASH_LENGTH);
-  } else {
-    // Block length keys are used as is
-    memcpy(keyBuffer,key,keyLength);
-  }
-  //for (i=0; i<BLOCK_LENGTH; i++) debugHH(keyBuffer[i]);
-  // Start inner hash
-  init();
-  for (i=0; i<BLOCK_LENGTH; i++) {
-    write(keyBuffer[i] ^ HMAC_IPAD);
+  // Rounds 12-15
+  MSG3 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(w+12)),0x1b);
+  E1 = _mm_sha1nexte_epu32(E1,MSG3);
+  E0 = ABCD;
+  MSG0 = _mm_sha1msg2_epu32(MSG0,MSG3);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E1,0);
+  MSG2 = _mm_sha1msg1_epu32(MSG2,MSG3);
+  MSG1 = _mm_xor_si128(MSG1,MSG3);
+
+  // Rounds 16-19
+  E0 = _mm_sha1nexte_epu32(E0,MSG0);
+  E1 = ABCD;
+  MSG1 = _mm_sha1msg2_epu32(MSG1,MSG0);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E0,0);
+  MSG3 = _mm_sha1msg1_epu32(MSG3,MSG0);
+  MSG2 = _mm_xor_si128(MSG2,MSG0);
+
+  // Rounds 20-23
+  E1 = _mm_sha1nexte_epu32(E1,MSG1);
+  E0 = ABCD;
+  MSG2 = _mm_sha1msg2_epu32(MSG2,MSG1);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E1,1);
+  MSG0 = _mm_sha1msg1_epu32(MSG0,MSG1);
+  MSG3 = _mm_xor_si128(MSG3,MSG1);
+
+  // Rounds 24-27
+  E0 = _mm_sha1nexte_epu32(E0,MSG2);
+  E1 = ABCD;
+  MSG3 = _mm_sha1msg2_epu32(MSG3,MSG2);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E0,1);
+  MSG1 = _mm_sha1msg1_epu32(MSG1,MSG2);
+  MSG0 = _mm_xor_si128(MSG0,MSG2);
+
+  // Rounds 28-31
+  E1 = _mm_sha1nexte_epu32(E1,MSG3);
+  E0 = ABCD;
+  MSG0 = _mm_sha1msg2_epu32(MSG0,MSG3);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E1,1);
+  MSG2 = _mm_sha1msg1_epu32(MSG2,MSG3);
+  MSG1 = _mm_xor_si128(MSG1,MSG3);
+
+  // Rounds 32-35
+  E0 = _mm_sha1nexte_epu32(E0,MSG0);
+  E1 = ABCD;
+  MSG1 = _mm_sha1msg2_epu32(MSG1,MSG0);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E0,1);
+  MSG3 = _mm_sha1msg1_epu32(MSG3,MSG0);
+  MSG2 = _mm_xor_si128(MSG2,MSG0);
+
+  // Rounds 36-39
+  E1 = _mm_sha1nexte_epu32(E1,MSG1);
+  E0 = ABCD;
+  MSG2 = _mm_sha1msg2_epu32(MSG2,MSG1);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E1,1);
+  MSG0 = _mm_sha1msg1_epu32(MSG0,MSG1);
+  MSG3 = _mm_xor_si128(MSG3,MSG1);
+
+  // Rounds 40-43
+  E0 = _mm_sha1nexte_epu32(E0,MSG2);
+  E1 = ABCD;
+  MSG3 = _mm_sha1msg2_epu32(MSG3,MSG2);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E0,2);
+  MSG1 = _mm_sha1msg1_epu32(MSG1,MSG2);
+  MSG0 = _mm_xor_si128(MSG0,MSG2);
+
+  // Rounds 44-47
+  E1 = _mm_sha1nexte_epu32(E1,MSG3);
+  E0 = ABCD;
+  MSG0 = _mm_sha1msg2_epu32(MSG0,MSG3);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E1,2);
+  MSG2 = _mm_sha1msg1_epu32(MSG2,MSG3);
+  MSG1 = _mm_xor_si128(MSG1,MSG3);
+
+  // Rounds 48-51
+  E0 = _mm_sha1nexte_epu32(E0,MSG0);
+  E1 = ABCD;
+  MSG1 = _mm_sha1msg2_epu32(MSG1,MSG0);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E0,2);
+  MSG3 = _mm_sha1msg1_epu32(MSG3,MSG0);
+  MSG2 = _mm_xor_si128(MSG2,MSG0);
+
+  // Rounds 52-55
+  E1 = _mm_sha1nexte_epu32(E1,MSG1);
+  E0 = ABCD;
+  MSG2 = _mm_sha1msg2_epu32(MSG2,MSG1);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E1,2);
+  MSG0 = _mm_sha1msg1_epu32(MSG0,MSG1);
+  MSG3 = _mm_xor_si128(MSG3,MSG1);
+
+  // Rounds 56-59
+  E0 = _mm_sha1nexte_epu32(E0,MSG2);
+  E1 = ABCD;
+  MSG3 = _mm_sha1msg2_epu32(MSG3,MSG2);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E0,2);
+  MSG1 = _mm_sha1msg1_epu32(MSG1,MSG2);
+  MSG0 = _mm_xor_si128(MSG0,MSG2);
+
+  // Rounds 60-63
+  E1 = _mm_sha1nexte_epu32(E1,MSG3);
+  E0 = ABCD;
+  MSG0 = _mm_sha1msg2_epu32(MSG0,MSG3);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E1,3);
+  MSG2 = _mm_sha1msg1_epu32(MSG2,MSG3);
+  MSG1 = _mm_xor_si128(MSG1,MSG3);
+
+  // Rounds 64-67
+  E0 = _mm_sha1nexte_epu32(E0,MSG0);
+  E1 = ABCD;
+  MSG1 = _mm_sha1msg2_epu32(MSG1,MSG0);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E0,3);
+  MSG3 = _mm_sha1msg1_epu32(MSG3,MSG0);
+  MSG2 = _mm_xor_si128(MSG2,MSG0);
+
+  // Rounds 68-71
+  E1 = _mm_sha1nexte_epu32(E1,MSG1);
+  E0 = ABCD;
+  MSG2 = _mm_sha1msg2_epu32(MSG2,MSG1);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E1,3);
+  MSG3 = _mm_xor_si128(MSG3,MSG1);
+
+  // Rounds 72-75
+  E0 = _mm_sha1nexte_epu32(E0,MSG2);
+  E1 = ABCD;
+  MSG3 = _mm_sha1msg2_epu32(MSG3,MSG2);
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E0,3);
+
+  // Rounds 76-79
+  E1 = _mm_sha1nexte_epu32(E1,MSG3);
+  E0 = ABCD;
+  ABCD = _mm_sha1rnds4_epu32(ABCD,E1,3);
+
+  E0 = _mm_sha1nexte_epu32(E0,E0_SAVE);
+  ABCD = _mm_add_epi32(ABCD,ABCD_SAVE);
+
+  _mm_storeu_si128((__m128i*)state,_mm_shuffle_epi32(ABCD,0x1b));
+  state[4] = _mm_extract_epi32(E0,3);
+}
+
+static bool sha1HaveShaNi(void) {
+  static int8_t have = -1;
+  unsigned int eax,ebx,ecx,edx;
+
+  if (have < 0) {
+    have = __get_cpuid_count(7,0,&eax,&ebx,&ecx,&edx) && (ebx & bit_SHA);
   }
+  return have;
 }
+#endif /* SHA1_SHA_NI */
 
-uint8_t* Sha1Class::resultHmac(void) {
-  uint8_t i;
-    // Complete inner hash
-  memcpy(innerHash,result(),HASH_LENGTH);
-  // now innerHash[] contains H((K0 xor ipad)||text)
-
-  // Calculate outer hash
-  init();
-  for (i=0; i<BLOCK_LENGTH; i++) write(keyBuffer[i] ^ HMAC_OPAD);
-  for (i=0; i<HASH_LENGTH; i++) write(innerHash[i]);
-  return result();
+void Sha1Class::hashBlock() {
+  uint32_t a,b,c,d,e;
+  // A local copy of the block does not alias the state so the
+  // compiler can keep it in registers
+  uint32_t w[SHA_BLOCK_LENGTH/4];
+
+#ifdef SHA1_SHA_NI
+  if (sha1HaveShaNi()) {
+    sha1ShaNi(state.w,buffer.w);
+    return;
+  }
+#endif
+
+  memcpy(w,buffer.w,sizeof(w));
+
+  a=state.w[0];
+  b=state.w[1];
+  c=state.w[2];
+  d=state.w[3];
+  e=state.w[4];
+  SHA1_ROUND20(SHA1_F0,SHA1_K0,0);
+  SHA1_ROUND20(SHA1_F1,SHA1_K20,20);
+  SHA1_ROUND20(SHA1_F2,SHA1_K40,40);
+  SHA1_ROUND20(SHA1_F3,SHA1_K60,60);
+  state.w[0] += a;
+  state.w[1] += b;
+  state.w[2] += c;
+  state.w[3] += d;
+  state.w[4] += e;
 }
+
+#endif /* not __AVR__ */
+
 Sha1Class Sha1;
@@ -1,9 +1,15 @@
 #include <string.h>
-#include <avr/io.h>
 #include <avr/pgmspace.h>
 #include "sha256.h"
 
-//#include "debugstuff.c"
+// The multi-buffer code hashes 4 lanes with SSE4.1 or 8 lanes with
+// AVX2 when the CPU has them.  Define SHA256_NO_SIMD to use only the
+// scalar code.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+  && !defined(SHA256_NO_SIMD)
+#define SHA256_SIMD
+#include <cpuid.h>
+#endif
 
 uint32_t sha256K[] PROGMEM = {
   0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
@@ -16,8 +22,6 @@ uint32_t sha256K[] PROGMEM = {
   0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
 };
 
-#define BUFFER_SIZE 64
-
 uint8_t sha256InitState[] PROGMEM = {
   0x67,0xe6,0x09,0x6a, // H0
   0x85,0xae,0x67,0xbb, // H1
@@ -29,148 +33,337 @@ uint8_t sha256InitState[] PROGMEM = {
   0x19,0xcd,0xe0,0x5b  // H7
 };
 
-void Sha256Class::init(void) {
-  memcpy_P(state.b,sha256InitState,32);
-  byteCount = 0;
-  bufferOffset = 0;
+Sha256Class::Sha256Class()
+  : ShaBase(sha256InitState,SHA256_HASH_LENGTH) {
 }
 
-uint32_t Sha256Class::ror32(uint32_t number, uint8_t bits) {
+static inline uint32_t ror32(uint32_t number, uint8_t bits) {
   return ((number << (32-bits)) | (number >> bits));
 }
 
-void Sha256Class::hashBlock() {
-  // Sha256 only for now
+// Hash the 16 word block `w' into `state'.  The block is used for
+// the message schedule.
+static void sha256Transform(uint32_t* state, uint32_t* w) {
   uint8_t i;
   uint32_t a,b,c,d,e,f,g,h,t1,t2;
 
-  a=state.w[0];
-  b=state.w[1];
-  c=state.w[2];
-  d=state.w[3];
-  e=state.w[4];
-  f=state.w[5];
-  g=state.w[6];
-  h=state.w[7];
+  a=state[0];
+  b=state[1];
+  c=state[2];
+  d=state[3];
+  e=state[4];
+  f=state[5];
+  g=state[6];
+  h=state[7];
 
   for (i=0; i<64; i++) {
     if (i>=16) {
-      t1 = buffer.w[i&15] + buffer.w[(i-7)&15];
-      t2 = buffer.w[(i-2)&15];
+      t1 = w[i&15] + w[(i-7)&15];
+      t2 = w[(i-2)&15];
       t1 += ror32(t2,17) ^ ror32(t2,19) ^ (t2>>10);
-      t2 = buffer.w[(i-15)&15];
+      t2 = w[(i-15)&15];
       t1 += ror32(t2,7) ^ ror32(t2,18) ^ (t2>>3);
-      buffer.w[i&15] = t1;
+      w[i&15] = t1;
     }
     t1 = h;
     t1 += ror32(e,6) ^ ror32(e,11) ^ ror32(e,25); // ∑1(e)
     t1 += g ^ (e & (g ^ f)); // Ch(e,f,g)
     t1 += pgm_read_dword(sha256K+i); // Ki
-    t1 += buffer.w[i&15]; // Wi
+    t1 += w[i&15]; // Wi
     t2 = ror32(a,2) ^ ror32(a,13) ^ ror32(a,22); // ∑0(a)
     t2 += ((b & c) | (a & (b | c))); // Maj(a,b,c)
     h=g; g=f; f=e; e=d+t1; d=c; c=b; b=a; a=t1+t2;
   }
-  state.w[0] += a;
-  state.w[1] += b;
-  state.w[2] += c;
-  state.w[3] += d;
-  state.w[4] += e;
-  state.w[5] += f;
-  state.w[6] += g;
-  state.w[7] += h;
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+void Sha256Class::hashBlock() {
+  sha256Transform(state.w,buffer.w);
+}
+
+static inline uint32_t sha256Load(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+    | ((uint32_t)p[2] << 8) | p[3];
 }
 
-void Sha256Class::addUncounted(uint8_t data) {
-  buffer.b[bufferOffset ^ 3] = data;
-  bufferOffset++;
-  if (bufferOffset == BUFFER_SIZE) {
-    hashBlock();
-    bufferOffset = 0;
+#ifdef SHA256_SIMD
+
+typedef uint32_t sha256V4 __attribute__((vector_size(16)));
+typedef uint32_t sha256V8 __attribute__((vector_size(32)));
+
+#define SHA256_VROR(x,n) (((x) >> (n)) | ((x) << (32-(n))))
+
+// The round code of sha256Transform() on vectors of sizeof(V)/4
+// lanes.  It is inlined into the kernels below and compiled with
+// their instruction sets.
+template <typename V>
+static inline __attribute__((always_inline))
+void sha256Lanes(uint32_t* const* states, const uint8_t* const* blocks) {
+  const uint8_t lanes = sizeof(V)/4;
+  uint8_t i,l;
+  V s[8],w[16];
+  V a,b,c,d,e,f,g,h,t1,t2;
+
+  // Transpose the states and blocks so that a vector holds the same
+  // word of each lane
+  for (i=0; i<8; i++) {
+    for (l=0; l<lanes; l++) s[i][l] = states[l][i];
+  }
+  for (i=0; i<16; i++) {
+    for (l=0; l<lanes; l++) w[i][l] = sha256Load(blocks[l]+4*i);
+  }
+
+  a=s[0];
+  b=s[1];
+  c=s[2];
+  d=s[3];
+  e=s[4];
+  f=s[5];
+  g=s[6];
+  h=s[7];
+
+  for (i=0; i<64; i++) {
+    if (i>=16) {
+      t1 = w[i&15] + w[(i-7)&15];
+      t2 = w[(i-2)&15];
+      t1 += SHA256_VROR(t2,17) ^ SHA256_VROR(t2,19) ^ (t2>>10);
+      t2 = w[(i-15)&15];
+      t1 += SHA256_VROR(t2,7) ^ SHA256_VROR(t2,18) ^ (t2>>3);
+      w[i&15] = t1;
+    }
+    t1 = h + w[i&15] + sha256K[i];
+    t1 += SHA256_VROR(e,6) ^ SHA256_VROR(e,11) ^ SHA256_VROR(e,25);
+    t1 += g ^ (e & (g ^ f));
+    t2 = SHA256_VROR(a,2) ^ SHA256_VROR(a,13) ^ SHA256_VROR(a,22);
+    t2 += ((b & c) | (a & (b | c)));
+    h=g; g=f; f=e; e=d+t1; d=c; c=b; b=a; a=t1+t2;
+  }
+  s[0] += a;
+  s[1] += b;
+  s[2] += c;
+  s[3] += d;
+  s[4] += e;
+  s[5] += f;
+  s[6] += g;
+  s[7] += h;
+
+  for (i=0; i<8; i++) {
+    for (l=0; l<lanes; l++) states[l][i] = s[i][l];
   }
 }
 
-size_t Sha256Class::write(uint8_t data) {
-  ++byteCount;
-  addUncounted(data);
-  return 1;
+__attribute__((target("sse4.1")))
+static void sha256Lanes4(uint32_t* const* states, const uint8_t* const* blocks) {
+  sha256Lanes<sha256V4>(states,blocks);
 }
 
-void Sha256Class::pad() {
-  // Implement SHA-256 padding (fips180-2 §5.1.1)
-
-  // Pad with 0x80 followed by 0x00 until the end of the block
-  addUncounted(0x80);
-  while (bufferOffset != 56) addUncounted(0x00);
-
-  // Append length in the last 8 bytes
-  addUncounted(0); // We're only using 32 bit lengths
-  addUncounted(0); // But SHA-1 supports 64 bit lengths
-  addUncounted(0); // So zero pad the top bits
-  addUncounted(byteCount >> 29); // Shifting to multiply by 8
-  addUncounted(byteCount >> 21); // as SHA-1 supports bitstreams as well as
-  addUncounted(byteCount >> 13); // byte.
-  addUncounted(byteCount >> 5);
-  addUncounted(byteCount << 3);
+__attribute__((target("avx2")))
+static void sha256Lanes8(uint32_t* const* states, const uint8_t* const* blocks) {
+  sha256Lanes<sha256V8>(states,blocks);
 }
 
+// The number of lanes the CPU can hash in parallel: 8, 4 or 1
+static uint8_t sha256SimdLanes(void) {
+  static int8_t lanes = -1;
+  unsigned int eax,ebx,ecx,edx,xcr0;
+
+  if (lanes < 0) {
+    lanes = 1;
+    if (__get_cpuid(1,&eax,&ebx,&ecx,&edx) && (ecx & bit_SSE4_1)) {
+      lanes = 4;
+      // AVX2 also needs the OS to save the YMM registers
+      if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX)) {
+        __asm__("xgetbv" : "=a"(xcr0), "=d"(edx) : "c"(0));
+        if ((xcr0 & 6) == 6 && __get_cpuid_count(7,0,&eax,&ebx,&ecx,&edx)
+            && (ebx & bit_AVX2)) {
+          lanes = 8;
+        }
+      }
+    }
+  }
+  return lanes;
+}
+
+#endif /* SHA256_SIMD */
+
+// Hash one block of each of the `count' lanes.  `states' and `blocks'
+// give the state and the block bytes of each lane.
+static void sha256Blocks(uint32_t* const* states, const uint8_t* const* blocks,
+                         uint8_t count) {
+  uint8_t i,l;
 
-uint8_t* Sha256Class::result(void) {
-  // Pad to complete the last block
-  pad();
+#ifdef SHA256_SIMD
+  uint8_t simd = sha256SimdLanes();
 
-  // Swap byte order back
-  for (int i=0; i<8; i++) {
-    uint32_t a,b;
-    a=state.w[i];
-    b=a<<24;
-    b|=(a<<8) & 0x00ff0000;
-    b|=(a>>8) & 0x0000ff00;
-    b|=a>>24;
-    state.w[i]=b;
+  if (count > 1 && simd > 1) {
+    // The unused lanes hash the first block into a spare state
+    uint8_t width = (count > 4 && simd == 8) ? 8 : 4;
+    uint32_t spare[8];
+    uint32_t* s[8];
+    const uint8_t* b[8];
+
+    for (i=0; i<count; i+=width) {
+      for (l=0; l<width; l++) {
+        if (i+l < count) {
+          s[l] = states[i+l];
+          b[l] = blocks[i+l];
+        } else {
+          s[l] = spare;
+          b[l] = blocks[0];
+        }
+      }
+      if (width == 8) {
+        sha256Lanes8(s,b);
+      } else {
+        sha256Lanes4(s,b);
+      }
+    }
+    return;
   }
+#endif
 
-  // Return pointer to hash (20 characters)
-  return state.b;
+  for (l=0; l<count; l++) {
+    uint32_t w[16];
+    for (i=0; i<16; i++) w[i] = sha256Load(blocks[l]+4*i);
+    sha256Transform(states[l],w);
+  }
 }
 
+// Pad the last block(s) `block' that hold the `offset' bytes after the
+// complete blocks of a `byteCount' byte message.  Returns the length
+// of the padded data, one or two blocks.
+static uint8_t sha256Pad(uint8_t* block, uint8_t offset, uint32_t byteCount) {
+  uint8_t length = offset < 56 ? SHA_BLOCK_LENGTH : 2*SHA_BLOCK_LENGTH;
 
-#define HMAC_IPAD 0x36
-#define HMAC_OPAD 0x5c
+  block[offset] = 0x80;
+  memset(block+offset+1,0,length-offset-1);
+  block[length-5] = byteCount >> 29;
+  block[length-4] = byteCount >> 21;
+  block[length-3] = byteCount >> 13;
+  block[length-2] = byteCount >> 5;
+  block[length-1] = byteCount << 3;
+  return length;
+}
 
-uint8_t keyBuffer[BLOCK_LENGTH]; // K0 in FIPS-198a
-uint8_t innerHash[HASH_LENGTH];
+void Sha256Class::updateMulti(Sha256Class* const* contexts,
+                              const uint8_t* const* data,
+                              const size_t* lengths, size_t count) {
+  const uint8_t* p[SHA256_MULTI_LANES];
+  size_t left[SHA256_MULTI_LANES];
+  uint32_t* states[SHA256_MULTI_LANES];
+  const uint8_t* blocks[SHA256_MULTI_LANES];
+  uint8_t i,n,m;
 
-void Sha256Class::initHmac(const uint8_t* key, int keyLength) {
-  uint8_t i;
-  memset(keyBuffer,0,BLOCK_LENGTH);
-  if (keyLength > BLOCK_LENGTH) {
-    // Hash long keys
-    init();
-    for (;keyLength--;) write(*key++);
-    memcpy(keyBuffer,result(),HASH_LENGTH);
-  } else {
-    // Block length keys are used as is
-    memcpy(keyBuffer,key,keyLength);
+  for (; count; contexts+=n, data+=n, lengths+=n, count-=n) {
+    n = count < SHA256_MULTI_LANES ? count : SHA256_MULTI_LANES;
+
+    // Complete the partially filled blocks one context at a time
+    for (i=0; i<n; i++) {
+      size_t head = 0;
+      if (contexts[i]->bufferOffset) {
+        head = SHA_BLOCK_LENGTH - contexts[i]->bufferOffset;
+        if (head > lengths[i]) head = lengths[i];
+        contexts[i]->update(data[i],head);
+      }
+      p[i] = data[i] + head;
+      left[i] = lengths[i] - head;
+    }
+
+    // Hash the whole blocks of all contexts that still have them
+    for (;;) {
+      for (i=0, m=0; i<n; i++) {
+        if (left[i] >= SHA_BLOCK_LENGTH) {
+          states[m] = contexts[i]->state.w;
+          blocks[m++] = p[i];
+          p[i] += SHA_BLOCK_LENGTH;
+          left[i] -= SHA_BLOCK_LENGTH;
+          contexts[i]->byteCount += SHA_BLOCK_LENGTH;
+        }
+      }
+      if (!m) break;
+      sha256Blocks(states,blocks,m);
+    }
+
+    // Buffer the rest
+    for (i=0; i<n; i++) contexts[i]->update(p[i],left[i]);
   }
-  //for (i=0; i<BLOCK_LENGTH; i++) debugHH(keyBuffer[i]);
-  // Start inner hash
-  init();
-  for (i=0; i<BLOCK_LENGTH; i++) {
-    write(keyBuffer[i] ^ HMAC_IPAD);
+}
+
+void Sha256Class::resultMulti(Sha256Class* const* contexts, uint8_t** hashes,
+                              size_t count) {
+  uint8_t last[SHA256_MULTI_LANES][2*SHA_BLOCK_LENGTH];
+  uint32_t* states[SHA256_MULTI_LANES];
+  const uint8_t* blocks[SHA256_MULTI_LANES];
+  uint8_t i,j,n,m;
+
+  for (; count; contexts+=n, hashes+=n, count-=n) {
+    n = count < SHA256_MULTI_LANES ? count : SHA256_MULTI_LANES;
+
+    // Pad the buffered bytes of each context in its own blocks
+    for (i=0, m=0; i<n; i++) {
+      Sha256Class* ctx = contexts[i];
+      for (j=0; j<ctx->bufferOffset; j++) last[i][j] = ctx->buffer.b[j ^ 3];
+      if (sha256Pad(last[i],ctx->bufferOffset,ctx->byteCount)
+          > SHA_BLOCK_LENGTH) {
+        m++;
+      }
+      states[i] = ctx->state.w;
+      blocks[i] = last[i];
+    }
+    sha256Blocks(states,blocks,n);
+
+    // The second blocks of the contexts whose padding did not fit
+    if (m) {
+      for (i=0, m=0; i<n; i++) {
+        if (contexts[i]->bufferOffset >= 56) {
+          states[m] = contexts[i]->state.w;
+          blocks[m++] = last[i] + SHA_BLOCK_LENGTH;
+        }
+      }
+      sha256Blocks(states,blocks,m);
+    }
+
+    for (i=0; i<n; i++) {
+      contexts[i]->bufferOffset = 0;
+      hashes[i] = contexts[i]->swapState();
+    }
   }
 }
 
-uint8_t* Sha256Class::resultHmac(void) {
-  uint8_t i;
-    // Complete inner hash
-  memcpy(innerHash,result(),HASH_LENGTH);
-  // now innerHash[] contains H((K0 xor ipad)||text)
-
-  // Calculate outer hash
-  init();
-  for (i=0; i<BLOCK_LENGTH; i++) write(keyBuffer[i] ^ HMAC_OPAD);
-  for (i=0; i<HASH_LENGTH; i++) write(innerHash[i]);
-  return result();
+void Sha256Class::resultHmacMulti(Sha256Class* const* contexts,
+                                  uint8_t** hashes, size_t count) {
+  uint8_t outer[SHA256_MULTI_LANES][SHA_BLOCK_LENGTH];
+  uint32_t* states[SHA256_MULTI_LANES];
+  const uint8_t* blocks[SHA256_MULTI_LANES];
+  uint8_t i,n;
+
+  for (; count; contexts+=n, hashes+=n, count-=n) {
+    n = count < SHA256_MULTI_LANES ? count : SHA256_MULTI_LANES;
+
+    // Complete the inner hashes
+    resultMulti(contexts,hashes,n);
+
+    // Hash them from the precomputed outer key block states
+    for (i=0; i<n; i++) {
+      Sha256Class* ctx = contexts[i];
+      memcpy(outer[i],hashes[i],SHA256_HASH_LENGTH);
+      ctx->state = ctx->outerState;
+      ctx->byteCount = SHA_BLOCK_LENGTH + SHA256_HASH_LENGTH;
+      sha256Pad(outer[i],SHA256_HASH_LENGTH,ctx->byteCount);
+      states[i] = ctx->state.w;
+      blocks[i] = outer[i];
+    }
+    sha256Blocks(states,blocks,n);
+
+    for (i=0; i<n; i++) hashes[i] = contexts[i]->swapState();
+  }
 }
+
 Sha256Class Sha256;
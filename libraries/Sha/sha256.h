@@ -1,42 +1,39 @@
 #ifndef Sha256_h
 #define Sha256_h
 
-#include <inttypes.h>
-#include "Print.h"
+#include "shabase.h"
 
-#define HASH_LENGTH 32
-#define BLOCK_LENGTH 64
+#define SHA256_HASH_LENGTH 32
+#define SHA256_HMAC_KEY_STATE_LENGTH (2*SHA256_HASH_LENGTH)
 
-union _buffer {
-  uint8_t b[BLOCK_LENGTH];
-  uint32_t w[BLOCK_LENGTH/4];
-};
-union _state {
-  uint8_t b[HASH_LENGTH];
-  uint32_t w[HASH_LENGTH/4];
-};
+// The number of contexts the multi-buffer methods hash at a time
+#if defined(__AVR__)
+#define SHA256_MULTI_LANES 1
+#else
+#define SHA256_MULTI_LANES 8
+#endif
 
-class Sha256Class : public Print
+class Sha256Class : public ShaBase
 {
   public:
-    void init(void);
-    void initHmac(const uint8_t* secret, int secretLength);
-    uint8_t* result(void);
-    uint8_t* resultHmac(void);
-    virtual size_t write(uint8_t);
-    using Print::write;
-  private:
-    void pad();
-    void addUncounted(uint8_t data);
-    void hashBlock();
-    uint32_t ror32(uint32_t number, uint8_t bits);
-    _buffer buffer;
-    uint8_t bufferOffset;
-    _state state;
-    uint32_t byteCount;
-    uint8_t keyBuffer[BLOCK_LENGTH];
-    uint8_t innerHash[HASH_LENGTH];
+    Sha256Class();
+    // Multi-buffer hashing of `count' independent messages.  These do
+    // the same as update(data[i],lengths[i]), result() and
+    // resultHmac() of each of the `contexts' in turn, but hash the
+    // blocks of SHA256_MULTI_LANES contexts at a time in parallel with
+    // SSE4.1 or AVX2 where the CPU has them.  The hashes are returned
+    // in `hashes' and point to the contexts as with result().
+    static void updateMulti(Sha256Class* const* contexts,
+                            const uint8_t* const* data,
+                            const size_t* lengths, size_t count);
+    static void resultMulti(Sha256Class* const* contexts, uint8_t** hashes,
+                            size_t count);
+    static void resultHmacMulti(Sha256Class* const* contexts,
+                                uint8_t** hashes, size_t count);
+  protected:
+    virtual void hashBlock();
 };
+// Shared context for the code that does not keep its own
 extern Sha256Class Sha256;
 
 #endif
@@ -0,0 +1,163 @@
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "shabase.h"
+
+#define HMAC_IPAD 0x36
+#define HMAC_OPAD 0x5c
+
+ShaBase::ShaBase(const uint8_t* initialState, uint8_t hashLength)
+  : initialState(initialState), hashLength(hashLength) {
+  init();
+}
+
+void ShaBase::init(void) {
+  memcpy_P(state.b,initialState,hashLength);
+  byteCount = 0;
+  bufferOffset = 0;
+}
+
+void ShaBase::addUncounted(uint8_t data) {
+  buffer.b[bufferOffset ^ 3] = data;
+  bufferOffset++;
+  if (bufferOffset == SHA_BLOCK_LENGTH) {
+    hashBlock();
+    bufferOffset = 0;
+  }
+}
+
+size_t ShaBase::write(uint8_t data) {
+  ++byteCount;
+  addUncounted(data);
+  return 1;
+}
+
+void ShaBase::loadBlock(const uint8_t* data) {
+  // Big-endian loads; the bytes need not be word aligned
+  for (uint8_t i=0; i<SHA_BLOCK_LENGTH/4; i++, data+=4) {
+    buffer.w[i] = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16)
+      | ((uint32_t)data[2] << 8) | data[3];
+  }
+}
+
+void ShaBase::update(const uint8_t* data, size_t length) {
+  byteCount += length;
+  // Complete a partially filled block
+  while (bufferOffset && length) {
+    addUncounted(*data++);
+    length--;
+  }
+  // Hash whole blocks without going through the buffer a byte at a time
+  for (; length >= SHA_BLOCK_LENGTH; length -= SHA_BLOCK_LENGTH) {
+    loadBlock(data);
+    hashBlock();
+    data += SHA_BLOCK_LENGTH;
+  }
+  while (length--) addUncounted(*data++);
+}
+
+size_t ShaBase::write(const uint8_t* data, size_t length) {
+  update(data,length);
+  return length;
+}
+
+void ShaBase::pad() {
+  // Implement SHA-1 and SHA-256 padding (fips180-2 §5.1.1)
+
+  // Pad with 0x80 followed by 0x00 until the end of the block
+  addUncounted(0x80);
+  while (bufferOffset != 56) addUncounted(0x00);
+
+  // Append length in the last 8 bytes
+  addUncounted(0); // We're only using 32 bit lengths
+  addUncounted(0); // But SHA supports 64 bit lengths
+  addUncounted(0); // So zero pad the top bits
+  addUncounted(byteCount >> 29); // Shifting to multiply by 8
+  addUncounted(byteCount >> 21); // as SHA supports bitstreams as well as
+  addUncounted(byteCount >> 13); // byte.
+  addUncounted(byteCount >> 5);
+  addUncounted(byteCount << 3);
+}
+
+uint8_t* ShaBase::result(void) {
+  // Pad to complete the last block
+  pad();
+  return swapState();
+}
+
+uint8_t* ShaBase::swapState(void) {
+  // Swap byte order back
+  for (uint8_t i=0; i<hashLength/4; i++) {
+    uint32_t a,b;
+    a=state.w[i];
+    b=a<<24;
+    b|=(a<<8) & 0x00ff0000;
+    b|=(a>>8) & 0x0000ff00;
+    b|=a>>24;
+    state.w[i]=b;
+  }
+
+  // Return pointer to hash (hashLength bytes)
+  return state.b;
+}
+
+void ShaBase::initHmac(const uint8_t* key, int keyLength) {
+  uint8_t i;
+  uint8_t keyBuffer[SHA_BLOCK_LENGTH]; // K0 in FIPS-198a
+  memset(keyBuffer,0,SHA_BLOCK_LENGTH);
+  if (keyLength > SHA_BLOCK_LENGTH) {
+    // Hash long keys
+    init();
+    update(key,keyLength);
+    memcpy(keyBuffer,result(),hashLength);
+  } else {
+    // Block length keys are used as is
+    memcpy(keyBuffer,key,keyLength);
+  }
+  // Precompute outer hash state so the key is not needed later
+  init();
+  for (i=0; i<SHA_BLOCK_LENGTH; i++) {
+    write(keyBuffer[i] ^ HMAC_OPAD);
+  }
+  outerState = state;
+  // Start inner hash
+  init();
+  for (i=0; i<SHA_BLOCK_LENGTH; i++) {
+    write(keyBuffer[i] ^ HMAC_IPAD);
+  }
+}
+
+void ShaBase::getHmacKeyState(uint8_t* keyState) {
+  memcpy(keyState,state.b,hashLength);
+  memcpy(keyState+hashLength,outerState.b,hashLength);
+}
+
+void ShaBase::initHmacKeyState(const uint8_t* keyState) {
+  // Resume the inner hash after the key block
+  initMidstate(keyState,SHA_BLOCK_LENGTH);
+  memcpy(outerState.b,keyState+hashLength,hashLength);
+}
+
+uint32_t ShaBase::getMidstate(uint8_t* midstate) {
+  memcpy(midstate,state.b,hashLength);
+  return byteCount - bufferOffset;
+}
+
+void ShaBase::initMidstate(const uint8_t* midstate, uint32_t length) {
+  memcpy(state.b,midstate,hashLength);
+  byteCount = length;
+  bufferOffset = 0;
+}
+
+uint8_t* ShaBase::resultHmac(void) {
+  uint8_t innerHash[SHA_MAX_HASH_LENGTH];
+  // Complete inner hash
+  memcpy(innerHash,result(),hashLength);
+  // now innerHash[] contains H((K0 xor ipad)||text)
+
+  // Calculate outer hash from the precomputed key block state
+  state = outerState;
+  byteCount = SHA_BLOCK_LENGTH;
+  bufferOffset = 0;
+  update(innerHash,hashLength);
+  return result();
+}
@@ -0,0 +1,68 @@
+#ifndef ShaBase_h
+#define ShaBase_h
+
+#include <inttypes.h>
+#include "Print.h"
+
+#define SHA_BLOCK_LENGTH 64
+#define SHA_MAX_HASH_LENGTH 32
+
+// The Merkle-Damgard construction shared by SHA-1 and SHA-256: block
+// buffering, padding, the length encoding and HMAC.  A subclass gives
+// its initial state and hash length to the constructor and implements
+// the compression function hashBlock().
+//
+// Each object is an independent hash context.  Objects can be copied
+// to fork the hash: the copy continues from the same state without
+// affecting the original, e.g. to take the result of a prefix.
+class ShaBase : public Print
+{
+  public:
+    void init(void);
+    void initHmac(const uint8_t* secret, int secretLength);
+    // Save the HMAC key state (2*hashLength bytes) right after
+    // initHmac() and restore it later to skip the key processing.
+    void getHmacKeyState(uint8_t* keyState);
+    void initHmacKeyState(const uint8_t* keyState);
+    // Save the hash state (hashLength bytes) of the complete blocks
+    // hashed so far and return their length in bytes.  After restoring
+    // the state, write again the bytes that followed the saved length.
+    uint32_t getMidstate(uint8_t* midstate);
+    void initMidstate(const uint8_t* midstate, uint32_t length);
+    uint8_t* result(void);
+    uint8_t* resultHmac(void);
+    // Add `length' bytes of `data' to the hash.  Whole blocks are
+    // loaded a word at a time and hashed straight from `data'.
+    void update(const uint8_t* data, size_t length);
+    virtual size_t write(uint8_t);
+    virtual size_t write(const uint8_t* data, size_t length);
+    using Print::write;
+  protected:
+    // `initialState' is in program memory
+    ShaBase(const uint8_t* initialState, uint8_t hashLength);
+    // Hash the block in `buffer' into `state'
+    virtual void hashBlock() = 0;
+    union _buffer {
+      uint8_t b[SHA_BLOCK_LENGTH];
+      uint32_t w[SHA_BLOCK_LENGTH/4];
+    };
+    union _state {
+      uint8_t b[SHA_MAX_HASH_LENGTH];
+      uint32_t w[SHA_MAX_HASH_LENGTH/4];
+    };
+    // Convert the final state to the hash bytes and return them
+    uint8_t* swapState(void);
+    _buffer buffer;
+    _state state;
+    uint8_t bufferOffset;
+    uint32_t byteCount;
+    _state outerState;
+  private:
+    void pad();
+    void addUncounted(uint8_t data);
+    void loadBlock(const uint8_t* data);
+    const uint8_t* initialState;
+    uint8_t hashLength;
+};
+
+#endif
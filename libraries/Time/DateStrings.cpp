@@ -48,11 +48,16 @@ char dayStr7[] PROGMEM = "Saturday";
 PGM_P dayNames_P[] PROGMEM = { dayStr0,dayStr1,dayStr2,dayStr3,dayStr4,dayStr5,dayStr6,dayStr7};
 char dayShortNames_P[] PROGMEM = "ErrSunMonTueWedThrFriSat";
 
+// pgm_read_ptr reads a pointer from program memory; older avr-libc versions lack it
+#ifndef pgm_read_ptr
+#define pgm_read_ptr(addr) ((void *)pgm_read_word(addr))
+#endif
+
 /* functions to return date strings */
 
 char* monthStr(uint8_t month)
 {
-    strcpy_P(buffer, (PGM_P)pgm_read_word(&(monthNames_P[month])));
+    strcpy_P(buffer, (PGM_P)pgm_read_ptr(&(monthNames_P[month])));
 	return buffer;
 }
 
@@ -66,7 +71,7 @@ char* monthShortStr(uint8_t month)
 
 char* dayStr(uint8_t day) 
 {
-   strcpy_P(buffer, (PGM_P)pgm_read_word(&(dayNames_P[day])));
+   strcpy_P(buffer, (PGM_P)pgm_read_ptr(&(dayNames_P[day])));
    return buffer;
 }
 
@@ -0,0 +1,400 @@
+/*
+ * SyncClock.cpp
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SyncClock.h"
+
+/* The rates of SYNC_CLOCK_TOLERANCE_PPM and SYNC_CLOCK_ESTIMATE_PPM as
+   milliseconds per local millisecond in units of 2^-32. */
+#define PPM_TO_Q32(ppm) ((uint32_t) ((ppm) * 4294967296ULL / 1000000UL))
+#define TOLERANCE_Q32 PPM_TO_Q32(SYNC_CLOCK_TOLERANCE_PPM)
+#define ESTIMATE_Q32 PPM_TO_Q32(SYNC_CLOCK_ESTIMATE_PPM)
+
+/* The local time between the anchor point and the clock reading is
+   kept below 2^31 milliseconds, about 24 days, so that it fits the
+   32-bit arithmetic. */
+#define MAX_ELAPSED 0x80000000UL
+
+/* The fit measures the local time in units of 2^10 milliseconds and
+   handles samples up to 2^27 units, about 4 years, apart.  The offsets
+   of the samples from the newest one are limited to 2^28
+   milliseconds, about 3 days, so that the sums of the regression fit
+   in 64 bits and the intercept in 32 bits. */
+#define X_SHIFT 10
+#define MAX_X (1L << 27)
+#define MAX_Y (1L << 28)
+
+/* Compute `num' / `denom' with `bits' fractional bits with a shift and
+   subtract division.  The integer part of the quotient must be small.
+   This avoids the 64-bit division of libgcc that is large and slow on
+   the AVR. */
+static uint64_t
+fixed_div(uint64_t num, uint64_t denom, uint8_t bits)
+{
+  uint64_t quotient = 0;
+
+  while (num >= denom)
+    {
+      num -= denom;
+      quotient++;
+    }
+
+  while (bits-- > 0)
+    {
+      num <<= 1;
+      quotient <<= 1;
+      if (num >= denom)
+        {
+          num -= denom;
+          quotient |= 1;
+        }
+    }
+
+  return quotient;
+}
+
+SyncClock::SyncClock()
+  : local_ms(0),
+    last_millis(0),
+    anchor_local(0),
+    anchor_sec(0),
+    anchor_ms(0),
+    drift(0),
+    error_base(0),
+    error_rate(TOLERANCE_Q32),
+    max_error(SYNC_CLOCK_DEFAULT_MAX_ERROR),
+    num_samples(0)
+{
+}
+
+void
+SyncClock::sync(unsigned long utc)
+{
+  uint64_t now = get_local_ms();
+  int64_t diff;
+  uint8_t i;
+
+  if (num_samples > 0
+      && now - sample_local[num_samples - 1] < SYNC_CLOCK_MIN_INTERVAL)
+    {
+      /* Too close to the previous sample to tell anything about the
+         drift.  Just correct a clock that is off by more than the
+         resolution of the reference.  A reference further off than
+         the predicted error is a bad one and it is ignored. */
+      diff = (int64_t) (get_time_ms() - (uint64_t) utc * 1000);
+
+      if ((diff < 0 || diff >= 1000)
+          && diff - 500 <= (int64_t) get_error_ms() + SYNC_CLOCK_SAMPLE_ERROR
+          && 500 - diff <= (int64_t) get_error_ms() + SYNC_CLOCK_SAMPLE_ERROR)
+        {
+          set_anchor(now, utc, 500);
+          error_base = SYNC_CLOCK_SAMPLE_ERROR;
+        }
+      return;
+    }
+
+  /* Drop the oldest sample if the samples are full. */
+  if (num_samples == SYNC_CLOCK_SAMPLES)
+    {
+      for (i = 1; i < SYNC_CLOCK_SAMPLES; i++)
+        {
+          sample_local[i - 1] = sample_local[i];
+          sample_utc[i - 1] = sample_utc[i];
+        }
+      num_samples--;
+    }
+
+  sample_local[num_samples] = now;
+  sample_utc[num_samples] = utc;
+  num_samples++;
+
+  estimate();
+}
+
+bool
+SyncClock::fit(uint8_t skip, int32_t *drift_return, long *offset_return,
+               unsigned long *residual_return)
+{
+  uint64_t ref_local = sample_local[num_samples - 1];
+  unsigned long ref_utc = sample_utc[num_samples - 1];
+  long x[SYNC_CLOCK_SAMPLES];
+  long y[SYNC_CLOCK_SAMPLES];
+  int64_t sx = 0, sy = 0, sxx = 0, sxy = 0;
+  int64_t dx, dy, num, denom;
+  int32_t slope;
+  long offset, residual;
+  unsigned long max_residual = 0;
+  uint8_t i, n = 0;
+
+  /* Fit the offset of UTC from the local time in milliseconds as a
+     line over the local time.  The values are relative to the newest
+     sample. */
+  for (i = 0; i < num_samples; i++)
+    {
+      if (i == skip)
+        continue;
+
+      dx = (int64_t) (sample_local[i] - ref_local);
+      dy = (int64_t) (long) (sample_utc[i] - ref_utc) * 1000 - dx;
+
+      if (dx <= -((int64_t) MAX_X << X_SHIFT) || dy <= -MAX_Y || dy >= MAX_Y)
+        return false;
+
+      x[i] = (long) (dx >> X_SHIFT);
+      y[i] = (long) dy;
+
+      sx += x[i];
+      sy += y[i];
+      sxx += (int64_t) x[i] * x[i];
+      sxy += (int64_t) x[i] * y[i];
+      n++;
+    }
+
+  num = n * sxy - sx * sy;
+  denom = n * sxx - sx * sx;
+  if (denom <= 0)
+    return false;
+
+  /* The slope is in milliseconds per 2^10 milliseconds.  Anything
+     beyond the oscillator tolerance means a bad sample. */
+  if ((num < 0 ? -num : num) >= denom * 8)
+    return false;
+
+  slope = (int32_t) fixed_div(num < 0 ? -num : num, denom, 32 - X_SHIFT);
+  if ((uint32_t) slope > TOLERANCE_Q32)
+    return false;
+  if (num < 0)
+    slope = -slope;
+
+  offset = (long) (sy - (((int64_t) slope * sx) >> (32 - X_SHIFT))) / n;
+
+  for (i = 0; i < num_samples; i++)
+    {
+      if (i == skip)
+        continue;
+
+      residual = y[i] - offset
+        - (long) (((int64_t) slope * x[i]) >> (32 - X_SHIFT));
+      if (residual < 0)
+        residual = -residual;
+
+      if (residual > SYNC_CLOCK_MAX_RESIDUAL)
+        return false;
+      if ((unsigned long) residual > max_residual)
+        max_residual = residual;
+    }
+
+  *drift_return = slope;
+  *offset_return = offset;
+  *residual_return = max_residual;
+
+  return true;
+}
+
+void
+SyncClock::estimate(void)
+{
+  uint64_t ref_local = sample_local[num_samples - 1];
+  unsigned long ref_utc = sample_utc[num_samples - 1];
+  int32_t fit_drift;
+  long fit_offset;
+  unsigned long residual, best_residual = 0;
+  uint64_t rate;
+  uint8_t i, best;
+
+  if (num_samples >= 2
+      && !fit(num_samples, &fit_drift, &fit_offset, &residual))
+    {
+      /* Find the sample that does not fit with the others. */
+      best = num_samples;
+      if (num_samples >= 3)
+        for (i = 0; i < num_samples; i++)
+          if (fit(i, &fit_drift, &fit_offset, &residual)
+              && (best == num_samples || residual < best_residual))
+            {
+              best = i;
+              best_residual = residual;
+            }
+
+      if (best < num_samples)
+        {
+          /* Evict the outlier. */
+          fit(best, &fit_drift, &fit_offset, &residual);
+
+          for (i = best + 1; i < num_samples; i++)
+            {
+              sample_local[i - 1] = sample_local[i];
+              sample_utc[i - 1] = sample_utc[i];
+            }
+          num_samples--;
+        }
+      else
+        {
+          /* The samples do not agree.  Start over from the newest
+             one. */
+          sample_local[0] = ref_local;
+          sample_utc[0] = ref_utc;
+          num_samples = 1;
+        }
+    }
+
+  error_base = SYNC_CLOCK_SAMPLE_ERROR;
+
+  /* The reference time is truncated to the second so the true time is
+     half a second later on average. */
+  if (num_samples < 2)
+    {
+      drift = 0;
+      error_rate = TOLERANCE_Q32;
+      set_anchor(ref_local, ref_utc, 500);
+      return;
+    }
+
+  drift = fit_drift;
+
+  /* The sample errors make the drift uncertain by up to twice the
+     sample error over the time between the samples. */
+  rate = ESTIMATE_Q32
+    + fixed_div(2 * SYNC_CLOCK_SAMPLE_ERROR,
+                sample_local[num_samples - 1] - sample_local[0], 32);
+  error_rate = rate < TOLERANCE_Q32 ? (uint32_t) rate : TOLERANCE_Q32;
+
+  /* At the end of the fit the sample errors can add up to more than
+     the error of one sample. */
+  error_base += SYNC_CLOCK_SAMPLE_ERROR / 2;
+
+  /* Anchor the clock to the fitted line at the newest sample. */
+  set_anchor(ref_local, ref_utc, 500 + fit_offset);
+}
+
+uint32_t
+SyncClock::advance(uint64_t now)
+{
+  unsigned long ms;
+
+  /* Move the anchor point forward in MAX_ELAPSED steps. */
+  while (now - anchor_local >= MAX_ELAPSED)
+    {
+      ms = anchor_ms + MAX_ELAPSED
+        + (long) (((int64_t) MAX_ELAPSED * drift) >> 32);
+
+      anchor_local += MAX_ELAPSED;
+      anchor_sec += ms / 1000;
+      anchor_ms = ms % 1000;
+      error_base += ((uint64_t) MAX_ELAPSED * error_rate) >> 32;
+    }
+
+  return (uint32_t) (now - anchor_local);
+}
+
+void
+SyncClock::set_anchor(uint64_t local, unsigned long utc, long utc_ms)
+{
+  utc += utc_ms / 1000;
+  utc_ms %= 1000;
+  if (utc_ms < 0)
+    {
+      utc--;
+      utc_ms += 1000;
+    }
+
+  anchor_local = local;
+  anchor_sec = utc;
+  anchor_ms = utc_ms;
+}
+
+bool
+SyncClock::is_set(void)
+{
+  return num_samples > 0;
+}
+
+uint64_t
+SyncClock::get_local_ms(void)
+{
+  unsigned long now = millis();
+
+  /* Unsigned subtraction handles the millis() wraparound. */
+  local_ms += (uint32_t) (now - last_millis);
+  last_millis = now;
+
+  return local_ms;
+}
+
+/* The milliseconds from the anchor second to the current time. */
+#define ANCHOR_MS(elapsed)                                              \
+  (anchor_ms + (elapsed) + (long) (((int64_t) (elapsed) * drift) >> 32))
+
+uint64_t
+SyncClock::get_time_ms(void)
+{
+  uint32_t elapsed;
+
+  if (!is_set())
+    return 0;
+
+  elapsed = advance(get_local_ms());
+
+  return (uint64_t) anchor_sec * 1000 + ANCHOR_MS(elapsed);
+}
+
+unsigned long
+SyncClock::get_time(void)
+{
+  uint32_t elapsed;
+
+  if (!is_set())
+    return 0;
+
+  elapsed = advance(get_local_ms());
+
+  /* The milliseconds fit in 32 bits after advance(). */
+  return anchor_sec + (uint32_t) ANCHOR_MS(elapsed) / 1000;
+}
+
+long
+SyncClock::get_drift_ppm(void)
+{
+  return (long) (((int64_t) drift * 1000000L) >> 32);
+}
+
+unsigned long
+SyncClock::get_error_ms(void)
+{
+  uint32_t elapsed = advance(get_local_ms());
+
+  /* The error at the anchor point plus the worst case drift since
+     it. */
+  return error_base + (((uint64_t) elapsed * error_rate) >> 32);
+}
+
+void
+SyncClock::set_max_error(unsigned long ms)
+{
+  max_error = ms;
+}
+
+bool
+SyncClock::needs_sync(void)
+{
+  return !is_set() || get_error_ms() > max_error;
+}
@@ -0,0 +1,171 @@
+/* -*- c++ -*-
+ *
+ * SyncClock.h
+ *
+ * Author: Markku Rossi <mtr@iki.fi>
+ *
+ * Copyright (c) 2012 Markku Rossi
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SYNCCLOCK_H
+#define SYNCCLOCK_H
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+/* The number of synchronization samples used for the drift
+   estimate. */
+#define SYNC_CLOCK_SAMPLES 4
+
+/* The minimum time in milliseconds between two synchronization
+   samples.  The reference time has one second resolution so the
+   samples must be far enough apart to tell the drift from the
+   rounding. */
+#define SYNC_CLOCK_MIN_INTERVAL (10L * 60L * 1000L)
+
+/* The error bound of the local clock rate in parts per million before
+   and after the drift has been estimated.  The first one covers the
+   ceramic resonators of the Arduino boards.  The second one is the
+   floor of the estimate; the uncertainty of a fit over samples close
+   to each other is larger and is added to it. */
+#define SYNC_CLOCK_TOLERANCE_PPM 5000L
+#define SYNC_CLOCK_ESTIMATE_PPM 50L
+
+/* The error in milliseconds of a single synchronization sample: the
+   one second resolution of the reference and the network delay of the
+   response. */
+#define SYNC_CLOCK_SAMPLE_ERROR 1000L
+
+/* A sample that is further than this many milliseconds off the line
+   fitted to the other samples is an outlier and it is evicted from
+   the samples. */
+#define SYNC_CLOCK_MAX_RESIDUAL 2000L
+
+/* The default maximum predicted error in milliseconds before the
+   clock needs to be synchronized. */
+#define SYNC_CLOCK_DEFAULT_MAX_ERROR 30000L
+
+/* A UTC clock that runs on millis() and is synchronized from a
+   reference time with one second resolution, like the HTTP `Date'
+   header.  The clock keeps 64-bit milliseconds so it does not wrap,
+   and it estimates the drift of the local oscillator with a linear
+   regression over the recent synchronization samples.  The
+   computations are in fixed point without floating point or 64-bit
+   division. */
+class SyncClock
+{
+public:
+
+  SyncClock();
+
+  /* Synchronize the clock to the reference Unix time `utc' seconds,
+     which is the current time truncated to the second. */
+  void sync(unsigned long utc);
+
+  /* Tests if the clock has been synchronized. */
+  bool is_set(void);
+
+  /* Get the monotonic local time in milliseconds since start-up.  The
+     clock must be read at least once in 49 days to track the millis()
+     wraparound; all other methods do that. */
+  uint64_t get_local_ms(void);
+
+  /* Get the current UTC Unix time in milliseconds, or 0 if the clock
+     has not been synchronized. */
+  uint64_t get_time_ms(void);
+
+  /* Get the current UTC Unix time in seconds, or 0 if the clock has
+     not been synchronized. */
+  unsigned long get_time(void);
+
+  /* Get the estimated drift of the local clock in parts per
+     million. */
+  long get_drift_ppm(void);
+
+  /* Get the predicted error of the clock in milliseconds. */
+  unsigned long get_error_ms(void);
+
+  /* Set the maximum predicted error `ms' in milliseconds before the
+     clock needs to be synchronized. */
+  void set_max_error(unsigned long ms);
+
+  /* Tests if the clock is not set or its predicted error exceeds the
+     maximum error. */
+  bool needs_sync(void);
+
+private:
+
+  /* Fit a line to the samples, leaving out the sample `skip' if it is
+     less than `num_samples'.  On success the method stores the drift
+     into `drift_return', the offset of the line from the newest sample
+     at its local time in milliseconds into `offset_return', and the
+     largest distance of a sample from the line into
+     `residual_return', and returns true.  The method returns false if
+     the drift is beyond the oscillator tolerance or if a sample is an
+     outlier. */
+  bool fit(uint8_t skip, int32_t *drift_return, long *offset_return,
+           unsigned long *residual_return);
+
+  /* Fit the model to the samples, evicting an outlier or restarting
+     from the newest sample if the samples do not fit. */
+  void estimate(void);
+
+  /* Move the anchor point to the local time `now' if the time since
+     the anchor point would no longer fit in 31 bits.  The method
+     returns the milliseconds from the anchor point to `now'. */
+  uint32_t advance(uint64_t now);
+
+  /* Set the anchor point to local time `local' and the UTC time
+     `utc_ms' milliseconds after the second `utc'. */
+  void set_anchor(uint64_t local, unsigned long utc, long utc_ms);
+
+  /* Local time in milliseconds at `last_millis'. */
+  uint64_t local_ms;
+
+  /* The last millis() value seen. */
+  unsigned long last_millis;
+
+  /* The local time and the UTC time in seconds and milliseconds of
+     the anchor point of the clock model. */
+  uint64_t anchor_local;
+  unsigned long anchor_sec;
+  uint16_t anchor_ms;
+
+  /* The clock drift as UTC milliseconds gained per local millisecond
+     in units of 2^-32. */
+  int32_t drift;
+
+  /* The predicted error at the anchor point in milliseconds and its
+     growth per local millisecond in units of 2^-32. */
+  unsigned long error_base;
+  uint32_t error_rate;
+
+  /* Maximum predicted error in milliseconds. */
+  unsigned long max_error;
+
+  /* Synchronization samples from the oldest to the newest: local time
+     in milliseconds and the reference UTC time in seconds. */
+  uint64_t sample_local[SYNC_CLOCK_SAMPLES];
+  unsigned long sample_utc[SYNC_CLOCK_SAMPLES];
+  uint8_t num_samples;
+};
+
+#endif /* not SYNCCLOCK_H */
@@ -24,38 +24,127 @@
 #include "Twitter.h"
 
 const static char hex_table[] PROGMEM = "0123456789ABCDEF";
-const static char base64_table[] PROGMEM
-= "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-const static char s_jan[] PROGMEM = "Jan";
-const static char s_feb[] PROGMEM = "Feb";
-const static char s_mar[] PROGMEM = "Mar";
-const static char s_apr[] PROGMEM = "Apr";
-const static char s_may[] PROGMEM = "May";
-const static char s_jun[] PROGMEM = "Jun";
-const static char s_jul[] PROGMEM = "Jul";
-const static char s_aug[] PROGMEM = "Aug";
-const static char s_sep[] PROGMEM = "Sep";
-const static char s_oct[] PROGMEM = "Oct";
-const static char s_nov[] PROGMEM = "Nov";
-const static char s_dec[] PROGMEM = "Dec";
-
-const static char *months[] PROGMEM =
+
+/* The signature base string is collected into chunks of this many
+   bytes on the stack and hashed a chunk at a time.  The chunk is
+   flushed when an encoded character might not fit into it. */
+#define AUTH_CHUNK_LEN		32
+#define AUTH_ENCODED_MAX	5
+
+/* Bitmap of the unreserved characters that are passed through URL
+   encoding as-is: `0'-`9', `A'-`Z', `a'-`z', `-', `.', `_' and `~'. */
+const static uint8_t unreserved_table[32] PROGMEM =
+  {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0xff, 0x03,
+    0xfe, 0xff, 0xff, 0x87, 0xfe, 0xff, 0xff, 0x47,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  };
+
+/* Month names packed with 5 bits per letter, see parse_month(). */
+#define PACK_MONTH(a, b, c) \
+  ((((a) & 0x1f) << 10) | (((b) & 0x1f) << 5) | ((c) & 0x1f))
+
+const static uint16_t months[12] PROGMEM =
+  {
+    PACK_MONTH('J', 'a', 'n'), PACK_MONTH('F', 'e', 'b'),
+    PACK_MONTH('M', 'a', 'r'), PACK_MONTH('A', 'p', 'r'),
+    PACK_MONTH('M', 'a', 'y'), PACK_MONTH('J', 'u', 'n'),
+    PACK_MONTH('J', 'u', 'l'), PACK_MONTH('A', 'u', 'g'),
+    PACK_MONTH('S', 'e', 'p'), PACK_MONTH('O', 'c', 't'),
+    PACK_MONTH('N', 'o', 'v'), PACK_MONTH('D', 'e', 'c'),
+  };
+
+const static uint8_t days_in_month[12] PROGMEM =
+  {
+    31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31,
+  };
+
+/* The last time of the 32-bit unsigned Unix time, 2106-02-07 06:28:15,
+   as days and seconds of the day. */
+#define MAX_TIME_DAYS		(0xffffffffUL / 86400UL)
+#define MAX_TIME_SECONDS	(0xffffffffUL % 86400UL)
+
+/* Response processing states. */
+#define STATE_IDLE		0
+#define STATE_STATUS		1
+#define STATE_HEADER		2
+#define STATE_BODY		3
+#define STATE_CHUNK_SIZE	4
+#define STATE_CHUNK_DATA	5
+#define STATE_CHUNK_END		6
+#define STATE_TRAILER		7
+
+/* The response values we are interested in.  The order matches the
+   `path' argument of response_value(). */
+const static char path_id_str[] PROGMEM = "id_str";
+const static char path_error_code[] PROGMEM = "errors[].code";
+
+static const prog_char *const response_paths[] =
   {
-    s_jan, s_feb, s_mar, s_apr, s_may, s_jun,
-    s_jul, s_aug, s_sep, s_oct, s_nov, s_dec,
+    path_id_str,
+    path_error_code,
   };
 
+#define RESPONSE_PATH_ID_STR		0
+#define RESPONSE_PATH_ERROR_CODE	1
+
+/* The multipart/form-data boundary of the status updates with media.
+   The status message must not contain it. */
+#define MULTIPART_BOUNDARY "ArduinoTwitterBoundary7MA4YWxkTrZu0gW"
+
+/* The constant parts of the multipart body around the status message,
+   the media type and the media. */
+const static char multipart_status[] PROGMEM =
+  "--" MULTIPART_BOUNDARY "\r\n"
+  "Content-Disposition: form-data; name=\"status\"\r\n"
+  "\r\n";
+
+const static char multipart_media[] PROGMEM =
+  "\r\n--" MULTIPART_BOUNDARY "\r\n"
+  "Content-Disposition: form-data; name=\"media[]\"; "
+  "filename=\"media\"\r\n"
+  "Content-Type: ";
+
+const static char multipart_data[] PROGMEM = "\r\n\r\n";
+
+const static char multipart_end[] PROGMEM =
+  "\r\n--" MULTIPART_BOUNDARY "--\r\n";
+
 Twitter::Twitter(char *buffer, size_t buffer_len)
-  : basetime(0L),
-    last_millis(0L),
+  : keep_alive(0),
+    queue_posting(0),
+    queue_querying(0),
+    auth_cached(0),
+    lazy_clock(0),
+    timeout(TWITTER_DEFAULT_TIMEOUT),
+    idle_callback(0),
+    state(STATE_IDLE),
+    response_code(0),
+    error_code(0),
+    parser(parser_buffer, sizeof(parser_buffer)),
+    queue(0),
+    queue_len(0),
+    queue_used(0),
+    queue_eeprom(-1),
+    hold_start(0),
+    hold_delay(0),
+    nonce_boot(0),
+    nonce_count(0),
     timestamp(0),
+    hmac(0),
     buffer(buffer),
     buffer_len(buffer_len),
     server(0),
     uri(0),
+    media_uri(0),
     port(0)
 {
+  memset(signature, 0, sizeof(signature));
+
+  parser.set_paths(response_paths,
+                   sizeof(response_paths) / sizeof(response_paths[0]),
+                   response_value, this);
 }
 
 void
@@ -68,6 +157,8 @@ Twitter::set_twitter_endpoint(const prog_char server[], const prog_char uri[],
   this->port = port;
 
   this->proxy = proxy ? 1 : 0;
+
+  this->auth_cached = 0;
 }
 
 void
@@ -76,6 +167,8 @@ Twitter::set_client_id(const prog_char consumer_key[],
 {
   this->consumer_key = consumer_key;
   this->consumer_secret = consumer_secret;
+
+  this->auth_cached = 0;
 }
 
 void
@@ -86,6 +179,7 @@ Twitter::set_account_id(const prog_char access_token[],
   this->token_secret.pgm = token_secret;
 
   this->access_token_pgm = 1;
+  this->auth_cached = 0;
 }
 
 void
@@ -95,356 +189,1196 @@ Twitter::set_account_id(int access_token, int token_secret)
   this->token_secret.eeprom = token_secret;
 
   this->access_token_pgm = 0;
+  this->auth_cached = 0;
+}
+
+void
+Twitter::set_keep_alive(bool keep_alive)
+{
+  this->keep_alive = keep_alive ? 1 : 0;
+
+  if (!keep_alive)
+    http.stop();
+}
+
+void
+Twitter::set_timeout(unsigned long timeout)
+{
+  this->timeout = timeout;
+}
+
+void
+Twitter::set_idle_callback(void (*callback)(void))
+{
+  this->idle_callback = callback;
+}
+
+void
+Twitter::set_lazy_clock(bool lazy)
+{
+  this->lazy_clock = lazy ? 1 : 0;
+}
+
+void
+Twitter::set_nonce_counter(int eeprom_address)
+{
+  uint32_t value;
+  int i, newest = -1;
+
+  /* The newest slot has the largest counter.  The slots hold
+     consecutive values, so they are compared in serial number
+     arithmetic to find the newest also after the counter has wrapped
+     around.  Erased slots read as 0xffffffff and are skipped. */
+  for (i = 0; i < TWITTER_NONCE_SLOTS; i++)
+    {
+      value = eeprom_read_long(eeprom_address + i * 4);
+      if (value != 0xffffffff
+          && (newest < 0 || (int32_t) (value - nonce_boot) > 0))
+        {
+          nonce_boot = value;
+          newest = i;
+        }
+    }
+
+  /* Write the advanced counter to the next slot so each slot is
+     written only every TWITTER_NONCE_SLOTS starts. */
+  if (newest < 0 || ++nonce_boot == 0xffffffff)
+    nonce_boot = 0;
+
+  eeprom_write_long(eeprom_address
+                    + ((newest + 1) % TWITTER_NONCE_SLOTS) * 4,
+                    nonce_boot);
+  nonce_count = 0;
 }
 
 bool
 Twitter::is_ready(void)
 {
-  if (basetime)
+  /* The response `Date' headers normally keep our clock in sync.
+     Query the time only if we have not seen them for too long. */
+  if (!clock.needs_sync() || (clock.is_set() && state != STATE_IDLE))
+    return true;
+
+  /* In the lazy mode the next status update synchronizes the
+     clock. */
+  if (lazy_clock)
     return true;
 
-  return query_time();
+  /* Do not block every loop() on a server we cannot reach. */
+  if (holding())
+    return clock.is_set();
+
+  if (!query_time())
+    {
+      hold(TWITTER_QUEUE_RETRY_DELAY);
+      return clock.is_set();
+    }
+
+  return true;
 }
 
 unsigned long
 Twitter::get_time(void)
 {
-  unsigned long now = millis();
-
-  if (now < last_millis)
-    /* Our internal clock wrapped around. */
-    basetime += 0xffffffffL / 1000L;
+  return clock.get_time();
+}
 
-  last_millis = now;
+uint64_t
+Twitter::get_time_ms(void)
+{
+  return clock.get_time_ms();
+}
 
-  return basetime + now / 1000L;
+SyncClock *
+Twitter::get_clock(void)
+{
+  return &clock;
 }
 
 bool
 Twitter::query_time(void)
 {
-  EthernetClient http;
-
-  if (!http.connect(ip, port))
+  if (!begin_request(true, false, 0))
     {
       println(PSTR("query_time: could not connect to server"));
       return false;
     }
 
-  http_print(&http, PSTR("HEAD "));
+  wait_response();
 
-  if (proxy)
+  return !clock.needs_sync();
+}
+
+bool
+Twitter::process_date_header(char *buffer)
+{
+  char *value = header_value(buffer, PSTR("Date"));
+
+  if (!value)
+    return false;
+
+  unsigned long now = parse_date(value);
+
+  if (now != 0)
+    /* We managed to parse the date header, now update our clock. */
+    clock.sync(now);
+
+  return true;
+}
+
+char *
+Twitter::header_value(char *buffer, const prog_char name[])
+{
+  size_t len = strlen_P(name);
+
+  if (strncasecmp_P(buffer, name, len) != 0 || buffer[len] != ':')
+    return 0;
+
+  for (buffer += len + 1; *buffer == ' '; buffer++)
+    ;
+
+  return buffer;
+}
+
+unsigned long
+Twitter::parse_date(const char *date)
+{
+  const char *cp = date;
+  int year, month, day, hour, minute, second;
+  long days;
+  unsigned long seconds;
+
+  /* The three formats of RFC 7231 section 7.1.1.1:
+
+       IMF-fixdate: Sun, 06 Nov 1994 08:49:37 GMT
+       RFC 850:     Sunday, 06-Nov-94 08:49:37 GMT
+       asctime:     Sun Nov  6 08:49:37 1994
+
+     The input is parsed in one pass without modifying it. */
+
+  while (*cp == ' ')
+    cp++;
+
+  /* Skip day name. */
+  while (isalpha(*cp))
+    cp++;
+
+  if (cp[0] == ',' && cp[1] == ' ')
     {
-      http_print(&http, PSTR("http://"));
-      http_print(&http, server);
+      cp = parse_digits(cp + 2, 2, &day);
+      if (!cp || (*cp != ' ' && *cp != '-'))
+        return 0;
+
+      month = parse_month(cp + 1);
+      if (!month || cp[4] != cp[0])
+        return 0;
+
+      if (cp[0] == ' ')
+        {
+          cp = parse_digits(cp + 5, 4, &year);
+        }
+      else
+        {
+          cp = parse_digits(cp + 5, 2, &year);
+
+          /* RFC 7231: two-digit years more than 50 years in the future
+             are in the past century.  This library cannot have dates
+             before 1970 anyway. */
+          year += year < 70 ? 2000 : 1900;
+        }
+
+      if (!cp || *cp++ != ' ')
+        return 0;
+
+      cp = parse_time(cp, &hour, &minute, &second);
+      if (!cp || strncmp_P(cp, PSTR(" GMT"), 4) != 0)
+        return 0;
+    }
+  else if (cp[0] == ' ')
+    {
+      month = parse_month(cp + 1);
+      if (!month || cp[4] != ' ')
+        return 0;
+
+      /* The day is padded with space. */
+      cp += 5;
+      if (*cp == ' ')
+        cp = parse_digits(cp + 1, 1, &day);
+      else
+        cp = parse_digits(cp, 2, &day);
+
+      if (!cp || *cp++ != ' ')
+        return 0;
+
+      cp = parse_time(cp, &hour, &minute, &second);
+      if (!cp || *cp++ != ' ')
+        return 0;
+
+      cp = parse_digits(cp, 4, &year);
+      if (!cp)
+        return 0;
+    }
+  else
+    {
+      return 0;
     }
 
-  http_println(&http, PSTR("/ HTTP/1.1"));
+  if (year < 1970 || year > 2106
+      || day < 1 || day > pgm_read_byte(days_in_month + month - 1)
+      || (month == 2 && day == 29
+          && (year % 4 != 0 || (year % 100 == 0 && year % 400 != 0)))
+      || hour > 23 || minute > 59 || second > 60)
+    return 0;
 
-  http_print(&http, PSTR("Host: "));
-  http_print(&http, server);
-  http_newline(&http);
+  days = days_from_civil(year, month, day);
+  seconds = ((unsigned long) hour * 60 + minute) * 60 + second;
 
-  http_println(&http, PSTR("Connection: close"));
+  /* The time must fit in 32 bits. */
+  if (days > MAX_TIME_DAYS
+      || (days == MAX_TIME_DAYS && seconds > MAX_TIME_SECONDS))
+    return 0;
 
-  http_newline(&http);
+  return (unsigned long) days * 86400UL + seconds;
+}
 
-  while (http.connected())
+const char *
+Twitter::parse_digits(const char *cp, uint8_t count, int *value)
+{
+  *value = 0;
+
+  for (; count > 0; count--, cp++)
     {
-      if (!read_line(&http, buffer, buffer_len))
-        break;
+      if (*cp < '0' || *cp > '9')
+        return 0;
 
-      if (buffer[0] == '\0')
-        break;
+      *value = *value * 10 + *cp - '0';
+    }
 
-      if (process_date_header(buffer))
-        break;
+  return cp;
+}
+
+const char *
+Twitter::parse_time(const char *cp, int *hour, int *minute, int *second)
+{
+  if (!(cp = parse_digits(cp, 2, hour)) || *cp++ != ':'
+      || !(cp = parse_digits(cp, 2, minute)) || *cp++ != ':')
+    return 0;
+
+  return parse_digits(cp, 2, second);
+}
+
+int
+Twitter::parse_month(const char *str)
+{
+  uint16_t packed;
+  int i;
+
+  if (!isalpha(str[0]) || !isalpha(str[1]) || !isalpha(str[2]))
+    return 0;
+
+  /* The low 5 bits of a letter are the same for both cases. */
+  packed = PACK_MONTH(str[0], str[1], str[2]);
+
+  for (i = 0; i < 12; i++)
+    if (pgm_read_word(months + i) == packed)
+      return i + 1;
+
+  return 0;
+}
+
+long
+Twitter::days_from_civil(int year, int month, int day)
+{
+  long era;
+  unsigned int yoe, doy;
+  unsigned long doe;
+
+  /* Closed form conversion from the proleptic Gregorian calendar, see
+     Howard Hinnant's `chrono-Compatible Low-Level Date Algorithms'.
+     Years start in March so the leap day is the last day of the
+     year. */
+  if (month <= 2)
+    year--;
+
+  era = year / 400;
+  yoe = year - era * 400;
+  doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  doe = yoe * 365UL + yoe / 4 - yoe / 100 + doy;
+
+  return era * 146097L + (long) doe - 719468L;
+}
+
+bool
+Twitter::post_status(const char *message)
+{
+  if (!begin_post(message))
+    return false;
+
+  /* The status was posted if the server accepted it, even if the
+     rest of the response would be lost. */
+  wait_response();
+
+  return is_success();
+}
+
+bool
+Twitter::begin_post(const char *message)
+{
+  if (state != STATE_IDLE)
+    return false;
+
+  sign_request(false, message);
+  resigned = 0;
+
+  /* Post message to twitter. */
+  if (!begin_request(false, false, message))
+    {
+      println(PSTR("Could not connect to server"));
+      return false;
     }
 
-  http.stop();
+  return true;
+}
 
-  return basetime != 0L;
+void
+Twitter::set_media_uri(const prog_char uri[])
+{
+  media_uri = uri;
 }
 
 bool
-Twitter::process_date_header(char *buffer)
+Twitter::post_media(const char *message, const prog_char media_type[],
+                    unsigned long media_len,
+                    size_t (*reader)(unsigned long offset, uint8_t *buffer,
+                                     size_t len))
 {
-  if ((buffer[0] != 'D' && buffer[0] != 'd')
-      || (buffer[1] != 'A' && buffer[1] != 'a')
-      || (buffer[2] != 'T' && buffer[2] != 't')
-      || (buffer[3] != 'E' && buffer[3] != 'e')
-      || (buffer[4] != ':'))
+  if (!begin_post_media(message, media_type, media_len, reader))
     return false;
 
-  unsigned long now = parse_date(buffer + 5);
+  wait_response();
 
-  if (now != 0)
+  return is_success();
+}
+
+bool
+Twitter::begin_post_media(const char *message, const prog_char media_type[],
+                          unsigned long media_len,
+                          size_t (*reader)(unsigned long offset,
+                                           uint8_t *buffer, size_t len))
+{
+  if (state != STATE_IDLE || media_uri == 0)
+    return false;
+
+  this->media_type = media_type;
+  this->media_len = media_len;
+  this->media_reader = reader;
+
+  /* The multipart body is not part of the signature base string. */
+  sign_request(true, message);
+  resigned = 0;
+
+  if (!begin_request(false, true, message))
     {
-      /* We managed to parse the date header, now update system
-         basetime. */
-      last_millis = millis();
-      basetime = now - last_millis / 1000L;
+      println(PSTR("Could not send media to server"));
+      return false;
     }
 
   return true;
 }
 
-long
-Twitter::parse_date(char *date)
+int
+Twitter::poll(void)
 {
-  tmElements_t tm;
-  char *cp;
-  char *end;
+  int result;
 
-  memset(&tm, 0, sizeof(tm));
+  if (state == STATE_IDLE)
+    return TWITTER_DONE;
 
-  /* We could use sscanf to parse the date string but it adds 26 bytes
-     to our SRAM consumption so let's use this adhoc parser. */
+  while (http.available() > 0)
+    {
+      last_activity = millis();
 
-  for (cp = date; *cp && *cp != ','; cp++)
-    ;
+      result = process_byte(http.read());
+      if (result != TWITTER_IN_PROGRESS)
+        return finish(result);
+    }
 
-  if (*cp != ',')
-    return 0;
+  if (!http.connected())
+    {
+      /* Content without length information ends when the server
+         closes the connection. */
+      if (state == STATE_BODY && remaining < 0)
+        return finish(TWITTER_DONE);
 
-  tm.Day = strtol(++cp, &end, 10);
+      return finish(TWITTER_ERROR);
+    }
 
-  if (end == cp)
-    return 0;
+  /* Unsigned subtraction keeps this correct over the millis()
+     wraparound. */
+  if (timeout && millis() - last_activity >= timeout)
+    {
+      println(PSTR("Timeout waiting for server response"));
+      return finish(TWITTER_ERROR);
+    }
 
-  cp = end;
+  return TWITTER_IN_PROGRESS;
+}
 
-  for (; *cp && *cp == ' '; cp++)
-    ;
-  if (!*cp)
-    return 0;
+int
+Twitter::get_response_code(void)
+{
+  return response_code;
+}
 
-  tm.Month = parse_month(cp, &end);
-  if (tm.Month <= 0)
-    return 0;
+const char *
+Twitter::get_status_id(void)
+{
+  return status_id;
+}
 
-  cp = end + 1;
+int
+Twitter::get_error_code(void)
+{
+  return error_code;
+}
 
-  tm.Year = strtol(cp, &end, 10) - 1970;
+void
+Twitter::response_value(void *context, uint8_t path, const char *value)
+{
+  Twitter *twitter = (Twitter *) context;
 
-  if (end == cp)
-    return 0;
+  switch (path)
+    {
+    case RESPONSE_PATH_ID_STR:
+      if (strlen(value) < sizeof(twitter->status_id))
+        strcpy(twitter->status_id, value);
+      break;
+
+    case RESPONSE_PATH_ERROR_CODE:
+      if (twitter->error_code == 0)
+        twitter->error_code = atoi(value);
+      break;
+    }
+}
 
-  cp = end + 1;
+void
+Twitter::set_queue(char *queue, size_t queue_len, int eeprom_address)
+{
+  size_t i;
 
-  tm.Hour = strtol(cp, &end, 10);
+  this->queue = queue;
+  this->queue_len = queue_len;
+  this->queue_used = 0;
+  this->queue_eeprom = eeprom_address;
 
-  if (end == cp)
-    return 0;
+  if (eeprom_address < 0)
+    return;
 
-  cp = end + 1;
+  /* Restore the messages that were pending when we were last
+     running.  An erased EEPROM reads as 0xffff which is caught by the
+     length check. */
+  i = EEPROM.read(eeprom_address);
+  i |= (size_t) EEPROM.read(eeprom_address + 1) << 8;
 
-  tm.Minute = strtol(cp, &end, 10);
+  if (i > queue_len || (i > 0 && EEPROM.read(eeprom_address + 1 + i) != 0))
+    return;
 
-  if (end == cp)
-    return 0;
+  for (queue_used = 0; queue_used < i; queue_used++)
+    queue[queue_used] = EEPROM.read(eeprom_address + 2 + queue_used);
+}
 
-  cp = end + 1;
+bool
+Twitter::queue_status(const char *message)
+{
+  size_t len = strlen(message) + 1;
 
-  tm.Second = strtol(cp, &end, 10);
+  if (queue_used + len > queue_len)
+    return false;
 
-  if (end == cp)
-    return 0;
+  memcpy(queue + queue_used, message, len);
+  queue_used += len;
 
-  return makeTime(tm);
+  save_queue();
+
+  return true;
 }
 
 int
-Twitter::parse_month(char *str, char **end)
+Twitter::process_queue(void)
 {
-  char *cp;
+  int result;
+  size_t len;
+
+  if (queue_querying)
+    {
+      result = poll();
+      if (result == TWITTER_IN_PROGRESS)
+        return queue_count();
+
+      queue_querying = 0;
+
+      if (!clock.is_set())
+        hold(TWITTER_QUEUE_RETRY_DELAY);
+
+      return queue_count();
+    }
+
+  if (queue_posting)
+    {
+      result = poll();
+      if (result == TWITTER_IN_PROGRESS)
+        return queue_count();
+
+      queue_posting = 0;
+
+      /* Remove the message from the queue if it was posted or if the
+         server rejected it permanently.  401 is kept: it can be a
+         timestamp rejection that the next post, signed with the clock
+         the response corrected, gets through.  408 and 429 are
+         temporary by definition. */
+      if (is_success()
+          || (400 <= response_code && response_code < 500
+              && response_code != 401 && response_code != 408
+              && response_code != 429))
+        {
+          len = strlen(queue) + 1;
+          memmove(queue, queue + len, queue_used - len);
+          queue_used -= len;
+
+          save_queue();
+        }
+      else
+        {
+          hold(TWITTER_QUEUE_RETRY_DELAY);
+        }
+
+      /* Honour the server's rate limits. */
+      if (retry_after >= 0)
+        hold(retry_after);
+      else if (rate_limit_remaining == 0 && clock.is_set()
+               && rate_limit_reset > get_time())
+        hold(rate_limit_reset - get_time());
+
+      return queue_count();
+    }
+
+  if (queue_used == 0 || state != STATE_IDLE || holding())
+    return queue_count();
+
+  /* The responses of the posts keep a set clock in sync.  An unset
+     clock is queried with a HEAD request that is processed like the
+     posts. */
+  if (!clock.is_set() && !lazy_clock)
+    {
+      if (begin_request(true, false, 0))
+        queue_querying = 1;
+      else
+        hold(TWITTER_QUEUE_RETRY_DELAY);
+
+      return queue_count();
+    }
+
+  if (begin_post(queue))
+    queue_posting = 1;
+  else
+    hold(TWITTER_QUEUE_RETRY_DELAY);
+
+  return queue_count();
+}
+
+int
+Twitter::queue_count(void)
+{
+  size_t i;
+  int count = 0;
+
+  for (i = 0; i < queue_used; i++)
+    if (queue[i] == '\0')
+      count++;
+
+  return count;
+}
+
+void
+Twitter::hold(unsigned long seconds)
+{
+  unsigned long now = millis();
+  unsigned long delay;
+
+  /* Keep the delay well inside the millis() range. */
+  if (seconds > 86400UL)
+    seconds = 86400UL;
+
+  delay = seconds * 1000UL;
+
+  if (holding() && hold_delay - (now - hold_start) >= delay)
+    return;
+
+  hold_start = now;
+  hold_delay = delay;
+}
+
+bool
+Twitter::holding(void)
+{
+  /* Unsigned subtraction keeps this correct over the millis()
+     wraparound. */
+  return millis() - hold_start < hold_delay;
+}
+
+void
+Twitter::save_queue(void)
+{
+  size_t i;
+
+  if (queue_eeprom < 0)
+    return;
+
+  eeprom_update(queue_eeprom, queue_used & 0xff);
+  eeprom_update(queue_eeprom + 1, queue_used >> 8);
+
+  for (i = 0; i < queue_used; i++)
+    eeprom_update(queue_eeprom + 2 + i, queue[i]);
+}
+
+void
+Twitter::eeprom_update(int address, uint8_t value)
+{
+  /* Skip unchanged bytes to save the EEPROM write cycles. */
+  if (EEPROM.read(address) != value)
+    EEPROM.write(address, value);
+}
+
+uint32_t
+Twitter::eeprom_read_long(int address)
+{
+  uint32_t value = 0;
   int i;
 
-  for (cp = str; *cp && *cp != ' '; cp++)
-    ;
+  for (i = 3; i >= 0; i--)
+    value = (value << 8) | EEPROM.read(address + i);
 
-  if (!*cp)
-    return 0;
+  return value;
+}
+
+void
+Twitter::eeprom_write_long(int address, uint32_t value)
+{
+  int i;
+
+  for (i = 0; i < 4; i++, value >>= 8)
+    eeprom_update(address + i, value & 0xff);
+}
+
+bool
+Twitter::open_connection(bool *reused)
+{
+  if (keep_alive && http.connected())
+    {
+      *reused = true;
+      return true;
+    }
+
+  *reused = false;
+
+  http.stop();
+
+  return http.connect(ip, port);
+}
+
+bool
+Twitter::begin_request(bool head, bool media, const char *message)
+{
+  bool reused;
+
+  if (state != STATE_IDLE || !open_connection(&reused))
+    return false;
+
+  this->head = head ? 1 : 0;
+  this->media = media ? 1 : 0;
+  this->reused = reused ? 1 : 0;
+  this->message = message;
+
+  if (!send_request())
+    {
+      /* The server is waiting for the rest of the request. */
+      http.stop();
+      return false;
+    }
+
+  start_response();
+
+  return true;
+}
+
+bool
+Twitter::send_request(void)
+{
+  if (head)
+    send_head();
+  else if (media)
+    return send_media(message);
+  else
+    send_status(message);
+
+  return true;
+}
+
+void
+Twitter::send_head(void)
+{
+  uint8_t out_buf[TWITTER_OUTPUT_BUFFER_LEN];
+  ClientBuffer out(&http, out_buf, sizeof(out_buf));
+
+  http_print(&out, PSTR("HEAD "));
+
+  if (proxy)
+    {
+      http_print(&out, PSTR("http://"));
+      http_print(&out, server);
+    }
+
+  http_println(&out, PSTR("/ HTTP/1.1"));
+
+  http_print(&out, PSTR("Host: "));
+  http_print(&out, server);
+  http_newline(&out);
+
+  http_connection_header(&out);
+
+  http_newline(&out);
+
+  out.flush();
+}
+
+void
+Twitter::send_status(const char *message)
+{
+  uint8_t out_buf[TWITTER_OUTPUT_BUFFER_LEN];
+  ClientBuffer out(&http, out_buf, sizeof(out_buf));
+
+  http_print(&out, PSTR("POST "));
+
+  if (proxy)
+    {
+      http_print(&out, PSTR("http://"));
+      http_print(&out, server);
+    }
+
+  http_print(&out, uri);
+  http_println(&out, PSTR(" HTTP/1.1"));
+
+  http_print(&out, PSTR("Host: "));
+  http_print(&out, server);
+  http_newline(&out);
+
+  http_println(&out,
+               PSTR("Content-Type: application/x-www-form-urlencoded"));
+  http_connection_header(&out);
+
+  http_authorization(&out);
+
+  /* The content `status=<message>' is URL encoded while it is
+     written so compute its length separately. */
+  sprintf(buffer, "%lu",
+          (unsigned long) (strlen_P(PSTR("status="))
+                           + url_encoded_length(message)));
+
+  http_print(&out, PSTR("Content-Length: "));
+  out.write(buffer);
+  http_newline(&out);
+
+  /* Header-body separator. */
+  http_newline(&out);
+
+  /* And finally content. */
+  http_print(&out, PSTR("status="));
+  http_print_encoded(&out, message);
+
+  out.flush();
+}
+
+bool
+Twitter::send_media(const char *message)
+{
+  unsigned long offset;
+  size_t len;
+  uint8_t out_buf[TWITTER_OUTPUT_BUFFER_LEN];
+  ClientBuffer out(&http, out_buf, sizeof(out_buf));
+
+  http_print(&out, PSTR("POST "));
+
+  if (proxy)
+    {
+      http_print(&out, PSTR("http://"));
+      http_print(&out, server);
+    }
 
-  *cp = '\0';
+  http_print(&out, media_uri);
+  http_println(&out, PSTR(" HTTP/1.1"));
 
-  *end = cp;
+  http_print(&out, PSTR("Host: "));
+  http_print(&out, server);
+  http_newline(&out);
 
-  for (i = 0; i < 12; i++)
-    if (strcmp_P(str, (char *) pgm_read_word(&(months[i]))) == 0)
-      return i + 1;
+  http_println(&out, PSTR("Content-Type: multipart/form-data; boundary="
+                          MULTIPART_BOUNDARY));
+  http_connection_header(&out);
 
-  return 0;
-}
+  http_authorization(&out);
 
-bool
-Twitter::post_status(const char *message)
-{
-  char *cp;
-  int i;
+  /* The parts are written as-is so the content length is the sum of
+     the constant parts and the variable data. */
+  sprintf(buffer, "%lu",
+          (unsigned long) (strlen_P(multipart_status) + strlen(message)
+                           + strlen_P(multipart_media)
+                           + strlen_P(media_type)
+                           + strlen_P(multipart_data)
+                           + strlen_P(multipart_end))
+          + media_len);
 
-  timestamp = get_time();
-  create_nonce();
+  http_print(&out, PSTR("Content-Length: "));
+  out.write(buffer);
+  http_newline(&out);
 
-  compute_authorization(message);
+  /* Header-body separator. */
+  http_newline(&out);
 
-  /* Post message to twitter. */
+  http_print(&out, multipart_status);
+  out.write(message);
 
-  EthernetClient http;
+  http_print(&out, multipart_media);
+  http_print(&out, media_type);
+  http_print(&out, multipart_data);
 
-  if (!http.connect(ip, port))
+  /* Stream the media through the work buffer.  The pieces larger than
+     the output buffer go straight to the client. */
+  for (offset = 0; offset < media_len; offset += len)
     {
-      println(PSTR("Could not connect to server"));
-      return false;
-    }
+      len = buffer_len;
+      if (media_len - offset < len)
+        len = media_len - offset;
 
-  http_print(&http, PSTR("POST "));
+      len = media_reader(offset, (uint8_t *) buffer, len);
+      if (len == 0)
+        return false;
 
-  if (proxy)
-    {
-      http_print(&http, PSTR("http://"));
-      http_print(&http, server);
+      out.write((uint8_t *) buffer, len);
     }
 
-  http_print(&http, uri);
-  http_println(&http, PSTR(" HTTP/1.1"));
+  http_print(&out, multipart_end);
 
-  http_print(&http, PSTR("Host: "));
-  http_print(&http, server);
-  http_newline(&http);
+  out.flush();
 
-  http_println(&http,
-               PSTR("Content-Type: application/x-www-form-urlencoded"));
-  http_println(&http, PSTR("Connection: close"));
+  return true;
+}
+
+void
+Twitter::http_authorization(Print *client)
+{
+  char *cp;
 
-  /* Authorization header. */
-  http_print(&http, PSTR("Authorization: OAuth oauth_consumer_key=\""));
+  http_print(client, PSTR("Authorization: OAuth oauth_consumer_key=\""));
 
   url_encode_pgm(buffer, consumer_key);
-  http.write(buffer);
+  client->write(buffer);
 
-  http_print(&http, PSTR("\",oauth_signature_method=\"HMAC-SHA1"));
-  http_print(&http, PSTR("\",oauth_timestamp=\""));
+  http_print(client, PSTR("\",oauth_signature_method=\"HMAC-SHA1"));
+  http_print(client, PSTR("\",oauth_timestamp=\""));
 
   sprintf(buffer, "%ld", timestamp);
-  http.write(buffer);
+  client->write(buffer);
 
-  http_print(&http, PSTR("\",oauth_nonce=\""));
+  http_print(client, PSTR("\",oauth_nonce=\""));
 
   hex_encode(buffer, nonce, sizeof(nonce));
-  http.write(buffer);
+  client->write(buffer);
 
-  http_print(&http, PSTR("\",oauth_version=\"1.0\",oauth_token=\""));
+  http_print(client, PSTR("\",oauth_version=\"1.0\",oauth_token=\""));
 
   if (access_token_pgm)
     url_encode_pgm(buffer, access_token.pgm);
   else
     url_encode_eeprom(buffer, access_token.eeprom);
 
-  http.write(buffer);
+  client->write(buffer);
 
-  http_print(&http, PSTR("\",oauth_signature=\""));
+  http_print(client, PSTR("\",oauth_signature=\""));
 
-  cp = base64_encode(buffer, signature, HASH_LENGTH);
+  cp = base64_encode(buffer, signature, SHA1_HASH_LENGTH);
   url_encode(cp + 1, buffer);
 
-  http.write(cp + 1);
+  client->write(cp + 1);
+
+  http_println(client, PSTR("\""));
+}
+
+void
+Twitter::start_response(void)
+{
+  state = STATE_STATUS;
+  line_pos = 0;
+  response_code = 0;
+  remaining = -1;
+  chunked = 0;
+  close_connection = keep_alive ? 0 : 1;
+  last_activity = millis();
+  retry_after = -1;
+  rate_limit_remaining = -1;
+  rate_limit_reset = 0;
+  status_id[0] = '\0';
+  error_code = 0;
+  parser.reset();
+}
 
-  http_println(&http, PSTR("\""));
+int
+Twitter::process_byte(uint8_t byte)
+{
+  switch (state)
+    {
+    case STATE_BODY:
+    case STATE_CHUNK_DATA:
+      if (!is_success())
+        Serial.write(byte);
 
-  /* Encode content. */
-  cp = url_encode(buffer, "status");
-  *cp++ = '=';
-  cp = url_encode(cp, message);
+      parser.feed(byte);
 
-  int content_length = cp - buffer;
-  sprintf(cp + 1, "%d", content_length);
+      if (remaining > 0 && --remaining == 0)
+        {
+          if (state == STATE_BODY)
+            return TWITTER_DONE;
 
-  http_print(&http, PSTR("Content-Length: "));
-  http.write(cp + 1);
-  http_newline(&http);
+          state = STATE_CHUNK_END;
+        }
+      return TWITTER_IN_PROGRESS;
 
-  /* Header-body separator. */
-  http_newline(&http);
+    default:
+      break;
+    }
 
-  /* And finally content. */
-  http.write(buffer);
+  /* All other states are line oriented. */
 
-  /* Read response status line. */
-  if (!read_line(&http, buffer, buffer_len) || buffer[0] == '\0')
+  if (byte != '\n')
     {
-      http.stop();
-      return false;
+      if (line_pos < buffer_len)
+        buffer[line_pos++] = byte;
+
+      return TWITTER_IN_PROGRESS;
     }
 
-  int response_code;
+  /* EOF found. */
+  if (line_pos < buffer_len)
+    {
+      if (line_pos > 0 && buffer[line_pos - 1] == '\r')
+        line_pos--;
 
-  /* HTTP/1.1 200 Success */
-  for (i = 0; buffer[i] && buffer[i] != ' '; i++)
-    ;
-  if (buffer[i])
-    response_code = atoi(buffer + i + 1);
+      buffer[line_pos] = '\0';
+    }
   else
-    response_code = 0;
+    {
+      buffer[buffer_len - 1] = '\0';
+    }
+
+  line_pos = 0;
 
-  bool success = (200 <= response_code && response_code < 300);
+  return process_line();
+}
 
-  if (!success)
-    Serial.println(buffer);
+int
+Twitter::process_line(void)
+{
+  char *value;
+  int i;
 
-  /* Skip header. */
-  while (true)
+  switch (state)
     {
-      if (!read_line(&http, buffer, buffer_len))
-        {
-          http.stop();
-          return false;
-        }
+    case STATE_STATUS:
+      if (buffer[0] == '\0')
+        return TWITTER_ERROR;
+
+      /* HTTP/1.1 200 Success */
+      for (i = 0; buffer[i] && buffer[i] != ' '; i++)
+        ;
+      if (buffer[i])
+        response_code = atoi(buffer + i + 1);
+      else
+        response_code = 0;
 
+      if (!is_success())
+        Serial.println(buffer);
+
+      state = STATE_HEADER;
+      break;
+
+    case STATE_HEADER:
       if (buffer[0] == '\0')
+        return start_body();
+
+      /* Update our clock from the response `Date' header. */
+      if (process_date_header(buffer))
         break;
 
-      /* Update our system basetime from the response `Date'
-         header. */
-      process_date_header(buffer);
+      if ((value = header_value(buffer, PSTR("Content-Length"))))
+        remaining = atol(value);
+      else if ((value = header_value(buffer, PSTR("Transfer-Encoding"))))
+        chunked = (strncasecmp_P(value, PSTR("chunked"), 7) == 0);
+      else if ((value = header_value(buffer, PSTR("Connection")))
+               && strncasecmp_P(value, PSTR("close"), 5) == 0)
+        close_connection = 1;
+      else if ((value = header_value(buffer, PSTR("Retry-After")))
+               && isdigit(value[0]))
+        retry_after = atol(value);
+      else if ((value = header_value(buffer,
+                                     PSTR("X-Rate-Limit-Remaining"))))
+        rate_limit_remaining = atol(value);
+      else if ((value = header_value(buffer, PSTR("X-Rate-Limit-Reset"))))
+        rate_limit_reset = strtoul(value, 0, 10);
+      break;
+
+    case STATE_CHUNK_SIZE:
+      remaining = strtol(buffer, 0, 16);
+      state = remaining > 0 ? STATE_CHUNK_DATA : STATE_TRAILER;
+      break;
+
+    case STATE_CHUNK_END:
+      state = STATE_CHUNK_SIZE;
+      break;
+
+    case STATE_TRAILER:
+      if (buffer[0] == '\0')
+        return TWITTER_DONE;
+      break;
+    }
+
+  return TWITTER_IN_PROGRESS;
+}
+
+int
+Twitter::start_body(void)
+{
+  if (head || response_code == 204 || response_code == 304)
+    return TWITTER_DONE;
+
+  if (chunked)
+    {
+      state = STATE_CHUNK_SIZE;
+      return TWITTER_IN_PROGRESS;
+    }
+
+  if (remaining == 0)
+    return TWITTER_DONE;
+
+  /* Without length information the content ends when the server
+     closes the connection. */
+  if (remaining < 0)
+    close_connection = 1;
+
+  state = STATE_BODY;
+
+  return TWITTER_IN_PROGRESS;
+}
+
+int
+Twitter::finish(int result)
+{
+  if (result == TWITTER_ERROR && reused
+      && state == STATE_STATUS && line_pos == 0)
+    {
+      /* The server closed our kept-alive connection before
+         responding.  Retry once with a fresh connection. */
+      http.stop();
+
+      if (http.connect(ip, port))
+        {
+          reused = 0;
+
+          if (send_request())
+            {
+              start_response();
+              return TWITTER_IN_PROGRESS;
+            }
+        }
     }
 
-  /* Handle content. */
-  while (http.connected())
+  if (result == TWITTER_DONE && !head && !resigned && response_code == 401
+      && labs((long) (get_time() - timestamp)) > TWITTER_TIMESTAMP_SKEW)
     {
-      while (http.available() > 0)
+      /* The server rejected our timestamp but its `Date' header has
+         now corrected our clock.  Sign the request again and retry
+         once. */
+      bool reused;
+
+      resigned = 1;
+
+      if (close_connection)
+        http.stop();
+
+      if (open_connection(&reused))
         {
-          uint8_t byte = http.read();
+          this->reused = reused ? 1 : 0;
+
+          sign_request(media, message);
+          if (send_request())
+            {
+              start_response();
+              return TWITTER_IN_PROGRESS;
+            }
 
-          if (!success)
-            Serial.write(byte);
+          result = TWITTER_ERROR;
         }
-      delay(100);
     }
 
-  http.stop();
+  if (close_connection || result != TWITTER_DONE)
+    http.stop();
 
-  if (!success)
+  if (response_code && !is_success())
     println(PSTR(""));
 
-  return success;
+  state = STATE_IDLE;
+
+  return result;
+}
+
+int
+Twitter::wait_response(void)
+{
+  int result;
+
+  while ((result = poll()) == TWITTER_IN_PROGRESS)
+    if (idle_callback)
+      idle_callback();
+
+  return result;
+}
+
+bool
+Twitter::is_success(void)
+{
+  return 200 <= response_code && response_code < 300;
+}
+
+bool
+Twitter::is_unreserved(char ch)
+{
+  uint8_t val = (uint8_t) ch;
+
+  return (pgm_read_byte(unreserved_table + (val >> 3)) >> (val & 7)) & 1;
 }
 
 char *
 Twitter::url_encode(char *buffer, char ch)
 {
-  if ('0' <= ch && ch <= '9'
-      || 'a' <= ch && ch <= 'z' || 'A' <= ch && ch <= 'Z'
-      || ch == '-' || ch == '.' || ch == '_' || ch == '~')
+  if (is_unreserved(ch))
     {
       *buffer++ = ch;
     }
   else
     {
-      int val = ((int) ch) & 0xff;
+      uint8_t val = (uint8_t) ch;
 
-      snprintf(buffer, 4, "%%%02X", val);
-      buffer += 3;
+      *buffer++ = '%';
+      *buffer++ = (char) pgm_read_byte(hex_table + (val >> 4));
+      *buffer++ = (char) pgm_read_byte(hex_table + (val & 0x0f));
     }
 
   *buffer = '\0';
@@ -452,6 +1386,19 @@ Twitter::url_encode(char *buffer, char ch)
   return buffer;
 }
 
+size_t
+Twitter::url_encoded_length(const char *data)
+{
+  size_t len = 0;
+  char ch;
+
+  /* Each escaped character takes two extra bytes. */
+  while ((ch = *data++))
+    len += 3 - 2 * is_unreserved(ch);
+
+  return len;
+}
+
 char *
 Twitter::url_encode(char *buffer, const char *data)
 {
@@ -488,141 +1435,289 @@ Twitter::url_encode_eeprom(char *buffer, int address)
 char *
 Twitter::hex_encode(char *buffer, const uint8_t *data, size_t data_len)
 {
-  size_t i;
-
-  for (i = 0; i < data_len; i++)
-    {
-      *buffer++ = (char) pgm_read_byte(hex_table + (data[i] >> 4));
-      *buffer++ = (char) pgm_read_byte(hex_table + (data[i] & 0x0f));
-    }
-
-  *buffer = '\0';
-
-  return buffer;
+  return Encoding::hex_encode_upper(buffer, data, data_len);
 }
 
 char *
 Twitter::base64_encode(char *buffer, const uint8_t *data, size_t data_len)
 {
-  int i, len;
-
-  for (i = 0, len = data_len; len > 0; i += 3, len -= 3)
-    {
-      unsigned long val;
-
-      val = (unsigned long) data[i] << 16;
-      if (len > 1)
-        val |= (unsigned long) data[i + 1] << 8;
-      if (len > 2)
-        val |= data[i + 2];
-
-      *buffer++ = (char) pgm_read_byte(base64_table + (val >> 18));
-      *buffer++ = (char) pgm_read_byte(base64_table + ((val >> 12) & 0x3f));
-      *buffer++ = (char) pgm_read_byte(base64_table + ((val >> 6) & 0x3f));
-      *buffer++ = (char) pgm_read_byte(base64_table + (val & 0x3f));
-    }
-
-  for (; len < 0; len++)
-    buffer[len] = '=';
-
-  *buffer = '\0';
-
-  return buffer;
+  return Encoding::base64_encode(buffer, data, data_len);
 }
 
 void
 Twitter::create_nonce(void)
 {
-  int i;
+  Sha1Class sha1;
+  uint32_t values[5];
+
+  /* Nonce must be unique for the request timestamp value.  The boot
+     and request counters make it unique and the clock jitter and the
+     previous signature make it unpredictable. */
+  values[0] = nonce_boot;
+  values[1] = nonce_count++;
+  values[2] = timestamp;
+  values[3] = micros();
+  values[4] = millis();
+
+  sha1.write((uint8_t *) values, sizeof(values));
+  sha1.write(signature, sizeof(signature));
+
+  memcpy(nonce, sha1.result(), sizeof(nonce));
+}
+
+void
+Twitter::sign_request(bool media, const char *message)
+{
+  timestamp = get_time();
+  create_nonce();
+
+  if (media)
+    compute_authorization(media_uri, 0);
+  else
+    compute_authorization(uri, message);
+}
 
-  /* Nonce must be unique for the request timestamp value, so let's
-     use the timestamp as our random seed. */
-  srandom(timestamp);
+const uint8_t *
+Twitter::sign_status(unsigned long when, const char *message)
+{
+  timestamp = when;
+  create_nonce();
+  compute_authorization(uri, message);
 
-  for (i = 0; i < sizeof(nonce); i++)
-    nonce[i] = (uint8_t) random();
+  return signature;
 }
 
 void
-Twitter::compute_authorization(const char *message)
+Twitter::compute_authorization(const prog_char uri[], const char *message)
 {
+  Sha1Class sha1;
   char *cp = buffer;
+  /* The cached prefix covers the status update URI. */
+  bool prefix = (uri == this->uri);
 
-  /* Compute key and init HMAC. */
+  hmac = &sha1;
 
-  cp = url_encode_pgm(buffer, consumer_secret);
-  *cp++ = '&';
+  if (auth_cached && prefix)
+    {
+      /* The secrets and the end-point have not changed since the last
+         request.  Resume the HMAC from the state after the constant
+         prefix of the signature base string and skip the prefix bytes
+         it covers. */
+      sha1.initHmacKeyState(hmac_key);
+      sha1.initMidstate(prefix_state, prefix_length);
+
+      auth_skip = prefix_length - SHA_BLOCK_LENGTH;
+    }
+  else if (auth_cached)
+    {
+      sha1.initHmacKeyState(hmac_key);
 
-  if (access_token_pgm)
-    cp = url_encode_pgm(cp, token_secret.pgm);
+      auth_skip = 0;
+    }
   else
-    cp = url_encode_eeprom(cp, token_secret.eeprom);
+    {
+      /* Compute key and init HMAC. */
 
-  Sha1.initHmac((uint8_t *) buffer, cp - buffer);
+      cp = url_encode_pgm(buffer, consumer_secret);
+      *cp++ = '&';
+
+      if (access_token_pgm)
+        cp = url_encode_pgm(cp, token_secret.pgm);
+      else
+        cp = url_encode_eeprom(cp, token_secret.eeprom);
+
+      sha1.initHmac((uint8_t *) buffer, cp - buffer);
+
+      sha1.getHmacKeyState(hmac_key);
+
+      auth_skip = 0;
+    }
+
+  /* The rest of the signature base string is URL encoded straight
+     into the HMAC so we do not need to stage it in the work
+     buffer. */
 
   auth_add_pgm(PSTR("POST&http%3A%2F%2F"));
   auth_add_pgm(server);
-
-  url_encode_pgm(buffer, uri);
-  auth_add(buffer);
+  auth_add_encoded_pgm(uri, false);
 
   auth_add('&');
 
   auth_add_pgm(PSTR("oauth_consumer_key"));
   auth_add_value_separator();
-  url_encode_pgm(buffer, consumer_key);
-  auth_add(buffer);
+  auth_add_encoded_pgm(consumer_key, true);
 
-  cp = hex_encode(buffer, nonce, sizeof(nonce));
+  if (!auth_cached && prefix)
+    {
+      /* Everything above is the same for all status updates. */
+      prefix_length = sha1.getMidstate(prefix_state);
+      auth_cached = 1;
+    }
 
-  auth_add_param(PSTR("oauth_nonce"), buffer, cp + 1);
+  hex_encode(buffer, nonce, sizeof(nonce));
+  auth_add_param(PSTR("oauth_nonce"), buffer);
 
-  auth_add_param(PSTR("oauth_signature_method"), "HMAC-SHA1", buffer);
+  auth_add_param(PSTR("oauth_signature_method"), "HMAC-SHA1");
 
   sprintf(buffer, "%ld", timestamp);
-  auth_add_param(PSTR("oauth_timestamp"), buffer, cp + 1);
+  auth_add_param(PSTR("oauth_timestamp"), buffer);
 
   auth_add_param_separator();
 
   auth_add_pgm(PSTR("oauth_token"));
   auth_add_value_separator();
   if (access_token_pgm)
-    url_encode_pgm(buffer, access_token.pgm);
+    auth_add_encoded_pgm(access_token.pgm, true);
   else
-    url_encode_eeprom(buffer, access_token.eeprom);
-  auth_add(buffer);
+    auth_add_encoded_eeprom(access_token.eeprom, true);
+
+  auth_add_param(PSTR("oauth_version"), "1.0");
+
+  /* The parameters of a multipart body are not signed. */
+  if (message)
+    auth_add_param(PSTR("status"), message);
+
+  memcpy(signature, sha1.resultHmac(), sizeof(signature));
+  hmac = 0;
+}
 
-  auth_add_param(PSTR("oauth_version"), "1.0", buffer);
+void
+Twitter::auth_add(const char *data, size_t len)
+{
+  if (auth_skip >= len)
+    {
+      auth_skip -= len;
+      return;
+    }
 
-  cp = url_encode(buffer, message);
-  auth_add_param(PSTR("status"), buffer, cp + 1);
+  data += auth_skip;
+  len -= auth_skip;
+  auth_skip = 0;
 
-  signature = Sha1.resultHmac();
+  hmac->update((const uint8_t *) data, len);
 }
 
 void
 Twitter::auth_add(char ch)
 {
-  Sha1.write(ch);
+  auth_add(&ch, 1);
 }
 
 void
 Twitter::auth_add(const char *str)
 {
-  Sha1.print(str);
+  auth_add(str, strlen(str));
 }
 
 void
 Twitter::auth_add_pgm(const prog_char str[])
 {
-  uint8_t c;
+  char chunk[AUTH_CHUNK_LEN];
+  uint8_t len = 0;
+  char ch;
 
-  while ((c = pgm_read_byte(str++)))
-    Sha1.write(c);
+  while ((ch = pgm_read_byte(str++)))
+    {
+      chunk[len++] = ch;
+      if (len == sizeof(chunk))
+        {
+          auth_add(chunk, len);
+          len = 0;
+        }
+    }
+
+  auth_add(chunk, len);
+}
+
+char *
+Twitter::auth_encode(char *buffer, char ch, bool twice)
+{
+  uint8_t val;
+
+  if (is_unreserved(ch))
+    {
+      *buffer++ = ch;
+      return buffer;
+    }
+
+  /* The second encoding pass turns the `%' of the first pass into
+     `%25'. */
+  *buffer++ = '%';
+  if (twice)
+    {
+      *buffer++ = '2';
+      *buffer++ = '5';
+    }
+
+  val = (uint8_t) ch;
+  *buffer++ = (char) pgm_read_byte(hex_table + (val >> 4));
+  *buffer++ = (char) pgm_read_byte(hex_table + (val & 0x0f));
+
+  return buffer;
+}
+
+void
+Twitter::auth_add_encoded(const char *str, bool twice)
+{
+  char chunk[AUTH_CHUNK_LEN];
+  char *cp = chunk;
+  char ch;
+
+  while ((ch = *str++))
+    {
+      if (cp > chunk + sizeof(chunk) - AUTH_ENCODED_MAX)
+        {
+          auth_add(chunk, cp - chunk);
+          cp = chunk;
+        }
+      cp = auth_encode(cp, ch, twice);
+    }
+
+  auth_add(chunk, cp - chunk);
+}
+
+void
+Twitter::auth_add_encoded_pgm(const prog_char str[], bool twice)
+{
+  char chunk[AUTH_CHUNK_LEN];
+  char *cp = chunk;
+  char ch;
+
+  while ((ch = pgm_read_byte(str++)))
+    {
+      if (cp > chunk + sizeof(chunk) - AUTH_ENCODED_MAX)
+        {
+          auth_add(chunk, cp - chunk);
+          cp = chunk;
+        }
+      cp = auth_encode(cp, ch, twice);
+    }
+
+  auth_add(chunk, cp - chunk);
+}
+
+void
+Twitter::auth_add_encoded_eeprom(int address, bool twice)
+{
+  char chunk[AUTH_CHUNK_LEN];
+  char *cp = chunk;
+  char ch;
+
+  while ((ch = EEPROM.read(address++)))
+    {
+      if (cp > chunk + sizeof(chunk) - AUTH_ENCODED_MAX)
+        {
+          auth_add(chunk, cp - chunk);
+          cp = chunk;
+        }
+      cp = auth_encode(cp, ch, twice);
+    }
+
+  auth_add(chunk, cp - chunk);
 }
 
 void
-Twitter::auth_add_param(const prog_char key[], const char *value, char *workbuf)
+Twitter::auth_add_param(const prog_char key[], const char *value)
 {
   /* Add separator.  We know that this method is not used to add the
      first parameter. */
@@ -632,8 +1727,7 @@ Twitter::auth_add_param(const prog_char key[], const char *value, char *workbuf)
 
   auth_add_value_separator();
 
-  url_encode(workbuf, value);
-  auth_add(workbuf);
+  auth_add_encoded(value, true);
 }
 
 void
@@ -649,7 +1743,7 @@ Twitter::auth_add_value_separator(void)
 }
 
 void
-Twitter::http_print(Client *client, const prog_char str[])
+Twitter::http_print(Print *client, const prog_char str[])
 {
   uint8_t c;
 
@@ -661,19 +1755,38 @@ Twitter::http_print(Client *client, const prog_char str[])
 }
 
 void
-Twitter::http_println(Client *client, const prog_char str[])
+Twitter::http_print_encoded(Print *client, const char *data)
+{
+  char buf[4];
+  char ch;
+
+  while ((ch = *data++))
+    client->write((uint8_t *) buf, url_encode(buf, ch) - buf);
+}
+
+void
+Twitter::http_println(Print *client, const prog_char str[])
 {
   http_print(client, str);
   http_newline(client);
 }
 
 void
-Twitter::http_newline(Client *client)
+Twitter::http_newline(Print *client)
 {
   client->write('\r');
   client->write('\n');
 }
 
+void
+Twitter::http_connection_header(Print *client)
+{
+  if (keep_alive)
+    http_println(client, PSTR("Connection: keep-alive"));
+  else
+    http_println(client, PSTR("Connection: close"));
+}
+
 void
 Twitter::println(const prog_char str[])
 {
@@ -688,42 +1801,3 @@ Twitter::println(const prog_char str[])
   Serial.write('\r');
   Serial.write('\n');
 }
-
-bool
-Twitter::read_line(Client *client, char *buffer, size_t buflen)
-{
-  size_t pos = 0;
-
-  while (client->connected())
-    {
-      while (client->available() > 0)
-        {
-          uint8_t byte = client->read();
-
-          if (byte == '\n')
-            {
-              /* EOF found. */
-              if (pos < buflen)
-                {
-                  if (pos > 0 && buffer[pos - 1] == '\r')
-                    pos--;
-
-                  buffer[pos] = '\0';
-                }
-              else
-                {
-                  buffer[buflen - 1] = '\0';
-                }
-
-              return true;
-            }
-
-          if (pos < buflen)
-            buffer[pos++] = byte;
-        }
-
-      delay(100);
-    }
-
-  return false;
-}
@@ -36,6 +36,44 @@
 #include <sha1.h>
 #include <Ethernet.h>
 #include <Time.h>
+#include <ClientBuffer.h>
+#include <Encoding.h>
+#include <JSONParser.h>
+#include "SyncClock.h"
+
+/* The default time in milliseconds to wait for response data from the
+   server. */
+#define TWITTER_DEFAULT_TIMEOUT 15000L
+
+/* The size of the write-combining buffer for HTTP requests.  It is
+   allocated from stack while a request is sent. */
+#define TWITTER_OUTPUT_BUFFER_LEN 128
+
+/* The time in seconds to wait before retrying a queued message after
+   a failed post, or a time query after a failed one. */
+#define TWITTER_QUEUE_RETRY_DELAY 60L
+
+/* The difference in seconds between the request timestamp and the
+   server time above which a `401 Unauthorized' response is taken as
+   a timestamp rejection and the request is signed again. */
+#define TWITTER_TIMESTAMP_SKEW 30L
+
+/* The number of EEPROM slots the nonce boot counter rotates over to
+   spread the EEPROM wear.  Each slot takes 4 bytes. */
+#define TWITTER_NONCE_SLOTS 8
+
+/* The size of the status ID buffer.  The IDs are 64-bit numbers of
+   up to 20 digits. */
+#define TWITTER_STATUS_ID_LEN 21
+
+/* The size of the buffer for the key paths and values of the response
+   parser.  It must hold `id_str' and the longest status ID. */
+#define TWITTER_PARSER_BUFFER_LEN 32
+
+/* Return values of the poll() method. */
+#define TWITTER_ERROR		-1
+#define TWITTER_IN_PROGRESS	0
+#define TWITTER_DONE		1
 
 class Twitter
 {
@@ -75,25 +113,179 @@ public:
      `access_token', `token_secret'. */
   void set_account_id(int access_token, int token_secret);
 
+  /* Enable or disable HTTP keep-alive.  When enabled, the twitter
+     instance keeps its connection to the HTTP end-point open between
+     requests and reuses it for subsequent post_status() and time
+     queries.  If the kept-alive connection has been closed by the
+     server, the request is retried once with a fresh connection.  By
+     default the keep-alive is disabled and each request uses a new
+     connection. */
+  void set_keep_alive(bool keep_alive);
+
+  /* Set the time in milliseconds to wait for response data from the
+     server to `timeout'.  The value 0 waits as long as the server
+     keeps the connection open. */
+  void set_timeout(unsigned long timeout);
+
+  /* Set the function `callback' to be called repeatedly while the
+     twitter instance is waiting for response data from the server.
+     The callback can be used to keep sampling sensors during the
+     request.  The value 0 disables the callback. */
+  void set_idle_callback(void (*callback)(void));
+
+  /* Enable or disable the lazy clock synchronization.  When enabled,
+     is_ready() never sends a separate time query; the first status
+     update is signed with the best time we know and the `Date' header
+     of its response sets our clock.  If the server rejects the
+     request timestamp, the request is signed again with the corrected
+     time and retried once.  This saves one request at start-up.  By
+     default the lazy synchronization is disabled. */
+  void set_lazy_clock(bool lazy);
+
+  /* Keep the nonce boot counter in EEPROM at the address
+     `eeprom_address', using TWITTER_NONCE_SLOTS * 4 bytes.  The
+     counter is advanced once per call, normally once per start-up, so
+     the nonces stay unique across restarts even if the clock has not
+     been synchronized yet.  Without the counter the nonces are unique
+     within one run. */
+  void set_nonce_counter(int eeprom_address);
+
   /* Tests if this twitter instance is ready for twitter
      communication.  The method returns true if twitter messages can
      be sent and false if the twitter instance is still initializing.
      You should keep calling this method from your loop() and do your
-     twitter interactions when this method returns true. */
+     twitter interactions when this method returns true.  The method
+     queries the server time if the predicted error of our clock has
+     grown too large; normally the clock is kept in sync from the
+     responses of the status updates.  The query blocks until the
+     server has responded.  After a failed query the method does not
+     query again for TWITTER_QUEUE_RETRY_DELAY seconds.  With the lazy
+     clock synchronization the method returns true without querying
+     the time. */
   bool is_ready(void);
 
   /* Gets the current UTC time.  The twitter module queries and
      maintains the UTC time based on server HTTP `Date' response
      header.  The method returns the current UTC Unix time in seconds,
      or 0 if the time has not been resolved yet.  This will return a
-     non-zero value after init() has returned true. */
+     non-zero value after is_ready() has returned true, unless the lazy
+     clock synchronization is enabled. */
   unsigned long get_time(void);
 
+  /* Gets the current UTC time as Unix time in milliseconds, or 0 if
+     the time has not been resolved yet. */
+  uint64_t get_time_ms(void);
+
+  /* Gets the clock of this twitter instance, e.g. for setting its
+     maximum error. */
+  SyncClock *get_clock(void);
+
   /* Post status message `message' to twitter.  The message must be
      UTF-8 encoded.  The method returns true if the status message was
-     posted and false on error. */
+     posted and false on error.  The method blocks until the request
+     has completed; see begin_post() for a non-blocking variant. */
   bool post_status(const char *message);
 
+  /* Start posting status message `message' to twitter without waiting
+     for the server response.  The message must be UTF-8 encoded and
+     it must remain valid until the request has completed.  The
+     method returns true if the request was sent and false on error or
+     if a request is already in progress.  You must call poll() from
+     your loop() until the request completes. */
+  bool begin_post(const char *message);
+
+  /* Set the API URI for status updates with media (e.g.
+     `/1/statuses/update_with_media.json') to `uri'.  The requests go
+     to the server and connection end-point of
+     set_twitter_endpoint(). */
+  void set_media_uri(const prog_char uri[]);
+
+  /* Post status message `message' with the media of `media_len' bytes
+     and MIME type `media_type' (e.g. `image/png') to twitter.  The
+     media is streamed in a multipart/form-data request body from the
+     function `reader' that is called to copy at most `len' bytes of
+     the media from the offset `offset' into `buffer'.  The reader
+     returns the number of bytes copied; it can return less than `len'
+     but it must not return 0 before the end of the media.  The media
+     is read in chunks of the work buffer size and it is never held in
+     memory as a whole.  The same range can be read more than once if
+     the request is retried.  The method returns true if the status
+     message was posted and false on error.  The method blocks until
+     the request has completed. */
+  bool post_media(const char *message, const prog_char media_type[],
+                  unsigned long media_len,
+                  size_t (*reader)(unsigned long offset, uint8_t *buffer,
+                                   size_t len));
+
+  /* Start posting status message `message' with media without waiting
+     for the server response.  The arguments are as in post_media()
+     and they must remain valid until the request has completed.  The
+     method returns as begin_post() and you must call poll() from your
+     loop() until the request completes. */
+  bool begin_post_media(const char *message, const prog_char media_type[],
+                        unsigned long media_len,
+                        size_t (*reader)(unsigned long offset,
+                                         uint8_t *buffer, size_t len));
+
+  /* Process the server response of the request started with
+     begin_post().  The method never blocks; it consumes the response
+     data that is currently available and returns.  The method
+     returns TWITTER_IN_PROGRESS if the request is still in progress,
+     TWITTER_DONE if the response has been received, and TWITTER_ERROR
+     on error.  The HTTP status of a completed request is available
+     from get_response_code().  If no request is active, the method
+     returns TWITTER_DONE. */
+  int poll(void);
+
+  /* Get the HTTP status code of the last request, or 0 if the request
+     failed before a status was received. */
+  int get_response_code(void);
+
+  /* Get the ID of the status posted by the last request as a
+     c-string.  The ID is the `id_str' of the response; the string is
+     empty if the response did not have it. */
+  const char *get_status_id(void);
+
+  /* Get the first Twitter API error code, `errors[].code', of the
+     response of the last request, or 0 if the response did not have
+     one. */
+  int get_error_code(void);
+
+  /* Set the outbound message queue storage to `queue', `queue_len'.
+     The queue holds the pending messages as consecutive c-strings so
+     its size limits the total length of the pending messages.  If the
+     argument `eeprom_address' is not negative, the queue is also kept
+     in EEPROM at that address, using `queue_len' + 2 bytes, and the
+     messages pending from the previous run are restored. */
+  void set_queue(char *queue, size_t queue_len, int eeprom_address);
+
+  /* Add status message `message' into the outbound message queue.
+     The method returns true if the message was queued and false if
+     the queue is full. */
+  bool queue_status(const char *message);
+
+  /* Post the queued messages.  You should keep calling this method
+     from your loop().  The method never waits for server responses;
+     like begin_post() it blocks only while it connects and sends a
+     request.  If the clock has not been set, the method first queries
+     the time the same way (unless the lazy clock synchronization is
+     enabled); a set clock is kept in sync by the responses of the
+     posts.
+
+     The messages are posted one at a time in the order they were
+     queued.  A message is removed from the queue when it has been
+     posted or when the server rejects it permanently with a 4xx
+     status other than 401 (Unauthorized, e.g. a timestamp outside
+     the allowed skew), 408 (Request Timeout) or 429 (Too Many
+     Requests).  After those, other failures, and failed time queries
+     the method waits TWITTER_QUEUE_RETRY_DELAY seconds before trying
+     again.  It also holds the posting when the server signals its
+     rate limit with the `Retry-After' or `X-Rate-Limit-*' headers.
+     Enable keep-alive to post consecutive messages over the same
+     connection.  The method returns the number of pending
+     messages. */
+  int process_queue(void);
+
   /* URL encode character `ch' into the buffer `buffer'.  The method
      returns a pointer to the next byte after the encoded value. */
   static char *url_encode(char *buffer, char ch);
@@ -102,6 +294,12 @@ public:
      returns a pointer to the next byte after the encoded value. */
   static char *url_encode(char *buffer, const char *data);
 
+  /* Compute the length of c-string `data' after URL encoding,
+     without the terminating null character.  This can be used to
+     size the buffer for url_encode() or the HTTP Content-Length
+     without encoding the data. */
+  static size_t url_encoded_length(const char *data);
+
   /* URL encode program memory c-string `data' into the buffer
      `buffer'.  The method returns a pointer to the next byte after
      the encoded value. */
@@ -112,6 +310,10 @@ public:
      to the next byte after the encoded value. */
   static char *url_encode_eeprom(char *buffer, int address);
 
+  /* Tests if the character `ch' belongs to the unreserved set that
+     is passed through URL encoding as-is. */
+  static bool is_unreserved(char ch);
+
   /* Hex encode binary data `data', `data_len' into the buffer
      `buffer'.  The method returns a pointer to the next byte after
      the encoded value. */
@@ -123,20 +325,47 @@ public:
   static char *base64_encode(char *buffer, const uint8_t *data,
                              size_t data_len);
 
+  /* Parse the value of the HTTP Date header `date'.  The method
+     accepts the IMF-fixdate format and the obsolete RFC 850 and
+     asctime formats.  The method returns the Unix time value in
+     seconds or 0 if the header could not be parsed or if the time is
+     past the 32-bit range that ends in 2106. */
+  static unsigned long parse_date(const char *date);
+
+  /* Sign a status update with the message `message' at the time
+     `when' as a post would, without a network connection.  The
+     method returns the signature (SHA1_HASH_LENGTH bytes).  This is
+     for the benchmarks that measure the signing cost; the posting
+     methods sign their requests themselves. */
+  const uint8_t *sign_status(unsigned long when, const char *message);
+
 private:
 
-  /* Create a random nonce into the member `nonce.  The method uses
-     `timestamp' as its random seed so you must set it before calling
-     this method. */
+  /* Create a random nonce into the member `nonce'.  The nonce is a
+     Sha1 hash of the boot and request counters, the `timestamp'
+     member, the current micros() and millis() values, and the
+     previous signature, so the nonces do not repeat even if many
+     requests are sent within the same second. */
   void create_nonce(void);
 
-  /* Compute OAuth signature for the status message `message'.  The
-     method uses the current state from consumer and access tokens and
-     from `timestamp' and `nonce' member.  The computed signature will
-     remain in the global `Sha1' instance and is pointed by
-     `signature'.  You must not use the `Sha1' instance before you
-     have consumed value. */
-  void compute_authorization(const char *message);
+  /* Compute OAuth signature for a POST request to the API URI `uri'
+     with the status message `message'.  If `message' is 0, the
+     request has a multipart body and only the OAuth parameters are
+     signed.  The method uses the current state from consumer and
+     access tokens and from `timestamp' and `nonce' member.  The
+     computed signature is stored in the `signature' member. */
+  void compute_authorization(const prog_char uri[], const char *message);
+
+  /* Set the `timestamp' and `nonce' members for a new request and
+     compute its authorization for the status message `message'.  The
+     argument `media' selects the status update with media. */
+  void sign_request(bool media, const char *message);
+
+  /* Add `len' bytes of `data' into the authorization signature hmac.
+     All signature base string data goes through this method.  The
+     other methods collect their bytes into a chunk on the stack and
+     add it with one call. */
+  void auth_add(const char *data, size_t len);
 
   /* Add character `ch' into the authorization signature hmac. */
   void auth_add(char ch);
@@ -148,10 +377,31 @@ private:
      hmac. */
   void auth_add_pgm(const prog_char str[]);
 
+  /* URL encode character `ch' into buffer `buffer' and return a
+     pointer to the end of the encoded data.  If the argument `twice'
+     is true, the character is encoded twice, as required for the
+     parameter values of the signature base string.  The encoding
+     takes at most 5 bytes: `%25' and two hex digits. */
+  static char *auth_encode(char *buffer, char ch, bool twice);
+
+  /* Add string `str' URL encoded into the authorization signature
+     hmac.  The argument `twice' is as in auth_encode(). */
+  void auth_add_encoded(const char *str, bool twice);
+
+  /* Add program memory string `str' URL encoded into the
+     authorization signature hmac.  The argument `twice' is as in
+     auth_encode(). */
+  void auth_add_encoded_pgm(const prog_char str[], bool twice);
+
+  /* Add EEPROM memory string that starts from address `address' URL
+     encoded into the authorization signature hmac.  The argument
+     `twice' is as in auth_encode(). */
+  void auth_add_encoded_eeprom(int address, bool twice);
+
   /* Add request parameter `key', `value' into the authorization
-     signature hmac.  The argument `workbuf' specifies a working
-     buffer for the method. */
-  void auth_add_param(const char *key, const char *value, char *workbuf);
+     signature hmac.  The value is URL encoded on the fly so it does
+     not need any working buffer. */
+  void auth_add_param(const prog_char key[], const char *value);
 
   /* Add authorization parameter separator into the authorization
      signature hmac. */
@@ -161,52 +411,172 @@ private:
      hmac. */
   void auth_add_value_separator(void);
 
+  /* Ensure that the member `http' is connected to the HTTP
+     end-point.  The method sets `reused' to true if an existing
+     kept-alive connection was reused and to false if a new connection
+     was opened.  The method returns true if the connection is open
+     and false on error. */
+  bool open_connection(bool *reused);
+
+  /* Send the status update request for the message `message' to the
+     connection `http'.  The method uses the `timestamp', `nonce' and
+     `signature' members so you must compute the authorization before
+     calling this method.  The request is sent through a
+     write-combining buffer. */
+  void send_status(const char *message);
+
+  /* Send the status update request with media for the message
+     `message' to the connection `http'.  The media is described by
+     the `media_*' members.  As with send_status(), you must compute
+     the authorization before calling this method.  The method returns
+     true if the request was sent and false if the media reader failed
+     before the end of the media. */
+  bool send_media(const char *message);
+
+  /* Print the OAuth `Authorization' request header to the output
+     stream `client'.  The header uses the `timestamp', `nonce' and
+     `signature' members. */
+  void http_authorization(Print *client);
+
+  /* Send the HEAD request for the server time to the connection
+     `http'.  The request is sent through a write-combining buffer so
+     that it goes out in as few packets as possible. */
+  void send_head(void);
+
+  /* Open connection and send a request.  The argument `head' selects
+     between the time query and the status update for the message
+     `message'.  The argument `media' selects the status update with
+     media.  The method returns true if the request was sent and false
+     on error. */
+  bool begin_request(bool head, bool media, const char *message);
+
+  /* Send the request selected by the `head', `media' and `message'
+     members to the connection `http'.  The method returns true if the
+     request was sent and false on error. */
+  bool send_request(void);
+
+  /* Reset the response processing state for a new response. */
+  void start_response(void);
+
+  /* Process the response byte `byte'.  The method returns one of the
+     poll() return values. */
+  int process_byte(uint8_t byte);
+
+  /* Process the response line in the work buffer.  The method returns
+     one of the poll() return values. */
+  int process_line(void);
+
+  /* Select the content processing state after the response header.
+     The method returns one of the poll() return values. */
+  int start_body(void);
+
+  /* Finish the current request with the result `result'.  The method
+     closes the connection unless it can be kept alive, or retries the
+     request once if a reused connection was closed by the server.
+     The method returns the final poll() return value. */
+  int finish(int result);
+
+  /* Poll the current request until it completes, calling the idle
+     callback between the polls.  The method returns the final poll()
+     return value. */
+  int wait_response(void);
+
+  /* Tests if the last response had a success status code. */
+  bool is_success(void);
+
+  /* Store the response value `value' of the key path `path' of
+     `response_paths'.  This is the callback of the response parser
+     for the twitter instance `context'. */
+  static void response_value(void *context, uint8_t path,
+                             const char *value);
+
+  /* Count the messages in the outbound message queue. */
+  int queue_count(void);
+
+  /* Do not start new requests from the queue or time queries for
+     `seconds' seconds.  An earlier hold that ends later is kept. */
+  void hold(unsigned long seconds);
+
+  /* Tests if the requests are being held. */
+  bool holding(void);
+
+  /* Save the outbound message queue to EEPROM if persistence is
+     enabled. */
+  void save_queue(void);
+
+  /* Write `value' to the EEPROM address `address' unless it already
+     has that value. */
+  static void eeprom_update(int address, uint8_t value);
+
+  /* Read a 32-bit little-endian value from the EEPROM address
+     `address'. */
+  static uint32_t eeprom_read_long(int address);
+
+  /* Write a 32-bit little-endian value `value' to the EEPROM address
+     `address'. */
+  static void eeprom_write_long(int address, uint32_t value);
+
+  /* Print the `Connection' request header, matching the keep-alive
+     setting, to the output stream `client'. */
+  void http_connection_header(Print *client);
+
   /* Print program memory string `str' to the output stream of the
      HTTP client `client'. */
-  static void http_print(Client *client, const prog_char str[]);
+  static void http_print(Print *client, const prog_char str[]);
+
+  /* Print c-string `data' URL encoded to the output stream of the
+     HTTP client `client'. */
+  static void http_print_encoded(Print *client, const char *data);
 
   /* Print program memory string `str' and line separator string to
      the output stream of the HTTP client `client'. */
-  static void http_println(Client *client, const prog_char str[]);
+  static void http_println(Print *client, const prog_char str[]);
 
   /* Print line separator string to the output stream of the HTTP
      client `client'. */
-  static void http_newline(Client *client);
+  static void http_newline(Print *client);
 
   /* Print the argument program memory string to serial output. */
   static void println(const prog_char str[]);
 
-  /* Read a line from the connection `client' into the buffer `buffer'
-     that has `buflen' bytes of space.  The method returns true if a
-     line was read and false on error. */
-  static bool read_line(Client *client, char *buffer, size_t buflen);
-
   /* Queries the current time with a HEAD request to the server.  The
      method returns true if the time was retrieved and false on
      error. */
   bool query_time(void);
 
   /* Process the response header line `buffer' and update the system
-     `basetime' if the header is a HTTP Date header.  The method
+     clock if the header is a HTTP Date header.  The method
      returns true if the header line was a `Date' header and false
      otherwise. */
   bool process_date_header(char *buffer);
 
-  /* Parse the value of the HTTP Date header `date'.  The method
-     returns the Unix time value in seconds or 0 if the header could
-     not be parsed. */
-  long parse_date(char *date);
+  /* Check if the response header line `buffer' is the header `name'.
+     The header name is compared case-insensitively.  The method
+     returns a pointer to the header value or 0 if the line is not the
+     header `name'. */
+  static char *header_value(char *buffer, const prog_char name[]);
+
+  /* Parse `count' decimal digits from `cp' into `value'.  The method
+     returns a pointer to the next character or 0 on error. */
+  static const char *parse_digits(const char *cp, uint8_t count,
+                                  int *value);
 
-  /* Parse month name `str' and return its number (1-12).  The method
-     returns a pointer to the end of the parsed month in `end'.  The
-     method returns 0 if the month could not be parsed. */
-  int parse_month(char *str, char **end);
+  /* Parse time of day `HH:MM:SS' from `cp'.  The method returns a
+     pointer to the next character or 0 on error. */
+  static const char *parse_time(const char *cp, int *hour, int *minute,
+                                int *second);
 
-  /* The base timestamp for current time computation. */
-  unsigned long basetime;
+  /* Parse the three letter month name at `str' and return its number
+     (1-12).  The method returns 0 if the month could not be
+     parsed. */
+  static int parse_month(const char *str);
 
-  /* Last milliseconds from the system clock. */
-  unsigned long last_millis;
+  /* Compute the number of days since 1970-01-01 of the date `year',
+     `month', `day'. */
+  static long days_from_civil(int year, int month, int day);
+
+  /* UTC clock synchronized from the server `Date' headers. */
+  SyncClock clock;
 
   /* Flags. */
 
@@ -217,15 +587,141 @@ private:
   /* Is access token in PGM or in EEPROM? */
   unsigned int access_token_pgm : 1;
 
+  /* Keep HTTP connection open between requests? */
+  unsigned int keep_alive : 1;
+
+  /* Is the head of the outbound message queue being posted? */
+  unsigned int queue_posting : 1;
+
+  /* Is process_queue() querying the time? */
+  unsigned int queue_querying : 1;
+
+  /* Are `hmac_key' and `prefix_state' valid for the current secrets
+     and end-point? */
+  unsigned int auth_cached : 1;
+
+  /* Let the status updates synchronize the clock? */
+  unsigned int lazy_clock : 1;
+
+  /* Time in milliseconds to wait for response data. */
+  unsigned long timeout;
+
+  /* Function to call while waiting for response data. */
+  void (*idle_callback)(void);
+
+  /* HTTP connection to the Twitter end-point. */
+  EthernetClient http;
+
+  /* Is the current request a HEAD request? */
+  unsigned int head : 1;
+
+  /* Is the current request a status update with media? */
+  unsigned int media : 1;
+
+  /* Is the current request using a reused kept-alive connection? */
+  unsigned int reused : 1;
+
+  /* Has the current request been signed again after a timestamp
+     rejection? */
+  unsigned int resigned : 1;
+
+  /* Is the response content chunked? */
+  unsigned int chunked : 1;
+
+  /* Must the connection be closed after the response? */
+  unsigned int close_connection : 1;
+
+  /* Response processing state. */
+  uint8_t state;
+
+  /* HTTP status code of the current response. */
+  int response_code;
+
+  /* Remaining bytes of the response content or the current chunk, or
+     -1 if unknown. */
+  long remaining;
+
+  /* Length of the partial response line in the work buffer. */
+  size_t line_pos;
+
+  /* The time of the last response data in milliseconds. */
+  unsigned long last_activity;
+
+  /* The status message of the current request. */
+  const char *message;
+
+  /* The MIME type, the length and the reader function of the media of
+     the current request. */
+  const prog_char *media_type;
+  unsigned long media_len;
+  size_t (*media_reader)(unsigned long offset, uint8_t *buffer, size_t len);
+
+  /* Rate limit information from the current response: the value of
+     the `Retry-After' header or -1, the number of remaining requests
+     or -1, and the Unix time when the limit resets or 0. */
+  long retry_after;
+  long rate_limit_remaining;
+  unsigned long rate_limit_reset;
+
+  /* The status ID and the first error code of the current
+     response. */
+  char status_id[TWITTER_STATUS_ID_LEN];
+  int error_code;
+
+  /* Parser for the response content.  The content is parsed as it
+     arrives so the parser has its own small buffer; the work buffer
+     holds the chunk lines meanwhile. */
+  char parser_buffer[TWITTER_PARSER_BUFFER_LEN];
+  JSONParser parser;
+
+  /* Outbound message queue storage. */
+  char *queue;
+
+  /* The size of the queue storage `queue'. */
+  size_t queue_len;
+
+  /* The number of bytes of pending messages in `queue'. */
+  size_t queue_used;
+
+  /* EEPROM address of the persistent queue or -1. */
+  int queue_eeprom;
+
+  /* Do not start requests before `hold_delay' milliseconds have
+     passed from the millis() time `hold_start'.  The hold is kept in
+     milliseconds so that it works before the clock has been set. */
+  unsigned long hold_start;
+  unsigned long hold_delay;
+
+  /* Cached HMAC key state of the consumer and token secrets. */
+  uint8_t hmac_key[SHA1_HMAC_KEY_STATE_LENGTH];
+
+  /* Cached HMAC state after the complete blocks of the constant
+     signature base string prefix, and the hashed length including the
+     key block. */
+  uint8_t prefix_state[SHA1_HASH_LENGTH];
+  uint16_t prefix_length;
+
+  /* The number of signature base string bytes to skip because they
+     are already covered by the restored `prefix_state'. */
+  uint16_t auth_skip;
+
   /* Random nonce for the OAuth request. */
   uint8_t nonce[8];
 
+  /* The boot counter from EEPROM and the number of nonces created
+     since. */
+  uint32_t nonce_boot;
+  uint32_t nonce_count;
+
   /* Request timestamp as Unix time. */
   unsigned long timestamp;
 
-  /* This points to Sha1 so don't touch it before you have consumed
-     the value. */
-  uint8_t *signature;
+  /* The HMAC context of the signature being computed.  It is valid
+     only during compute_authorization(). */
+  Sha1Class *hmac;
+
+  /* The signature of the latest request. */
+  uint8_t signature[SHA1_HASH_LENGTH];
 
   /* Work buffer. */
   char *buffer;
@@ -239,6 +735,9 @@ private:
   /* Twitter API URI at the server. */
   const prog_char *uri;
 
+  /* Twitter API URI for status updates with media. */
+  const prog_char *media_uri;
+
   /* An IP address to connnect to. */
   IPAddress ip;
 